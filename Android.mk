@@ -12,12 +12,15 @@ LOCAL_MODULE := libgme
 
 LOCAL_C_INCLUDES := $(LOCAL_PATH)/gme
 
-# YM2612 emulator to use:
+# YM2612 emulator to use by default (others can be selected at run time):
 # VGM_YM2612_NUKED: LGPLv2.1+
 # VGM_YM2612_MAME: GPLv2+
 # VGM_YM2612_GENS: LGPLv2.1+
 GME_YM2612_EMU=VGM_YM2612_NUKED
 
+# Also build MAME YM2612 emulator (makes library GPLv2+):
+GME_YM2612_MAME=N
+
 # For zlib compressed formats:
 GME_ZLIB=Y
 
@@ -32,6 +35,10 @@ ifeq ($(GME_ZLIB),Y)
 LOCAL_CFLAGS += -DHAVE_ZLIB_H
 endif
 
+ifeq ($(GME_YM2612_MAME),Y)
+LOCAL_CFLAGS += -DVGM_YM2612_WITH_MAME
+endif
+
 LOCAL_CPPFLAGS := -std=c++11 \
 	-fvisibility-inlines-hidden
 
@@ -66,6 +73,7 @@ LOCAL_SRC_FILES := \
 	gme/M3u_Playlist.cpp \
 	gme/Multi_Buffer.cpp \
 	gme/Music_Emu.cpp \
+	gme/Music_Fanout.cpp \
 	gme/Nes_Apu.cpp \
 	gme/Nes_Cpu.cpp \
 	gme/Nes_Fme7_Apu.cpp \
@@ -85,9 +93,11 @@ LOCAL_SRC_FILES := \
 	gme/Spc_Dsp.cpp \
 	gme/Spc_Emu.cpp \
 	gme/Spc_Filter.cpp \
+	gme/State_Copier.cpp \
 	gme/Vgm_Emu.cpp \
 	gme/Vgm_Emu_Impl.cpp \
 	gme/Ym2413_Emu.cpp \
+	gme/Ym2612_Emu.cpp \
 	gme/Ym2612_Nuked.cpp \
 	gme/Ym2612_GENS.cpp \
 	gme/Ym2612_MAME.cpp \
@@ -47,7 +47,7 @@ int main( int argc, char *argv[] )
 	wave_enable_stereo();
 
 	const int frames = 64;
-	const int voices = 8;
+	const int voices = gme_planar_count( emu ); /* 8, or 9 for SPC */
 	const int channels = 2;
 	const int buf_size = frames * voices * channels;
 
@@ -0,0 +1,65 @@
+/* Measures how many amplitude changes per second Blip_Synth can add to a
+Blip_Buffer at each quality level, and with Blip_Buffer::fast_synthesis(). Build
+bench_synth_scalar to compare against the portable code. */
+
+#include "gme/Blip_Buffer.h"
+
+#include <stdio.h>
+#include <time.h>
+
+static const long sample_rate = 44100;
+static const long clock_rate  = 1789773;
+static const int  frame_len   = clock_rate / 60;
+static const int  frames      = 60 * 20;
+static const int  deltas_per_frame = 10000;
+
+template<int quality>
+static void bench( Blip_Buffer& buf, const char* name )
+{
+	static Blip_Synth<quality,30> synth;
+	synth.volume( 0.5 );
+	synth.output( &buf );
+	buf.clear();
+
+	blip_sample_t out [4096];
+	unsigned rand = 1;
+	clock_t start = clock();
+	for ( int f = 0; f < frames; f++ )
+	{
+		for ( long n = 0; n < deltas_per_frame; n++ )
+		{
+			rand = rand * 1664525 + 1013904223;
+			blip_time_t time = (blip_time_t) (n * frame_len / deltas_per_frame);
+			synth.offset_inline( time, (int) (rand >> 8 & 0x3F) - 0x1F );
+		}
+		buf.end_frame( frame_len );
+		while ( buf.samples_avail() )
+			buf.read_samples( out, 4096 );
+	}
+	double secs = (double) (clock() - start) / CLOCKS_PER_SEC;
+	if ( secs <= 0 )
+		secs = 1e-6;
+
+	printf( "%-6s %8.1f million deltas/sec\n", name,
+			(double) frames * deltas_per_frame / secs / 1e6 );
+}
+
+int main()
+{
+	Blip_Buffer buf;
+	if ( buf.set_sample_rate( sample_rate, 1000 / 10 ) )
+	{
+		printf( "Out of memory\n" );
+		return 1;
+	}
+	buf.clock_rate( clock_rate );
+
+	printf( "BLIP_SYNTH_SIMD = %d\n", (int) BLIP_SYNTH_SIMD );
+	bench<blip_med_quality >( buf, "med" );
+	bench<blip_good_quality>( buf, "good" );
+	bench<blip_high_quality>( buf, "high" );
+
+	buf.fast_synthesis( true );
+	bench<blip_good_quality>( buf, "fast" );
+	return 0;
+}
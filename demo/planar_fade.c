@@ -0,0 +1,147 @@
+/* C test that fades an SPC in multi-channel mode and checks that gme_play_planar()
+gives the same samples as gme_play() writes interleaved */
+
+#include "gme/gme.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+void handle_error( int err )
+{
+	if ( err )
+	{
+		printf( "Error: %s\n", gme_strerror( err ) );
+		exit( EXIT_FAILURE );
+	}
+}
+
+enum { spc_size = 0x10200, ram_offset = 0x100, dsp_offset = 0x10100 };
+
+/* Builds an SPC whose CPU just loops while the DSP plays a square wave on two
+voices, one of them through echo */
+static void make_spc( unsigned char* spc )
+{
+	unsigned char* ram = spc + ram_offset;
+	unsigned char* dsp = spc + dsp_offset;
+	int i;
+
+	memset( spc, 0, spc_size );
+	memcpy( spc, "SNES-SPC700 Sound File Data v0.30\x1A\x1A", 35 );
+	spc [0x23] = 0x1A; /* no ID666 tag */
+	spc [0x25] = 0x00; /* PC = $0400 */
+	spc [0x26] = 0x04;
+	spc [0x2B] = 0xEF; /* SP */
+
+	ram [0x0400] = 0x2F; /* BRA to itself */
+	ram [0x0401] = 0xFE;
+
+	/* sample directory at $0200 points to one looping BRR block at $0300 */
+	ram [0x0201] = 0x03;
+	ram [0x0203] = 0x03;
+	ram [0x0300] = 0xB3; /* range 11, loop, end */
+	for ( i = 1; i <= 8; i++ )
+		ram [0x0300 + i] = (i <= 4 ? 0x77 : 0x99);
+
+	for ( i = 0; i < 2; i++ )
+	{
+		unsigned char* v = dsp + i * 0x10;
+		v [0] = 0x7F;         /* volume */
+		v [1] = 0x50;
+		v [3] = 0x08 + i * 4; /* pitch */
+		v [7] = 0x7F;         /* direct gain */
+	}
+	dsp [0x0C] = 0x7F; /* main volume */
+	dsp [0x1C] = 0x7F;
+	dsp [0x2C] = 0x40; /* echo volume */
+	dsp [0x3C] = 0x40;
+	dsp [0x0D] = 0x40; /* echo feedback */
+	dsp [0x0F] = 0x7F; /* echo FIR */
+	dsp [0x4D] = 0x02; /* voice 1 through echo */
+	dsp [0x5D] = 0x02; /* sample directory */
+	dsp [0x6D] = 0x80; /* echo buffer at $8000 */
+	dsp [0x7D] = 0x01;
+	dsp [0x4C] = 0x03; /* key on both voices */
+}
+
+static Music_Emu* open_spc( unsigned char const* spc )
+{
+	Music_Emu* emu = gme_new_emu_multi_channel( gme_spc_type, 44100 );
+	if ( !emu )
+	{
+		printf( "Out of memory\n" );
+		exit( EXIT_FAILURE );
+	}
+	handle_error( gme_load_data( emu, spc, spc_size ) );
+	handle_error( gme_start_track( emu, 0 ) );
+	gme_set_fade_msecs( emu, 500, 2000 );
+	return emu;
+}
+
+int main( void )
+{
+	enum { frames = 512, max_voices = 9 };
+
+	unsigned char* spc = (unsigned char*) malloc( spc_size );
+	if ( !spc )
+	{
+		printf( "Out of memory\n" );
+		return EXIT_FAILURE;
+	}
+	make_spc( spc );
+
+	Music_Emu* inter = open_spc( spc );
+	Music_Emu* planar = open_spc( spc );
+	free( spc );
+
+	int const voices = gme_planar_count( planar );
+	if ( voices != max_voices )
+	{
+		printf( "Expected %d SPC outputs, got %d\n", max_voices, voices );
+		return EXIT_FAILURE;
+	}
+
+	static short buf [frames * max_voices * 2];
+	static short bufs [max_voices] [frames * 2];
+	short* outs [max_voices];
+	for ( int i = 0; i < voices; i++ )
+		outs [i] = bufs [i];
+
+	/* play through fade, until track ends */
+	long faded = 0;
+	for ( int n = 0; n < 1000 && !gme_track_ended( inter ); n++ )
+	{
+		handle_error( gme_play( inter, frames * voices * 2, buf ) );
+		handle_error( gme_play_planar( planar, frames * 2, outs ) );
+
+		for ( int f = 0; f < frames; f++ )
+		{
+			for ( int v = 0; v < voices; v++ )
+			{
+				for ( int c = 0; c < 2; c++ )
+				{
+					short s = buf [(f * voices + v) * 2 + c];
+					if ( s != bufs [v] [f * 2 + c] )
+					{
+						printf( "Planar output differs at frame %ld, voice %d\n",
+								(long) n * frames + f, v );
+						return EXIT_FAILURE;
+					}
+					if ( s && gme_tell( inter ) > 500 )
+						faded++;
+				}
+			}
+		}
+	}
+
+	if ( !gme_track_ended( inter ) || !faded )
+	{
+		printf( "Fade didn't play\n" );
+		return EXIT_FAILURE;
+	}
+
+	gme_delete( inter );
+	gme_delete( planar );
+	printf( "Planar output matches interleaved output during fade\n" );
+	return EXIT_SUCCESS;
+}
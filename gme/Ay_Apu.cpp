@@ -2,6 +2,8 @@
 
 #include "Ay_Apu.h"
 
+#include "State_Copier.h"
+
 /* Copyright (C) 2006 Shay Green. This module is free software; you
 can redistribute it and/or modify it under the terms of the GNU Lesser
 General Public License as published by the Free Software Foundation; either
@@ -90,6 +92,7 @@ Ay_Apu::Ay_Apu()
 		}
 	}
 
+	clock_rate_ = 0;
 	output( nullptr );
 	volume( 1.0 );
 	reset();
@@ -188,15 +191,18 @@ void Ay_Apu::run_until( blip_time_t final_end_time )
 		osc_t* const osc = &oscs [index];
 		int osc_mode = regs [7] >> index;
 
-		// output
+		// output; muted oscillators are run the same way without adding sound, so
+		// they sound the same after being muted during a skip
 		Blip_Buffer* const osc_output = osc->output;
-		if ( !osc_output )
-			continue;
-		osc_output->set_modified();
+		if ( osc_output )
+		{
+			osc_output->set_modified();
+			clock_rate_ = osc_output->clock_rate();
+		}
 
 		// period
 		int half_vol = 0;
-		blip_time_t inaudible_period = (uint32_t) (osc_output->clock_rate() +
+		blip_time_t inaudible_period = (uint32_t) (clock_rate_ +
 				inaudible_freq) / (inaudible_freq * 2);
 		if ( osc->period <= inaudible_period && !(osc_mode & tone_off) )
 		{
@@ -276,7 +282,8 @@ void Ay_Apu::run_until( blip_time_t final_end_time )
 				if ( delta )
 				{
 					osc->last_amp = amp;
-					synth_.offset( start_time, delta, osc_output );
+					if ( osc_output )
+						synth_.offset( start_time, delta, osc_output );
 				}
 			}
 
@@ -304,7 +311,8 @@ void Ay_Apu::run_until( blip_time_t final_end_time )
 							if ( changed & 2 )
 							{
 								delta = -delta;
-								synth_.offset( ntime, delta, osc_output );
+								if ( osc_output )
+									synth_.offset( ntime, delta, osc_output );
 							}
 							ntime += noise_period;
 						}
@@ -326,7 +334,8 @@ void Ay_Apu::run_until( blip_time_t final_end_time )
 						while ( time < end )
 						{
 							delta = -delta;
-							synth_.offset( time, delta, osc_output );
+							if ( osc_output )
+								synth_.offset( time, delta, osc_output );
 							time += period;
 							//phase ^= 1;
 						}
@@ -394,3 +403,31 @@ void Ay_Apu::run_until( blip_time_t final_end_time )
 
 	last_time = final_end_time;
 }
+
+void Ay_Apu::copy_state( State_Copier& copier )
+{
+	for ( int i = 0; i < osc_count; i++ )
+	{
+		osc_t& osc = oscs [i];
+		copier.copy_int( osc.period );
+		copier.copy_int( osc.delay );
+		copier.copy_int( osc.last_amp );
+		copier.copy_int( osc.phase );
+	}
+	copier.copy_int( last_time );
+	copier.copy( regs, sizeof regs );
+	copier.copy_int( noise.delay );
+	copier.copy_int( noise.lfsr );
+	copier.copy_int( env.delay );
+	copier.copy_int( env.pos );
+	if ( copier.loading() )
+	{
+		// regs [13] holds mode after conversion by write_data_()
+		env.wave = env.modes [(regs [13] - 7) & 0x07];
+		if ( env.pos >= 0 || env.pos < -48 )
+		{
+			copier.set_error( ERR_STATE_INVALID );
+			env.pos = -48;
+		}
+	}
+}
@@ -7,6 +7,8 @@
 #include "Blip_Buffer.h"
 #include <cstdint>
 
+class State_Copier;
+
 class Ay_Apu {
 public:
 	// Set buffer to generate all sound into, or disable sound if NULL
@@ -24,6 +26,9 @@ public:
 	// can be whatever length is convenient.
 	void end_frame( blip_time_t length );
 
+	// Save/load emulation state between frames, using a portable format
+	void copy_state( State_Copier& );
+
 // Additional features
 
 	// Set sound output of specific oscillator to buffer, where index is
@@ -50,6 +55,7 @@ private:
 		Blip_Buffer* output;
 	} oscs [osc_count];
 	blip_time_t last_time;
+	long clock_rate_; // of last output, used while all oscillators are muted
 	byte regs [reg_count];
 
 	struct {
@@ -85,6 +91,8 @@ inline void Ay_Apu::osc_output( int i, Blip_Buffer* buf )
 {
 	assert( (unsigned) i < osc_count );
 	oscs [i].output = buf;
+	if ( buf )
+		clock_rate_ = buf->clock_rate();
 }
 
 inline void Ay_Apu::output( Blip_Buffer* buf )
@@ -2,6 +2,7 @@
 
 #include "Ay_Emu.h"
 
+#include "State_Copier.h"
 #include "blargg_endian.h"
 #include <cstring>
 
@@ -267,7 +268,7 @@ blargg_err_t Ay_Emu::start_track_( int track )
 
 	// start at spectrum speed
 	change_clock_rate( spectrum_clock );
-	set_tempo( tempo() );
+	set_tempo_( tempo() );
 
 	spectrum_mode = false;
 	cpc_mode      = false;
@@ -276,6 +277,50 @@ blargg_err_t Ay_Emu::start_track_( int track )
 	return 0;
 }
 
+static void copy_registers( State_Copier& copier, Ay_Cpu::registers_t& r )
+{
+	copier.copy_int( r.pc );
+	copier.copy_int( r.sp );
+	copier.copy_int( r.ix );
+	copier.copy_int( r.iy );
+	copier.copy_int( r.w.bc );
+	copier.copy_int( r.w.de );
+	copier.copy_int( r.w.hl );
+	copier.copy_int( r.w.fa );
+	copier.copy_int( r.alt.w.bc );
+	copier.copy_int( r.alt.w.de );
+	copier.copy_int( r.alt.w.hl );
+	copier.copy_int( r.alt.w.fa );
+	copier.copy_int( r.iff1 );
+	copier.copy_int( r.iff2 );
+	copier.copy_int( r.r );
+	copier.copy_int( r.i );
+	copier.copy_int( r.im );
+}
+
+void Ay_Emu::copy_state_( State_Copier& copier )
+{
+	copy_buffer_state( copier );
+
+	copy_registers( copier, r );
+	copier.copy( mem.ram, sizeof mem.ram );
+	copier.copy_int( next_play );
+	copier.copy_int( beeper_delta );
+	copier.copy_int( last_beeper );
+	copier.copy_int( apu_addr );
+	apu_addr &= 0x0F;
+	copier.copy_int( cpc_latch );
+	copier.copy_int( spectrum_mode );
+	copier.copy_int( cpc_mode );
+	if ( copier.loading() )
+	{
+		change_clock_rate( cpc_mode ? cpc_clock : spectrum_clock );
+		set_tempo_( tempo() );
+	}
+
+	apu.copy_state( copier );
+}
+
 // Emulation
 
 void Ay_Emu::cpu_out_misc( cpu_time_t time, unsigned addr, int data )
@@ -327,7 +372,7 @@ enable_cpc:
 	{
 		cpc_mode = true;
 		change_clock_rate( cpc_clock );
-		set_tempo( tempo() );
+		set_tempo_( tempo() );
 	}
 }
 
@@ -2,9 +2,11 @@
 
 #include "Blip_Buffer.h"
 
+#include "State_Copier.h"
 #include <cstring>
 #include <cstdlib>
 #include <cmath>
+#include <mutex>
 
 /* Copyright (C) 2003-2006 Shay Green. This module is free software; you
 can redistribute it and/or modify it under the terms of the GNU Lesser
@@ -32,6 +34,7 @@ Blip_Buffer::Blip_Buffer()
 	sample_rate_  = 0;
 	reader_accum_ = 0;
 	bass_shift_   = 0;
+	fast_synthesis_ = false;
 	clock_rate_   = 0;
 	bass_freq_    = 16;
 	length_       = 0;
@@ -184,6 +187,37 @@ void Blip_Buffer::remove_samples( long count )
 	}
 }
 
+void Blip_Buffer::skip_samples( long count )
+{
+	// bass filter must still be run so later output matches
+	int const bass = BLIP_READER_BASS( *this );
+	BLIP_READER_BEGIN( reader, *this );
+	for ( blip_long n = count; n; --n )
+		BLIP_READER_NEXT( reader, bass );
+	BLIP_READER_END( reader, *this );
+
+	remove_samples( count );
+}
+
+void Blip_Buffer::copy_state( State_Copier& copier )
+{
+	copier.copy_int( offset_ );
+	copier.copy_int( reader_accum_ );
+	copier.copy_int( modified_ );
+
+	// pending samples plus tail of last impulses; the rest of buffer is silent
+	long count = samples_avail() + blip_buffer_extra_;
+	if ( count > buffer_size_ + blip_buffer_extra_ )
+	{
+		copier.set_error( ERR_STATE_INVALID );
+		offset_ = 0;
+		return;
+	}
+	if ( copier.loading() )
+		memset( buffer_ + count, 0, (buffer_size_ + blip_buffer_extra_ - count) * sizeof *buffer_ );
+	copier.copy_ints( buffer_, count );
+}
+
 // Blip_Synth_
 
 Blip_Synth_Fast_::Blip_Synth_Fast_()
@@ -200,15 +234,56 @@ void Blip_Synth_Fast_::volume_unit( double new_unit )
 
 #if !BLIP_BUFFER_FAST
 
-Blip_Synth_::Blip_Synth_( short* p, int w ) :
-	impulses( p ),
+// Impulse tables, shared by all synths with the same width, eq and attenuation.
+// Immutable once made, and freed when the last synth using one releases it.
+struct blip_kernel_t
+{
+	blip_kernel_t* next;
+	blip_kernel_t const* parent; // unattenuated kernel, or NULL
+	int refs;
+	int width;
+	int shift;                   // attenuation applied to parent
+	double treble;
+	long rolloff_freq;
+	long sample_rate;
+	long cutoff_freq;
+	blip_long kernel_unit;
+	short impulses [blip_res / 2 * blip_widest_impulse_ + 1];
+#if BLIP_SYNTH_SIMD
+	short kernels [blip_res * blip_widest_impulse_];
+#endif
+
+	int impulses_size() const { return blip_res / 2 * width + 1; }
+	bool matches( int width, blip_eq_t const& ) const;
+	void generate( blip_eq_t const& );
+	void attenuate( blip_kernel_t const& parent, int shift );
+	void adjust_impulse();
+	void build_kernels();
+};
+
+// used until a synth gets its first kernel
+static short const blip_silent_kernel [blip_res * blip_widest_impulse_] = { 0 };
+
+static std::mutex kernel_mutex;
+static blip_kernel_t* kernel_list;
+
+Blip_Synth_::Blip_Synth_( int w ) :
 	width( w )
 {
 	volume_unit_ = 0.0;
 	kernel_unit = 0;
+	kernel = nullptr;
+	impulses = blip_silent_kernel;
+	kernels = blip_silent_kernel;
 	buf = nullptr;
 	last_amp = 0;
 	delta_factor = 0;
+	fast_delta_factor = 0;
+}
+
+Blip_Synth_::~Blip_Synth_()
+{
+	set_kernel( nullptr );
 }
 
 #undef PI
@@ -277,32 +352,20 @@ void blip_eq_t::generate( float* out, int count ) const
 		out [i] *= 0.54f - 0.46f * (float) cos( i * to_fraction );
 }
 
-void Blip_Synth_::adjust_impulse()
+bool blip_kernel_t::matches( int w, blip_eq_t const& eq ) const
 {
-	// sum pairs for each phase and add error correction to end of first half
-	int const size = impulses_size();
-	for ( int p = blip_res; p-- >= blip_res / 2; )
-	{
-		int p2 = blip_res - 2 - p;
-		long error = kernel_unit;
-		for ( int i = 1; i < size; i += blip_res )
-		{
-			error -= impulses [i + p ];
-			error -= impulses [i + p2];
-		}
-		if ( p == p2 )
-			error /= 2; // phase = 0.5 impulse uses same half for both sides
-		impulses [size - blip_res + p] += (short) error;
-		//printf( "error: %ld\n", error );
-	}
-
-	//for ( int i = blip_res; i--; printf( "\n" ) )
-	//  for ( int j = 0; j < width / 2; j++ )
-	//      printf( "%5ld,", impulses [j * blip_res + i + 1] );
+	return !parent && width == w && treble == eq.treble &&
+			rolloff_freq == eq.rolloff_freq && sample_rate == eq.sample_rate &&
+			cutoff_freq == eq.cutoff_freq;
 }
 
-void Blip_Synth_::treble_eq( blip_eq_t const& eq )
+void blip_kernel_t::generate( blip_eq_t const& eq )
 {
+	treble       = eq.treble;
+	rolloff_freq = eq.rolloff_freq;
+	sample_rate  = eq.sample_rate;
+	cutoff_freq  = eq.cutoff_freq;
+
 	float fimpulse [blip_res / 2 * (blip_widest_impulse_ - 1) + blip_res * 2];
 
 	int const half_size = blip_res / 2 * (width - 1);
@@ -340,6 +403,156 @@ void Blip_Synth_::treble_eq( blip_eq_t const& eq )
 		next += fimpulse [i + blip_res];
 	}
 	adjust_impulse();
+}
+
+void blip_kernel_t::attenuate( blip_kernel_t const& in, int s )
+{
+	kernel_unit = in.kernel_unit >> s;
+	assert( kernel_unit > 0 ); // fails if volume unit is too low
+
+	// keep values positive to avoid round-towards-zero of sign-preserving
+	// right shift for negative values
+	long offset = 0x8000 + (1 << (s - 1));
+	long offset2 = 0x8000 >> s;
+	for ( int i = impulses_size(); i--; )
+		impulses [i] = (short) (((in.impulses [i] + offset) >> s) - offset2);
+	adjust_impulse();
+}
+
+void blip_kernel_t::adjust_impulse()
+{
+	// sum pairs for each phase and add error correction to end of first half
+	int const size = impulses_size();
+	for ( int p = blip_res; p-- >= blip_res / 2; )
+	{
+		int p2 = blip_res - 2 - p;
+		long error = kernel_unit;
+		for ( int i = 1; i < size; i += blip_res )
+		{
+			error -= impulses [i + p ];
+			error -= impulses [i + p2];
+		}
+		if ( p == p2 )
+			error /= 2; // phase = 0.5 impulse uses same half for both sides
+		impulses [size - blip_res + p] += (short) error;
+		//printf( "error: %ld\n", error );
+	}
+
+	//for ( int i = blip_res; i--; printf( "\n" ) )
+	//  for ( int j = 0; j < width / 2; j++ )
+	//      printf( "%5ld,", impulses [j * blip_res + i + 1] );
+
+	build_kernels();
+}
+
+void blip_kernel_t::build_kernels()
+{
+#if BLIP_SYNTH_SIMD
+	// gather the taps offset_resampled() uses for each phase, in output order
+	int const half = width / 2;
+	for ( int p = 0; p < blip_res; p++ )
+	{
+		short* out = &kernels [p * width];
+		for ( int i = 0; i < half; i++ )
+		{
+			out [i]             = impulses [blip_res - p + blip_res * i];
+			out [width - 1 - i] = impulses [p + blip_res * i];
+		}
+	}
+#endif
+}
+
+// Returns new or existing kernel with one more reference, or NULL if out of memory.
+// Kernel_mutex must be held.
+static blip_kernel_t* new_kernel( int width, blip_kernel_t const* parent, int shift )
+{
+	blip_kernel_t* k = BLARGG_NEW blip_kernel_t;
+	if ( k )
+	{
+		k->next   = kernel_list;
+		k->parent = parent;
+		k->refs   = 1;
+		k->width  = width;
+		k->shift  = shift;
+		kernel_list = k;
+	}
+	return k;
+}
+
+static blip_kernel_t const* find_kernel( int width, blip_eq_t const& eq )
+{
+	std::lock_guard<std::mutex> lock( kernel_mutex );
+	for ( blip_kernel_t* k = kernel_list; k; k = k->next )
+	{
+		if ( k->matches( width, eq ) )
+		{
+			k->refs++;
+			return k;
+		}
+	}
+
+	blip_kernel_t* k = new_kernel( width, nullptr, 0 );
+	if ( k )
+		k->generate( eq );
+	return k;
+}
+
+static blip_kernel_t const* find_attenuated_kernel( blip_kernel_t const* parent, int shift )
+{
+	std::lock_guard<std::mutex> lock( kernel_mutex );
+	for ( blip_kernel_t* k = kernel_list; k; k = k->next )
+	{
+		if ( k->parent == parent && k->shift == shift )
+		{
+			k->refs++;
+			return k;
+		}
+	}
+
+	blip_kernel_t* k = new_kernel( parent->width, parent, shift );
+	if ( k )
+	{
+		const_cast<blip_kernel_t*> (parent)->refs++;
+		k->attenuate( *parent, shift );
+	}
+	return k;
+}
+
+static void release_kernel( blip_kernel_t const* k )
+{
+	std::lock_guard<std::mutex> lock( kernel_mutex );
+	while ( k && !--const_cast<blip_kernel_t*> (k)->refs )
+	{
+		blip_kernel_t** p = &kernel_list;
+		while ( *p != k )
+			p = &(*p)->next;
+		*p = k->next;
+
+		blip_kernel_t const* parent = k->parent;
+		delete k;
+		k = parent;
+	}
+}
+
+void Blip_Synth_::set_kernel( blip_kernel_t const* k )
+{
+	release_kernel( kernel );
+	kernel = k;
+	impulses = k ? k->impulses : blip_silent_kernel;
+	kernels = blip_silent_kernel;
+	#if BLIP_SYNTH_SIMD
+		if ( k )
+			kernels = k->kernels;
+	#endif
+	kernel_unit = k ? k->kernel_unit : 0;
+}
+
+void Blip_Synth_::treble_eq( blip_eq_t const& eq )
+{
+	blip_kernel_t const* k = find_kernel( width, eq );
+	if ( !k )
+		return; // keep current kernel if out of memory
+	set_kernel( k );
 
 	// volume might require rescaling
 	double vol = volume_unit_;
@@ -357,8 +570,11 @@ void Blip_Synth_::volume_unit( double new_unit )
 		// use default eq if it hasn't been set yet
 		if ( !kernel_unit )
 			treble_eq( -8.0 );
+		if ( !kernel_unit )
+			return; // out of memory
 
 		volume_unit_ = new_unit;
+		fast_delta_factor = int (new_unit * (1L << blip_sample_bits) + 0.5);
 		double factor = new_unit * (1L << blip_sample_bits) / kernel_unit;
 
 		if ( factor > 0.0 )
@@ -374,65 +590,117 @@ void Blip_Synth_::volume_unit( double new_unit )
 
 			if ( shift )
 			{
-				kernel_unit >>= shift;
-				assert( kernel_unit > 0 ); // fails if volume unit is too low
-
-				// keep values positive to avoid round-towards-zero of sign-preserving
-				// right shift for negative values
-				long offset = 0x8000 + (1 << (shift - 1));
-				long offset2 = 0x8000 >> shift;
-				for ( int i = impulses_size(); i--; )
-					impulses [i] = (short) (((impulses [i] + offset) >> shift) - offset2);
-				adjust_impulse();
+				blip_kernel_t const* k = find_attenuated_kernel( kernel, shift );
+				if ( k )
+					set_kernel( k );
+				else
+					factor = new_unit * (1L << blip_sample_bits) / kernel_unit;
 			}
 		}
 		delta_factor = (int) floor( factor + 0.5 );
 		//printf( "delta_factor: %d, kernel_unit: %d\n", delta_factor, kernel_unit );
 	}
 }
-#endif
 
-long Blip_Buffer::read_samples( blip_sample_t* BLIP_RESTRICT out, long max_samples, int stereo )
+#if BLIP_SYNTH_SIMD
+
+#include <emmintrin.h>
+#include <immintrin.h>
+
+// Products wrap exactly as the scalar (blip_long) imp * delta does, so output is identical
+
+static void add_kernel_sse2( blip_long* out, short const* kernel, int count, blip_long delta )
 {
-	long count = samples_avail();
-	if ( count > max_samples )
-		count = max_samples;
+	__m128i const d_even = _mm_set1_epi32( delta );
+	__m128i const d_odd  = _mm_srli_epi64( d_even, 32 );
+	for ( int i = 0; i < count; i += 4 )
+	{
+		// sign-extend four taps to 32 bits
+		__m128i k = _mm_loadl_epi64( (__m128i const*) (kernel + i) );
+		k = _mm_srai_epi32( _mm_unpacklo_epi16( k, k ), 16 );
+
+		// SSE2 lacks a 32-bit multiply, so do even and odd lanes separately
+		__m128i even = _mm_mul_epu32( k, d_even );
+		__m128i odd  = _mm_mul_epu32( _mm_srli_epi64( k, 32 ), d_odd );
+		__m128i prod = _mm_unpacklo_epi32( _mm_shuffle_epi32( even, 0x08 ),
+				_mm_shuffle_epi32( odd, 0x08 ) );
+
+		__m128i* p = (__m128i*) (out + i);
+		_mm_storeu_si128( p, _mm_add_epi32( _mm_loadu_si128( p ), prod ) );
+	}
+}
 
-	if ( count )
+BLARGG_TARGET_AVX2
+static void add_kernel_avx2( blip_long* out, short const* kernel, int count, blip_long delta )
+{
+	__m256i const d = _mm256_set1_epi32( delta );
+	int i = 0;
+	for ( ; i + 8 <= count; i += 8 )
 	{
-		int const bass = BLIP_READER_BASS( *this );
-		BLIP_READER_BEGIN( reader, *this );
+		__m256i k = _mm256_cvtepi16_epi32( _mm_loadu_si128( (__m128i const*) (kernel + i) ) );
+		__m256i* p = (__m256i*) (out + i);
+		_mm256_storeu_si256( p, _mm256_add_epi32( _mm256_loadu_si256( p ),
+				_mm256_mullo_epi32( k, d ) ) );
+	}
+	if ( i < count )
+	{
+		__m128i k = _mm_cvtepi16_epi32( _mm_loadl_epi64( (__m128i const*) (kernel + i) ) );
+		__m128i* p = (__m128i*) (out + i);
+		_mm_storeu_si128( p, _mm_add_epi32( _mm_loadu_si128( p ),
+				_mm_mullo_epi32( k, _mm256_castsi256_si128( d ) ) ) );
+	}
+}
 
-		if ( !stereo )
-		{
-			for ( blip_long n = count; n; --n )
-			{
-				blip_long s = BLIP_READER_READ( reader );
-				if ( (blip_sample_t) s != s )
-					s = 0x7FFF - (s >> 24);
-				*out++ = (blip_sample_t) s;
-				BLIP_READER_NEXT( reader, bass );
-			}
-		}
-		else
-		{
-			for ( blip_long n = count; n; --n )
-			{
-				blip_long s = BLIP_READER_READ( reader );
-				if ( (blip_sample_t) s != s )
-					s = 0x7FFF - (s >> 24);
-				*out = (blip_sample_t) s;
-				out += 2;
-				BLIP_READER_NEXT( reader, bass );
-			}
-		}
-		BLIP_READER_END( reader, *this );
+// Picked on first use rather than during static initialization, since synths can
+// be used from other static constructors. Threads that race here store the same
+// value, and a relaxed atomic makes that well-defined without slowing calls.
+static void add_kernel_pick( blip_long* out, short const* kernel, int count, blip_long delta )
+{
+	blip_add_kernel_t kernel_func = blargg_cpu_has_avx2() ? add_kernel_avx2 : add_kernel_sse2;
+	blip_add_kernel.store( kernel_func, std::memory_order_relaxed );
+	kernel_func( out, kernel, count, delta );
+}
 
-		remove_samples( count );
+std::atomic<blip_add_kernel_t> blip_add_kernel( add_kernel_pick );
+
+#endif
+#endif
+
+template<class T>
+static long read_samples_( Blip_Buffer& buf, T* BLIP_RESTRICT out, long count, int stereo )
+{
+	int const bass = BLIP_READER_BASS( buf );
+	BLIP_READER_BEGIN( reader, buf );
+
+	int const step = stereo ? 2 : 1;
+	for ( blip_long n = count; n; --n )
+	{
+		blip_store( *out, BLIP_READER_READ( reader ) );
+		out += step;
+		BLIP_READER_NEXT( reader, bass );
 	}
+	BLIP_READER_END( reader, buf );
+
+	buf.remove_samples( count );
 	return count;
 }
 
+long Blip_Buffer::read_samples( blip_sample_t* out, long max_samples, int stereo )
+{
+	long count = samples_avail();
+	if ( count > max_samples )
+		count = max_samples;
+	return count ? read_samples_( *this, out, count, stereo ) : 0;
+}
+
+long Blip_Buffer::read_samples( float* out, long max_samples, int stereo )
+{
+	long count = samples_avail();
+	if ( count > max_samples )
+		count = max_samples;
+	return count ? read_samples_( *this, out, count, stereo ) : 0;
+}
+
 void Blip_Buffer::mix_samples( blip_sample_t const* in, long count )
 {
 	if ( buffer_size_ == silent_buf_size )
@@ -16,6 +16,9 @@
 	typedef unsigned blip_ulong;
 
 #include "blargg_err.h"
+#include "blargg_simd.h"
+
+class State_Copier;
 
 // Time unit at source clock rate
 typedef blip_long blip_time_t;
@@ -45,6 +48,10 @@ public:
 	// easy interleving of two channels into a stereo output buffer.
 	long read_samples( blip_sample_t* dest, long max_samples, int stereo = 0 );
 
+	// Same as above, but writes floating-point samples where 1.0 corresponds to
+	// 0x8000, without clamping.
+	long read_samples( float* dest, long max_samples, int stereo = 0 );
+
 // Additional optional features
 
 	// Current output sample rate
@@ -59,6 +66,10 @@ public:
 	// Set frequency high-pass filter frequency, where higher values reduce bass more
 	void bass_freq( int frequency );
 
+	// Use faster, lower quality synthesis for waveforms added to this buffer, as if
+	// BLIP_BUFFER_FAST were defined. Can be changed at any time.
+	void fast_synthesis( bool fast )            { fast_synthesis_ = fast; }
+
 	// Number of samples delay from synthesis to samples read out
 	int output_latency() const;
 
@@ -72,6 +83,10 @@ public:
 	// Remove 'count' samples from those waiting to be read
 	void remove_samples( long count );
 
+	// Remove 'count' samples as read_samples() would, without writing them anywhere.
+	// Faster than reading when output isn't needed, as when skipping.
+	void skip_samples( long count );
+
 // Experimental features
 
 	// Count number of clocks needed until 'count' samples will be available.
@@ -93,6 +108,9 @@ public:
 	blip_resampled_time_t resampled_duration( int t ) const     { return t * factor_; }
 	blip_resampled_time_t resampled_time( blip_time_t t ) const { return t * factor_ + offset_; }
 	blip_resampled_time_t clock_rate_factor( uint32_t clock_rate ) const;
+
+	// Save/load unread samples and filter state. Must be called between frames.
+	void copy_state( State_Copier& );
 public:
 	Blip_Buffer();
 	~Blip_Buffer();
@@ -113,6 +131,7 @@ public:
 	blip_long buffer_size_;
 	blip_long reader_accum_;
 	int bass_shift_;
+	bool fast_synthesis_;
 private:
 	long sample_rate_;
 	uint32_t clock_rate_;
@@ -141,6 +160,16 @@ private:
 	#endif
 #endif
 
+// Use SSE2/AVX2 to add impulses in offset_resampled(), selected at run time, and
+// SSE2 to mix Stereo_Buffer output. Define to 0 to always use the portable code.
+#ifndef BLIP_SYNTH_SIMD
+	#define BLIP_SYNTH_SIMD BLARGG_SIMD
+#endif
+
+#if BLIP_SYNTH_SIMD
+	#include <atomic>
+#endif
+
 	// Internal
 	typedef blip_ulong blip_resampled_time_t;
 	int const blip_widest_impulse_ = 16;
@@ -159,24 +188,39 @@ private:
 		void treble_eq( blip_eq_t const& ) { }
 	};
 
+	struct blip_kernel_t;
+
 	class Blip_Synth_ {
 	public:
 		Blip_Buffer* buf;
 		int last_amp;
 		int delta_factor;
+		int fast_delta_factor; // for Blip_Buffer::fast_synthesis()
+
+		// Shared with all other synths of the same width, eq and attenuation
+		short const* impulses;
+		short const* kernels; // impulses rearranged so each phase's taps are contiguous
 
 		void volume_unit( double );
-		Blip_Synth_( short* impulses, int width );
+		Blip_Synth_( int width );
+		~Blip_Synth_();
 		void treble_eq( blip_eq_t const& );
 	private:
 		double volume_unit_;
-		short* const impulses;
+		blip_kernel_t const* kernel;
 		int const width;
 		blip_long kernel_unit;
-		int impulses_size() const { return blip_res / 2 * width + 1; }
-		void adjust_impulse();
+		void set_kernel( blip_kernel_t const* );
 	};
 
+	#if BLIP_SYNTH_SIMD
+		// Adds kernel [i] * delta to out [i] for count values, count a multiple of 4.
+		// Starts out pointing to a function that picks the kernel for the CPU and
+		// replaces itself, which is atomic since synths can run on several threads.
+		typedef void (*blip_add_kernel_t)( blip_long* out, short const* kernel, int count, blip_long delta );
+		extern std::atomic<blip_add_kernel_t> blip_add_kernel;
+	#endif
+
 // Quality level. Start with blip_good_quality.
 const int blip_med_quality  = 8;
 const int blip_good_quality = 12;
@@ -224,12 +268,13 @@ public:
 private:
 #if BLIP_BUFFER_FAST
 	Blip_Synth_Fast_ impl;
+public:
+	Blip_Synth() { }
 #else
 	Blip_Synth_ impl;
 	typedef short imp_t;
-	imp_t impulses [blip_res * (quality / 2) + 1];
 public:
-	Blip_Synth() : impl( impulses, quality ) { }
+	Blip_Synth() : impl( quality ) { }
 #endif
 
 	// disable broken defaulted constructors, Blip_Synth_ isn't safe to move/copy
@@ -254,7 +299,7 @@ private:
 	long sample_rate;
 	long cutoff_freq;
 	void generate( float* out, int count ) const;
-	friend class Blip_Synth_;
+	friend struct blip_kernel_t;
 };
 
 int const blip_sample_bits = 30;
@@ -309,6 +354,20 @@ int const blip_reader_default_bass = 9;
 	(void) ((blip_buffer).reader_accum_ = name##_reader_accum)
 
 
+// Store sample read with BLIP_READER_READ() or sum of them into output, clamping
+// to 16 bits. Floating-point output isn't clamped, and 1.0 corresponds to 0x8000.
+inline void blip_store( blip_sample_t& out, blip_long s )
+{
+	if ( (blip_sample_t) s != s )
+		s = 0x7FFF - (s >> 24);
+	out = (blip_sample_t) s;
+}
+
+inline void blip_store( float& out, blip_long s )
+{
+	out = s * (1.0f / 0x8000);
+}
+
 // Compatibility with older version
 const long blip_unscaled = 65535;
 const int blip_low_quality  = blip_med_quality;
@@ -346,28 +405,49 @@ inline void Blip_Synth<quality,range>::offset_resampled( blip_resampled_time_t t
 	// Fails if time is beyond end of Blip_Buffer, due to a bug in caller code or the
 	// need for a longer buffer as set by set_sample_rate().
 	assert( (blip_long) (time >> BLIP_BUFFER_ACCURACY) < blip_buf->buffer_size_ );
-	delta *= impl.delta_factor;
 	blip_long* BLIP_RESTRICT buf = blip_buf->buffer_ + (time >> BLIP_BUFFER_ACCURACY);
 	int phase = (int) (time >> (BLIP_BUFFER_ACCURACY - BLIP_PHASE_BITS) & (blip_res - 1));
 
-#if BLIP_BUFFER_FAST
-	blip_long left = buf [0] + delta;
-
-	// Kind of crappy, but doing shift after multiply results in overflow.
-	// Alternate way of delaying multiply by delta_factor results in worse
-	// sub-sample resolution.
-	blip_long right = (delta >> BLIP_PHASE_BITS) * phase;
-	left  -= right;
-	right += buf [1];
-
-	buf [0] = left;
-	buf [1] = right;
+#if !BLIP_BUFFER_FAST
+	if ( blip_buf->fast_synthesis_ )
+	{
+		// line up step with center of full-quality impulse, so latency is the same
+		buf += blip_widest_impulse_ / 2 - 1;
+		delta *= impl.fast_delta_factor;
 #else
+	{
+		delta *= impl.delta_factor;
+#endif
+		blip_long left = buf [0] + delta;
+
+		// Kind of crappy, but doing shift after multiply results in overflow.
+		// Alternate way of delaying multiply by delta_factor results in worse
+		// sub-sample resolution.
+		blip_long right = (delta >> BLIP_PHASE_BITS) * phase;
+		left  -= right;
+		right += buf [1];
+
+		buf [0] = left;
+		buf [1] = right;
+		return;
+	}
+
+#if !BLIP_BUFFER_FAST
+	delta *= impl.delta_factor;
 
 	int const fwd = (blip_widest_impulse_ - quality) / 2;
+
+	#if BLIP_SYNTH_SIMD
+
+	blip_add_kernel.load( std::memory_order_relaxed )( buf + fwd,
+			impl.kernels + phase * quality, quality, delta );
+
+	#else
+
 	int const rev = fwd + quality - 2;
 	int const mid = quality / 2 - 1;
 
+	imp_t const* const impulses = impl.impulses;
 	imp_t const* BLIP_RESTRICT imp = impulses + blip_res - phase;
 
 	#if defined (_M_IX86) || defined (_M_IA64) || defined (__i486__) || \
@@ -443,6 +523,7 @@ inline void Blip_Synth<quality,range>::offset_resampled( blip_resampled_time_t t
 		buf [rev + 1] = t1;
 	#endif
 
+	#endif
 #endif
 }
 
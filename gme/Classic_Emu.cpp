@@ -43,6 +43,13 @@ void Classic_Emu::set_equalizer_( equalizer_t const& eq )
 		buf->bass_freq( (int) equalizer().bass );
 }
 
+void Classic_Emu::set_synthesis_quality_( int quality )
+{
+	Music_Emu::set_synthesis_quality_( quality );
+	if ( buf )
+		buf->fast_synthesis( quality == gme_synthesis_fast );
+}
+
 blargg_err_t Classic_Emu::set_sample_rate_( long rate )
 {
 	if ( !buf )
@@ -60,6 +67,11 @@ blargg_err_t Classic_Emu::set_multi_channel ( bool is_enabled )
         return 0;
 }
 
+void Classic_Emu::copy_buffer_state( State_Copier& copier )
+{
+	buf->copy_state( copier );
+}
+
 void Classic_Emu::mute_voices_( int mask )
 {
 	Music_Emu::mute_voices_( mask );
@@ -90,6 +102,7 @@ blargg_err_t Classic_Emu::setup_buffer( uint32_t rate )
 	change_clock_rate( rate );
 	RETURN_ERR( buf->set_channel_count( voice_count() ) );
 	set_equalizer( equalizer() );
+	set_synthesis_quality( synthesis_quality() );
 	buf_changed_count = buf->channels_changed_count();
 	return 0;
 }
@@ -101,18 +114,122 @@ blargg_err_t Classic_Emu::start_track_( int track )
 	return 0;
 }
 
+static inline long read_samples( Multi_Buffer* buf, Music_Emu::sample_t* out, long count )
+{
+	return buf->read_samples( out, count );
+}
+
+static inline long read_samples( Multi_Buffer* buf, float* out, long count )
+{
+	return buf->read_samples_float( out, count );
+}
+
+static inline long read_samples( Multi_Buffer* buf, Music_Emu::sample_t* const* out, long count )
+{
+	return buf->read_samples_planar( out, count );
+}
+
+static inline long read_samples( Multi_Buffer* buf, float* const* out, long count )
+{
+	return buf->read_samples_planar_float( out, count );
+}
+
+// Runs emulator for another buffer's worth of sound, or just enough for
+// 'frames_needed' more output frames in low-latency mode
+blargg_err_t Classic_Emu::run_frame( long frames_needed )
+{
+	if ( buf_changed_count != buf->channels_changed_count() )
+	{
+		buf_changed_count = buf->channels_changed_count();
+		remute_voices();
+	}
+	int msec = buf->length();
+	if ( low_latency() )
+	{
+		// only run as long as needed for remaining samples
+		long needed = frames_needed * 1000 / buf->sample_rate() + 1;
+		if ( msec > needed )
+			msec = (int) needed;
+	}
+	blip_time_t clocks_emulated = (int32_t) msec * clock_rate_ / 1000;
+	RETURN_ERR( run_clocks( clocks_emulated, msec ) );
+	assert( clocks_emulated );
+	buf->end_frame( clocks_emulated );
+	return 0;
+}
+
+template<class T>
+blargg_err_t Classic_Emu::play_samples( long count, T* out )
+{
+	long remain = count;
+	while ( remain )
+	{
+		remain -= read_samples( buf, &out [count - remain], remain );
+		if ( remain )
+			RETURN_ERR( run_frame( remain / buf->samples_per_frame() ) );
+	}
+	return 0;
+}
+
+template<class T>
+blargg_err_t Classic_Emu::play_planar_samples( long count, T* const* out )
+{
+	int const outs = buf->samples_per_frame() / 2;
+	assert( outs <= max_stems );
+	T* pos [max_stems];
+	long remain = count;
+	while ( remain )
+	{
+		for ( int i = 0; i < outs; i++ )
+			pos [i] = out [i] + (count - remain);
+		remain -= read_samples( buf, pos, remain );
+		if ( remain )
+			RETURN_ERR( run_frame( remain / 2 ) );
+	}
+	return 0;
+}
+
 blargg_err_t Classic_Emu::play_( long count, sample_t* out )
 {
+	return play_samples( count, out );
+}
+
+blargg_err_t Classic_Emu::play_float_( long count, float* out )
+{
+	return play_samples( count, out );
+}
+
+blargg_err_t Classic_Emu::play_planar_( long count, sample_t* const* out )
+{
+	return play_planar_samples( count, out );
+}
+
+blargg_err_t Classic_Emu::play_planar_float_( long count, float* const* out )
+{
+	return play_planar_samples( count, out );
+}
+
+blargg_err_t Classic_Emu::fast_forward_( long count )
+{
+	// with all voices muted, nothing is synthesized and buffer only has to
+	// keep its timing and filter state
+	int saved_mute = mute_mask();
+	mute_voices( ~0 );
+
 	long remain = count;
 	while ( remain )
 	{
-		remain -= buf->read_samples( &out [count - remain], remain );
+		long n = buf->samples_avail();
+		if ( n > remain )
+			n = remain;
+		buf->skip_samples( n );
+		remain -= n;
 		if ( remain )
 		{
 			if ( buf_changed_count != buf->channels_changed_count() )
 			{
 				buf_changed_count = buf->channels_changed_count();
-				remute_voices();
+				mute_voices( ~0 );
 			}
 			int msec = buf->length();
 			blip_time_t clocks_emulated = (int32_t) msec * clock_rate_ / 1000;
@@ -121,6 +238,8 @@ blargg_err_t Classic_Emu::play_( long count, sample_t* out )
 			buf->end_frame( clocks_emulated );
 		}
 	}
+
+	mute_voices( saved_mute );
 	return 0;
 }
 
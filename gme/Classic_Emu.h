@@ -22,6 +22,9 @@ protected:
 	long clock_rate() const { return clock_rate_; }
 	void change_clock_rate( uint32_t ); // experimental
 
+	// Save/load unread samples in output buffer, for use by copy_state_()
+	void copy_buffer_state( State_Copier& );
+
 	// Overridable
 	virtual void set_voice( int index, Blip_Buffer* center,
 			Blip_Buffer* left, Blip_Buffer* right ) = 0;
@@ -32,13 +35,21 @@ protected:
 	blargg_err_t set_sample_rate_( long sample_rate ) override;
 	void mute_voices_( int ) override;
 	void set_equalizer_( equalizer_t const& ) override;
+	void set_synthesis_quality_( int ) override;
 	blargg_err_t play_( long, sample_t* ) override;
+	blargg_err_t play_float_( long, float* ) override;
+	blargg_err_t play_planar_( long, sample_t* const* ) override;
+	blargg_err_t play_planar_float_( long, float* const* ) override;
+	blargg_err_t fast_forward_( long ) override;
 private:
 	Multi_Buffer* buf;
 	Multi_Buffer* stereo_buffer; // NULL if using custom buffer
 	uint32_t clock_rate_;
 	unsigned buf_changed_count;
 	int const* voice_types;
+	blargg_err_t run_frame( long frames_needed );
+	template<class T> blargg_err_t play_samples( long, T* );
+	template<class T> blargg_err_t play_planar_samples( long, T* const* );
 };
 
 inline void Classic_Emu::set_buffer( Multi_Buffer* new_buf )
@@ -28,6 +28,7 @@ static const unsigned char gz_magic[2] = {0x1f, 0x8b}; /* gzip magic header */
 #endif /* HAVE_ZLIB_H */
 
 using std::max;
+using std::min;
 
 #define RETURN_VALIDITY_CHECK( cond ) \
 	do { if ( unlikely( !(cond) ) ) return ERR_FILE_CORRUPT; } while(0)
@@ -157,19 +158,19 @@ Mem_File_Reader::Mem_File_Reader( const void* p, long s ) :
 	if( !m_begin )
 		return;
 
-	if ( gz_decompress() )
-	{
-		debug_printf( "Loaded compressed data\n" );
-		m_ownedPtr = true;
-	}
+	if ( gz_open() )
+		debug_printf( "Reading compressed data\n" );
 #endif /* HAVE_ZLIB_H */
 }
 
 #ifdef HAVE_ZLIB_H
 Mem_File_Reader::~Mem_File_Reader()
 {
-	if ( m_ownedPtr )
-		free( const_cast<char*>( m_begin ) ); // see gz_compress for the malloc
+	if ( m_zstream )
+	{
+		inflateEnd( m_zstream );
+		delete m_zstream;
+	}
 }
 #endif
 
@@ -180,6 +181,10 @@ long Mem_File_Reader::read_avail( void* p, long s )
 	long r = remain();
 	if ( s > r || s < 0 )
 		s = r;
+#ifdef HAVE_ZLIB_H
+	if ( m_zstream )
+		return gz_read( p, s );
+#endif
 	memcpy( p, m_begin + m_pos, static_cast<size_t>(s) );
 	m_pos += s;
 	return s;
@@ -192,80 +197,101 @@ blargg_err_t Mem_File_Reader::seek( long n )
 	RETURN_VALIDITY_CHECK( n >= 0 );
 	if ( n > m_size )
 		return ERR_EOF;
+#ifdef HAVE_ZLIB_H
+	if ( m_zstream )
+	{
+		// inflate up to new position, starting over if it's behind
+		if ( n < m_pos && !gz_rewind() )
+			return ERR_GZ_CANT_SEEK;
+		char buf [4096];
+		while ( m_pos < n )
+		{
+			if ( gz_read( buf, min( (long) sizeof buf, n - m_pos ) ) <= 0 )
+				return ERR_GZ_CANT_SEEK;
+		}
+		return 0;
+	}
+#endif
 	m_pos = n;
 	return 0;
 }
 
 #ifdef HAVE_ZLIB_H
 
-bool Mem_File_Reader::gz_decompress()
+bool Mem_File_Reader::gz_open()
 {
-	if ( m_size >= 2 && memcmp(m_begin, gz_magic, 2) != 0 )
+	// smallest gzip file has 10-byte header, empty block, and 8-byte trailer
+	if ( m_size < 20 || memcmp( m_begin, gz_magic, 2 ) != 0 )
 	{
 		/* Don't try to decompress non-GZ files, just assign input pointer */
 		return false;
 	}
 
-	using vec_size = size_t;
-	const vec_size full_length = static_cast<vec_size>( m_size );
-	const vec_size half_length = static_cast<vec_size>( m_size / 2 );
-
-	// We use malloc/friends here so we can realloc to grow buffer if needed
-	char *raw_data = reinterpret_cast<char *> ( malloc( full_length ) );
-	size_t raw_data_size = full_length;
-	if ( !raw_data )
+	m_zstream = BLARGG_NEW z_stream;
+	if ( !m_zstream )
 		return false;
 
-	z_stream strm;
-	strm.next_in   = const_cast<Bytef *>( reinterpret_cast<const Bytef *>( m_begin ) );
-	strm.avail_in  = static_cast<uInt>( m_size );
-	strm.total_out = 0;
-	strm.zalloc    = nullptr;
-	strm.zfree     = nullptr;
-
-	bool done = false;
+	z_stream& z = *m_zstream;
+	z.next_in  = const_cast<Bytef *>( reinterpret_cast<const Bytef *>( m_begin ) );
+	z.avail_in = static_cast<uInt>( min( m_size, (long) INT_MAX ) );
+	z.zalloc   = nullptr;
+	z.zfree    = nullptr;
+	z.opaque   = nullptr;
 
 	// Adding 16 sets bit 4, which enables zlib to auto-detect the
 	// header.
-	if ( inflateInit2(&strm, (16 + MAX_WBITS)) != Z_OK )
+	if ( inflateInit2( &z, (16 + MAX_WBITS) ) != Z_OK )
 	{
-		free( raw_data );
+		delete m_zstream;
+		m_zstream = nullptr;
 		return false;
 	}
-
-	while ( !done )
+	m_gz_size = m_size;
+
+	// Inflated size is in trailer, modulo 4G. Deflate can't compress more than
+	// 1032:1 or expand more than a little, so if size is impossible (padding or
+	// multiple members), find it by inflating everything once.
+	unsigned long size = get_le32( m_begin + m_gz_size - 4 );
+	unsigned long gz_size = static_cast<unsigned long>( m_gz_size );
+	if ( !size || size > (unsigned long) LONG_MAX || size / 1032 > gz_size ||
+			size + size / 1000 + 256 < gz_size )
 	{
-		/* If our output buffer is too small */
-		if ( strm.total_out >= raw_data_size )
-		{
-			raw_data_size += half_length;
-			raw_data = reinterpret_cast<char *>( realloc( raw_data, raw_data_size ) );
-			if ( !raw_data ) {
-				return false;
-			}
-		}
+		m_size = LONG_MAX;
+		char buf [4096];
+		while ( gz_read( buf, sizeof buf ) > 0 ) { }
+		size = m_pos;
+		if ( !gz_rewind() )
+			size = 0;
+	}
+	m_size = static_cast<long>( size );
 
-		strm.next_out  = reinterpret_cast<Bytef *>( raw_data + strm.total_out );
-		strm.avail_out = static_cast<uInt>( static_cast<uLong>( raw_data_size ) - strm.total_out );
+	return true;
+}
 
-		/* Inflate another chunk. */
-		int err = inflate( &strm, Z_SYNC_FLUSH );
-		if ( err == Z_STREAM_END )
-			done = true;
-		else if ( err != Z_OK )
-			break;
-	}
+bool Mem_File_Reader::gz_rewind()
+{
+	m_pos = 0;
+	m_zstream->next_in  = const_cast<Bytef *>( reinterpret_cast<const Bytef *>( m_begin ) );
+	m_zstream->avail_in = static_cast<uInt>( min( m_gz_size, (long) INT_MAX ) );
+	return inflateReset( m_zstream ) == Z_OK;
+}
 
-	if ( inflateEnd(&strm) != Z_OK )
+long Mem_File_Reader::gz_read( void* p, long s )
+{
+	z_stream& z = *m_zstream;
+	long count = 0;
+	while ( count < s )
 	{
-		free( raw_data );
-		return false;
+		long n = min( s - count, (long) INT_MAX );
+		z.next_out  = reinterpret_cast<Bytef *>( p ) + count;
+		z.avail_out = static_cast<uInt>( n );
+		int err = inflate( &z, Z_NO_FLUSH );
+		count += n - static_cast<long>( z.avail_out );
+		if ( err != Z_OK )
+			break; // end of stream, or data ended early or is corrupt
 	}
-
-	m_begin = raw_data;
-	m_size  = static_cast<long>( strm.total_out );
-
-	return true;
+	m_pos += count;
+	return count;
 }
 
 #endif /* HAVE_ZLIB_H */
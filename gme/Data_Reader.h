@@ -73,7 +73,8 @@ private:
 #endif /* HAVE_ZLIB_H */
 };
 
-// Treats range of memory as a file
+// Treats range of memory as a file. Gzip data is inflated as it's read, rather
+// than all at once, and must remain valid until reader is destroyed.
 class Mem_File_Reader : public File_Reader {
 public:
 	Mem_File_Reader( const void*, long size );
@@ -88,14 +89,17 @@ public:
 	blargg_err_t seek( long );
 private:
 #ifdef HAVE_ZLIB_H
-	bool gz_decompress();
+	bool gz_open();
+	bool gz_rewind();
+	long gz_read( void*, long );
 #endif /* HAVE_ZLIB_H */
 
 	const char* m_begin;
 	long m_size;
 	long m_pos;
 #ifdef HAVE_ZLIB_H
-	bool m_ownedPtr = false; // set if we must free m_begin
+	z_stream* m_zstream = nullptr; // set if m_begin is gzip data
+	long m_gz_size = 0;            // size of gzip data; m_size is inflated size
 #endif /* HAVE_ZLIB_H */
 };
 
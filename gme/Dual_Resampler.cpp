@@ -2,6 +2,7 @@
 
 #include "Dual_Resampler.h"
 
+#include "State_Copier.h"
 #include <cstdlib>
 #include <cstring>
 
@@ -40,7 +41,9 @@ blargg_err_t Dual_Resampler::reset( int pairs )
 void Dual_Resampler::resize( int pairs )
 {
 	int new_sample_buf_size = pairs * 2;
-	if ( sample_buf_size != new_sample_buf_size )
+	int new_oversamples_per_frame = int (pairs * resampler.ratio()) * 2 + 2;
+	if ( sample_buf_size != new_sample_buf_size ||
+			oversamples_per_frame != new_oversamples_per_frame )
 	{
 		if ( (unsigned) new_sample_buf_size > sample_buf.size() )
 		{
@@ -48,7 +51,7 @@ void Dual_Resampler::resize( int pairs )
 			return;
 		}
 		sample_buf_size = new_sample_buf_size;
-		oversamples_per_frame = int (pairs * resampler.ratio()) * 2 + 2;
+		oversamples_per_frame = new_oversamples_per_frame;
 		clear();
 	}
 }
@@ -67,10 +70,21 @@ void Dual_Resampler::play_frame_( Blip_Buffer& blip_buf, dsample_t* out )
 
 	resampler.write( new_count );
 
+	if ( !out )
+	{
+		// skipping
+		long count = resampler.skip_output( sample_buf_size );
+		assert( count == (long) sample_buf_size );
+		(void) count;
+		blip_buf.skip_samples( pair_count );
+		return;
+	}
+
+	// resample directly to output and add Blip_Buffer there
 #ifdef	NDEBUG // Avoid warning when asserts are disabled
-	resampler.read( sample_buf.begin(), sample_buf_size );
+	resampler.read( out, sample_buf_size );
 #else
-	long count = resampler.read( sample_buf.begin(), sample_buf_size );
+	long count = resampler.read( out, sample_buf_size );
 	assert( count == (long) sample_buf_size );
 #endif
 
@@ -110,11 +124,48 @@ void Dual_Resampler::dual_play( long count, dsample_t* out, Blip_Buffer& blip_bu
 	}
 }
 
+void Dual_Resampler::dual_skip( long count, Blip_Buffer& blip_buf )
+{
+	// empty extra buffer
+	long remain = sample_buf_size - buf_pos;
+	if ( remain > count )
+		remain = count;
+	count -= remain;
+	buf_pos += remain;
+
+	// entire frames
+	while ( count >= (long) sample_buf_size )
+	{
+		play_frame_( blip_buf, nullptr );
+		count -= sample_buf_size;
+	}
+
+	// extra is still generated since rest of frame will be played
+	if ( count )
+	{
+		play_frame_( blip_buf, sample_buf.begin() );
+		buf_pos = count;
+	}
+}
+
+void Dual_Resampler::copy_state( State_Copier& copier )
+{
+	copier.verify( sample_buf_size );
+	copier.copy_int( buf_pos );
+	if ( (unsigned) buf_pos > (unsigned) sample_buf_size )
+	{
+		copier.set_error( ERR_STATE_INVALID );
+		buf_pos = sample_buf_size;
+	}
+	copier.copy_ints( sample_buf.begin() + buf_pos, sample_buf_size - buf_pos );
+	resampler.copy_state( copier );
+}
+
 void Dual_Resampler::mix_samples( Blip_Buffer& blip_buf, dsample_t* out )
 {
 	Blip_Reader sn;
 	int bass = sn.begin( blip_buf );
-	const dsample_t* in = sample_buf.begin();
+	const dsample_t* in = out;
 
 	for ( int n = sample_buf_size >> 1; n--; )
 	{
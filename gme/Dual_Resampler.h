@@ -7,6 +7,8 @@
 #include "Fir_Resampler.h"
 #include "Blip_Buffer.h"
 
+class State_Copier;
+
 class Dual_Resampler {
 public:
 	Dual_Resampler();
@@ -15,12 +17,20 @@ public:
 	typedef short dsample_t;
 
 	double setup( double oversample, double rolloff, double gain );
+	void set_quality( int q ) { resampler.set_quality( q ); } // see Fir_Resampler_
 	blargg_err_t reset( int max_pairs );
 	void resize( int pairs_per_frame );
 	void clear();
 
 	void dual_play( long count, dsample_t* out, Blip_Buffer& );
 
+	// Same as dual_play() but without generating output. play_frame() is still
+	// called, as sound chips must be run to keep their state.
+	void dual_skip( long count, Blip_Buffer& );
+
+	// Save/load unread output and resampler input. Blip_Buffer isn't included.
+	void copy_state( State_Copier& );
+
 protected:
 	virtual int play_frame( blip_time_t, int pcm_count, dsample_t* pcm_out ) = 0;
 private:
@@ -32,7 +42,7 @@ private:
 	int resampler_size;
 
 	Fir_Resampler<12> resampler;
-	void mix_samples( Blip_Buffer&, dsample_t* );
+	void mix_samples( Blip_Buffer&, dsample_t* ); // adds to samples in place
 	void play_frame_( Blip_Buffer&, dsample_t* );
 };
 
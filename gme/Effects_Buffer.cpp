@@ -2,6 +2,7 @@
 
 #include "Effects_Buffer.h"
 
+#include "State_Copier.h"
 #include <cstring>
 #include <cstdint>
 #include <algorithm>
@@ -39,6 +40,9 @@ static const unsigned reverb_size = 8192 * 2;
 static const unsigned reverb_mask = reverb_size - 1;
 static_assert( (reverb_size & reverb_mask) == 0, "reverb_size must be a power of 2" );
 
+static const unsigned voice_delay_size = reverb_size + echo_size;
+static const unsigned delay_align = 64 / sizeof (blip_sample_t);
+
 Effects_Buffer::config_t::config_t()
 {
 	pan_1           = -0.15f;
@@ -78,8 +82,7 @@ Effects_Buffer::Effects_Buffer( int num_voices, bool center_only )
 	// TODO: Reorder buf_count to be initialized before bufs to factor out channel sizing
 	, buf_count(max_voices * (center_only ? (max_buf_count - 4) : max_buf_count))
 	, effects_enabled(false)
-	, reverb_buf(max_voices, std::vector<blip_sample_t>(reverb_size))
-	, echo_buf(max_voices, std::vector<blip_sample_t>(echo_size))
+	, delay_lines(nullptr)
 	, reverb_pos(max_voices)
 	, echo_pos(max_voices)
 {
@@ -89,24 +92,29 @@ Effects_Buffer::Effects_Buffer( int num_voices, bool center_only )
 Effects_Buffer::~Effects_Buffer()
 {}
 
-blargg_err_t Effects_Buffer::set_sample_rate( long rate, int msec ) noexcept
+inline blip_sample_t* Effects_Buffer::reverb_buf( int voice ) const
 {
-	for(int i=0; i<max_voices; i++)
-	{
-		if ( !echo_buf[i].size() )
-		{
-			echo_buf[i].resize( echo_size );
-		}
+	return delay_lines + voice * voice_delay_size;
+}
 
-		if ( !reverb_buf[i].size() )
-		{
-			reverb_buf[i].resize( reverb_size );
-		}
+inline blip_sample_t* Effects_Buffer::echo_buf( int voice ) const
+{
+	return delay_lines + voice * voice_delay_size + reverb_size;
+}
 
-		if ( !echo_buf[i].size() || !reverb_buf[i].size() )
-		{
-			return ERR_OUT_OF_MEMORY;
-		}
+void Effects_Buffer::clear_delay_lines()
+{
+	if ( delay_lines )
+		memset( delay_lines, 0, max_voices * voice_delay_size * sizeof *delay_lines );
+}
+
+blargg_err_t Effects_Buffer::set_sample_rate( long rate, int msec ) noexcept
+{
+	if ( !delay_lines )
+	{
+		RETURN_ERR( delay_buf.resize( max_voices * voice_delay_size + delay_align - 1 ) );
+		uintptr_t const align_mask = delay_align * sizeof *delay_lines - 1;
+		delay_lines = (blip_sample_t*) (((uintptr_t) delay_buf.begin() + align_mask) & ~align_mask);
 	}
 
 	for ( int i = 0; i < buf_count; i++ )
@@ -130,19 +138,18 @@ void Effects_Buffer::bass_freq( int freq )
 		bufs [i].bass_freq( freq );
 }
 
+void Effects_Buffer::fast_synthesis( bool fast )
+{
+	for ( int i = 0; i < buf_count; i++ )
+		bufs [i].fast_synthesis( fast );
+}
+
 void Effects_Buffer::clear()
 {
 	stereo_remain = 0;
 	effect_remain = 0;
 
-	for(int i=0; i<max_voices; i++)
-	{
-		if ( echo_buf[i].size() )
-			memset( &echo_buf[i][0], 0, echo_size * sizeof echo_buf[i][0] );
-
-		if ( reverb_buf[i].size() )
-			memset( &reverb_buf[i][0], 0, reverb_size * sizeof reverb_buf[i][0] );
-	}
+	clear_delay_lines();
 
 	for ( int i = 0; i < buf_count; i++ )
 		bufs [i].clear();
@@ -164,14 +171,8 @@ void Effects_Buffer::config( const config_t& cfg )
 	// clear echo and reverb buffers
 	// ensure the echo/reverb buffers have already been allocated, so this method can be
 	// called before set_sample_rate is called
-	if ( !config_.effects_enabled && cfg.effects_enabled && echo_buf[0].size() )
-	{
-		for(int i=0; i<max_voices; i++)
-		{
-			memset( &echo_buf[i][0], 0, echo_size * sizeof echo_buf[i][0] );
-			memset( &reverb_buf[i][0], 0, reverb_size * sizeof reverb_buf[i][0] );
-		}
-	}
+	if ( !config_.effects_enabled && cfg.effects_enabled )
+		clear_delay_lines();
 
 	config_ = cfg;
 
@@ -287,120 +288,75 @@ void Effects_Buffer::end_frame( blip_time_t clock_count )
 	effects_enabled = config_.effects_enabled;
 }
 
-long Effects_Buffer::samples_avail() const
-{
-	return bufs [0].samples_avail() * 2;
-}
-
-long Effects_Buffer::read_samples( blip_sample_t* out, long total_samples )
+void Effects_Buffer::copy_state( State_Copier& copier )
 {
-	const int n_channels = max_voices * 2;
-	const int buf_count_per_voice = buf_count/max_voices;
+	copier.verify( buf_count );
+	copier.verify( config_.effects_enabled );
+	copier.copy_int( stereo_remain );
+	copier.copy_int( effect_remain );
+	copier.copy_int( effects_enabled );
 
-	require( total_samples % n_channels == 0 ); // as many items needed to fill at least one frame
-
-	long remain = bufs [0].samples_avail();
-	total_samples = remain = min( remain, total_samples/n_channels );
-
-	while ( remain )
+	// echo and reverb are only touched while effects are enabled
+	if ( config_.effects_enabled )
 	{
-		int active_bufs = buf_count_per_voice;
-		long count = remain;
-
-		// optimizing mixing to skip any channels which had nothing added
-		if ( effect_remain )
-		{
-			if ( count > effect_remain )
-				count = effect_remain;
-
-			if ( stereo_remain )
-			{
-				mix_enhanced( out, count );
-			}
-			else
-			{
-				mix_mono_enhanced( out, count );
-				active_bufs = 3;
-			}
-		}
-		else if ( stereo_remain )
+		for ( int i = 0; i < max_voices; i++ )
 		{
-			mix_stereo( out, count );
-			active_bufs = 3;
-		}
-		else
-		{
-			mix_mono( out, count );
-			active_bufs = 1;
-		}
-
-		out += count * n_channels;
-		remain -= count;
-
-		stereo_remain -= count;
-		if ( stereo_remain < 0 )
-			stereo_remain = 0;
-
-		effect_remain -= count;
-		if ( effect_remain < 0 )
-			effect_remain = 0;
-
-		// skip the output from any buffers that didn't contribute to the sound output
-		// during this frame (e.g. if we only render mono then only the very first buf
-		// is 'active')
-		for ( int v = 0; v < max_voices; v++ ) // foreach voice
-		{
-			for ( int i = 0; i < buf_count_per_voice; i++) // foreach buffer of that voice
-			{
-				if ( i < active_bufs )
-					bufs [v*buf_count_per_voice + i].remove_samples( count );
-				else // keep time synchronized
-					bufs [v*buf_count_per_voice + i].remove_silence( count );
-			}
+			copier.copy_int( echo_pos [i] );
+			copier.copy_int( reverb_pos [i] );
+			copier.copy_ints( echo_buf( i ), echo_size );
+			copier.copy_ints( reverb_buf( i ), reverb_size );
+			echo_pos   [i] &= echo_mask;
+			reverb_pos [i] &= reverb_mask & ~1; // stereo pairs
 		}
 	}
 
-	return total_samples * n_channels;
+	for ( int i = 0; i < buf_count; i++ )
+		bufs [i].copy_state( copier );
+}
+
+long Effects_Buffer::samples_avail() const
+{
+	return bufs [0].samples_avail() * 2;
 }
 
-#define BLIP_MONO_READ( i ) \
-	s = BLIP_READER_READ( c ); \
-	BLIP_READER_NEXT( c, bass ); \
-	if ( (int16_t) s != s ) \
-		s = 0x7FFF - (s >> 24); \
-	((uint32_t*) out) [i] = ((uint16_t) s) | (uint16_t(s) << 16)
+#define BLIP_MONO_READ( offset ) \
+	blip_store( out [offset], BLIP_READER_READ( c ) ); \
+	out [(offset) + 1] = out [offset]; \
+	BLIP_READER_NEXT( c, bass )
 
-void Effects_Buffer::mix_mono( blip_sample_t* out_, int32_t count )
+template<class T>
+void Effects_Buffer::mix_mono( output_t<T> const& out_, int32_t count )
 {
+    int const stride = out_.stride;
     for(int i=0; i<max_voices; i++)
     {
-	int32_t s;
-	blip_sample_t* BLIP_RESTRICT out = out_;
+	T* BLIP_RESTRICT out = out_.voice( i );
 	int const bass = BLIP_READER_BASS( bufs [i*max_buf_count+0] );
 	BLIP_READER_BEGIN( c, bufs [i*max_buf_count+0] );
 
 	// unrolled loop
 	for ( int32_t n = count >> 1; n; --n )
 	{
-		BLIP_MONO_READ( i );
-		BLIP_MONO_READ( i + max_voices );
-		out += max_voices*4;
+		BLIP_MONO_READ( 0 );
+		BLIP_MONO_READ( stride );
+		out += stride*2;
 	}
 
 	if ( count & 1 )
 	{
-		BLIP_MONO_READ( i );
+		BLIP_MONO_READ( 0 );
 	}
 
 	BLIP_READER_END( c, bufs [i*max_buf_count+0] );
     }
 }
 
-void Effects_Buffer::mix_stereo( blip_sample_t* out_, int32_t frames )
+template<class T>
+void Effects_Buffer::mix_stereo( output_t<T> const& out_, int32_t frames )
 {
     for(int i=0; i<max_voices; i++)
     {
-	blip_sample_t* BLIP_RESTRICT out = out_;
+	T* BLIP_RESTRICT out = out_.voice( i );
 	int const bass = BLIP_READER_BASS( bufs [i*max_buf_count+0] );
 	BLIP_READER_BEGIN( c, bufs [i*max_buf_count+0] );
 	BLIP_READER_BEGIN( l, bufs [i*max_buf_count+1] );
@@ -416,16 +372,10 @@ void Effects_Buffer::mix_stereo( blip_sample_t* out_, int32_t frames )
 		BLIP_READER_NEXT( l, bass );
 		BLIP_READER_NEXT( r, bass );
 
-		if ( (int16_t) left != left )
-			left = 0x7FFF - (left >> 24);
-
-		if ( (int16_t) right != right )
-			right = 0x7FFF - (right >> 24);
+		blip_store( out [0], left );
+		blip_store( out [1], right );
 
-		out [i*2+0] = left;
-		out [i*2+1] = right;
-
-		out += max_voices*2;
+		out += out_.stride;
 
 	}
 
@@ -435,22 +385,456 @@ void Effects_Buffer::mix_stereo( blip_sample_t* out_, int32_t frames )
     }
 }
 
-void Effects_Buffer::mix_mono_enhanced( blip_sample_t* out_, int32_t frames )
+#if BLIP_SYNTH_SIMD
+
+#include <emmintrin.h>
+#include <immintrin.h>
+
+// State of one voice for the vector mixers
+struct effects_mix_t {
+	blip_long const* in [7]; // sq1, sq2, center, l1, r1, l2, r2
+	blip_long* accum;        // [7]
+	int bass;
+	int stride;
+	blip_sample_t* reverb_buf;
+	blip_sample_t* echo_buf;
+	unsigned reverb_pos;
+	unsigned echo_pos;
+	unsigned reverb_delay [2];
+	unsigned echo_delay [2];
+	int32_t levels [6];      // pan_1 left/right, pan_2 left/right, reverb, echo
+};
+
+static inline void transpose( __m128i& a, __m128i& b, __m128i& c, __m128i& d )
+{
+	__m128i ab_lo = _mm_unpacklo_epi32( a, b );
+	__m128i ab_hi = _mm_unpackhi_epi32( a, b );
+	__m128i cd_lo = _mm_unpacklo_epi32( c, d );
+	__m128i cd_hi = _mm_unpackhi_epi32( c, d );
+	a = _mm_unpacklo_epi64( ab_lo, cd_lo );
+	b = _mm_unpackhi_epi64( ab_lo, cd_lo );
+	c = _mm_unpacklo_epi64( ab_hi, cd_hi );
+	d = _mm_unpackhi_epi64( ab_hi, cd_hi );
+}
+
+// Level for fmul_sse2()
+struct fmul_level_t {
+	__m128i y;
+	__m128i bias;
+	explicit fmul_level_t( int32_t level ) :
+		y( _mm_set1_epi32( level ) ),
+		bias( _mm_set1_epi32( (int32_t) ((uint32_t) level << 16) ) )
+	{ }
+};
+
+// FMUL() of each lane by a level from 0 to 0x7FFFFFFF. Multiplies to 64 bits
+// like the scalar code does with long, so large sums give the same result. x is
+// offset by 0x80000000 to make it unsigned for _mm_mul_epu32(), then
+// 0x80000000 * level >> 15 is subtracted from the result.
+static inline __m128i fmul_sse2( __m128i x, fmul_level_t const& level )
+{
+	__m128i const low_32 = _mm_set_epi32( 0, -1, 0, -1 );
+	__m128i u = _mm_xor_si128( x, _mm_set1_epi32( INT32_MIN ) );
+	__m128i even = _mm_srli_epi64( _mm_mul_epu32( u, level.y ), 15 );
+	__m128i odd  = _mm_slli_epi64( _mm_mul_epu32( _mm_srli_epi64( u, 32 ), level.y ), 32 - 15 );
+	__m128i r = _mm_or_si128( _mm_and_si128( even, low_32 ), _mm_andnot_si128( low_32, odd ) );
+	return _mm_sub_epi32( r, level.bias );
+}
+
+static inline __m128i sign_extend_16( __m128i v )
+{
+	return _mm_srai_epi32( _mm_slli_epi32( v, 16 ), 16 );
+}
+
+// Delay line samples at pos, pos + 1, pos + 2, pos + 3
+static inline __m128i load_ring( blip_sample_t const* buf, unsigned pos, unsigned mask )
+{
+	if ( pos + 4 <= mask + 1 )
+	{
+		__m128i v = _mm_loadl_epi64( (__m128i const*) (buf + pos) );
+		return _mm_srai_epi32( _mm_unpacklo_epi16( v, v ), 16 );
+	}
+	return _mm_setr_epi32( buf [pos], buf [(pos + 1) & mask], buf [(pos + 2) & mask],
+			buf [(pos + 3) & mask] );
+}
+
+// Delay line samples at pos, pos + 2, pos + 4, pos + 6
+static inline __m128i load_ring_pairs( blip_sample_t const* buf, unsigned pos, unsigned mask )
+{
+	if ( pos + 8 <= mask + 1 )
+		return sign_extend_16( _mm_loadu_si128( (__m128i const*) (buf + pos) ) );
+	return _mm_setr_epi32( buf [pos], buf [(pos + 2) & mask], buf [(pos + 4) & mask],
+			buf [(pos + 6) & mask] );
+}
+
+// Stores 'count' samples from 'in' at pos, pos + 1, ...
+static inline void store_ring( blip_sample_t* buf, unsigned pos, unsigned mask,
+		blip_sample_t const* in, int count )
+{
+	if ( pos + count <= mask + 1 )
+	{
+		memcpy( buf + pos, in, count * sizeof *in );
+		return;
+	}
+	for ( int i = 0; i < count; i++ )
+		buf [(pos + i) & mask] = in [i];
+}
+
+// Each sum is well under 1 << 24, so saturating matches blip_store() exactly
+static inline void store_frames( blip_sample_t* out, int stride, __m128i first, __m128i second )
+{
+	__m128i v = _mm_packs_epi32( first, second );
+	if ( stride == 2 )
+	{
+		_mm_storeu_si128( (__m128i*) out, v );
+		return;
+	}
+	for ( int i = 0; i < 4; i++ )
+	{
+		int32_t pair = _mm_cvtsi128_si32( v );
+		memcpy( out + i * stride, &pair, sizeof pair );
+		v = _mm_srli_si128( v, 4 );
+	}
+}
+
+static inline void store_frames( float* out, int stride, __m128i first, __m128i second )
+{
+	__m128 const scale = _mm_set1_ps( 1.0f / 0x8000 );
+	__m128 f = _mm_mul_ps( _mm_cvtepi32_ps( first  ), scale );
+	__m128 s = _mm_mul_ps( _mm_cvtepi32_ps( second ), scale );
+	_mm_storel_pi( (__m64*) out, f );
+	_mm_storeh_pi( (__m64*) (out + stride), f );
+	_mm_storel_pi( (__m64*) (out + stride * 2), s );
+	_mm_storeh_pi( (__m64*) (out + stride * 3), s );
+}
+
+// Mixes 'count' frames, a multiple of 4, four at a time. The integrators of the
+// seven buffers run side by side in lanes, then are transposed so each vector
+// holds four frames of one buffer for the pan/reverb/echo math.
+template<class T>
+static inline void mix_effects_sse2( effects_mix_t& m, T* out, int32_t count )
+{
+	bool const stereo = m.in [3] != nullptr;
+	fmul_level_t const pan_1_l( m.levels [0] );
+	fmul_level_t const pan_1_r( m.levels [1] );
+	fmul_level_t const pan_2_l( m.levels [2] );
+	fmul_level_t const pan_2_r( m.levels [3] );
+	fmul_level_t const reverb_level( m.levels [4] );
+	fmul_level_t const echo_level( m.levels [5] );
+	__m128i const low_16 = _mm_set1_epi32( 0xFFFF );
+	__m128i const shift = _mm_cvtsi32_si128( m.bass );
+	__m128i const zero = _mm_setzero_si128();
+
+	// lanes hold sq1, sq2, center, l1 and r1, l2, r2, unused
+	__m128i acc_a = _mm_loadu_si128( (__m128i const*) m.accum );
+	__m128i acc_b = _mm_setr_epi32( m.accum [4], m.accum [5], m.accum [6], 0 );
+
+	#define READ_STEP( acc, v ) do {\
+		__m128i s = _mm_srai_epi32( acc, blip_sample_bits - 16 );\
+		acc = _mm_add_epi32( acc, _mm_sub_epi32( v, _mm_sra_epi32( acc, shift ) ) );\
+		v = s;\
+	} while ( 0 )
+
+	for ( int32_t n = 0; n < count; n += 4 )
+	{
+		__m128i sq1 = _mm_loadu_si128( (__m128i const*) (m.in [0] + n) );
+		__m128i sq2 = _mm_loadu_si128( (__m128i const*) (m.in [1] + n) );
+		__m128i c   = _mm_loadu_si128( (__m128i const*) (m.in [2] + n) );
+		__m128i l1 = zero, r1 = zero, l2 = zero, r2 = zero;
+		if ( stereo )
+			l1 = _mm_loadu_si128( (__m128i const*) (m.in [3] + n) );
+
+		// a vector per frame, step integrators, then back to a vector per buffer
+		transpose( sq1, sq2, c, l1 );
+		READ_STEP( acc_a, sq1 );
+		READ_STEP( acc_a, sq2 );
+		READ_STEP( acc_a, c );
+		READ_STEP( acc_a, l1 );
+		transpose( sq1, sq2, c, l1 );
+
+		if ( stereo )
+		{
+			r1 = _mm_loadu_si128( (__m128i const*) (m.in [4] + n) );
+			l2 = _mm_loadu_si128( (__m128i const*) (m.in [5] + n) );
+			r2 = _mm_loadu_si128( (__m128i const*) (m.in [6] + n) );
+			__m128i unused = zero;
+			transpose( r1, l2, r2, unused );
+			READ_STEP( acc_b, r1 );
+			READ_STEP( acc_b, l2 );
+			READ_STEP( acc_b, r2 );
+			READ_STEP( acc_b, unused );
+			transpose( r1, l2, r2, unused );
+		}
+
+		__m128i reverb_l = _mm_add_epi32( _mm_add_epi32( fmul_sse2( sq1, pan_1_l ),
+				fmul_sse2( sq2, pan_2_l ) ), _mm_add_epi32( l1, load_ring_pairs( m.reverb_buf,
+				(m.reverb_pos + m.reverb_delay [0]) & reverb_mask, reverb_mask ) ) );
+		__m128i reverb_r = _mm_add_epi32( _mm_add_epi32( fmul_sse2( sq1, pan_1_r ),
+				fmul_sse2( sq2, pan_2_r ) ), _mm_add_epi32( r1, load_ring_pairs( m.reverb_buf,
+				(m.reverb_pos + m.reverb_delay [1]) & reverb_mask, reverb_mask ) ) );
+
+		__m128i echo_l = load_ring( m.echo_buf, (m.echo_pos + m.echo_delay [0]) & echo_mask, echo_mask );
+		__m128i echo_r = load_ring( m.echo_buf, (m.echo_pos + m.echo_delay [1]) & echo_mask, echo_mask );
+
+		// reverb is stored as left/right pairs, truncated like the scalar code
+		blip_sample_t temp [8];
+		_mm_storeu_si128( (__m128i*) temp, _mm_or_si128(
+				_mm_and_si128( fmul_sse2( reverb_l, reverb_level ), low_16 ),
+				_mm_slli_epi32( fmul_sse2( reverb_r, reverb_level ), 16 ) ) );
+		store_ring( m.reverb_buf, m.reverb_pos, reverb_mask, temp, 8 );
+		m.reverb_pos = (m.reverb_pos + 8) & reverb_mask;
+
+		_mm_storel_epi64( (__m128i*) temp, _mm_packs_epi32( sign_extend_16( c ), zero ) );
+		store_ring( m.echo_buf, m.echo_pos, echo_mask, temp, 4 );
+		m.echo_pos = (m.echo_pos + 4) & echo_mask;
+
+		__m128i left  = _mm_add_epi32( _mm_add_epi32( reverb_l, c ),
+				_mm_add_epi32( l2, fmul_sse2( echo_l, echo_level ) ) );
+		__m128i right = _mm_add_epi32( _mm_add_epi32( reverb_r, c ),
+				_mm_add_epi32( r2, fmul_sse2( echo_r, echo_level ) ) );
+
+		store_frames( out, m.stride, _mm_unpacklo_epi32( left, right ),
+				_mm_unpackhi_epi32( left, right ) );
+		out += m.stride * 4;
+	}
+
+	#undef READ_STEP
+
+	blip_long temp [8];
+	_mm_storeu_si128( (__m128i*) temp, acc_a );
+	_mm_storeu_si128( (__m128i*) (temp + 4), acc_b );
+	memcpy( m.accum, temp, 7 * sizeof *temp );
+	for ( int i = 0; i < 7; i++ )
+		if ( m.in [i] )
+			m.in [i] += count;
+}
+
+BLARGG_TARGET_AVX2
+static inline void transpose8( __m256i r [8] )
+{
+	__m256i t [8];
+	for ( int i = 0; i < 8; i += 2 )
+	{
+		t [i]     = _mm256_unpacklo_epi32( r [i], r [i + 1] );
+		t [i + 1] = _mm256_unpackhi_epi32( r [i], r [i + 1] );
+	}
+	for ( int i = 0; i < 8; i += 4 )
+	{
+		r [i]     = _mm256_unpacklo_epi64( t [i],     t [i + 2] );
+		r [i + 1] = _mm256_unpackhi_epi64( t [i],     t [i + 2] );
+		r [i + 2] = _mm256_unpacklo_epi64( t [i + 1], t [i + 3] );
+		r [i + 3] = _mm256_unpackhi_epi64( t [i + 1], t [i + 3] );
+	}
+	for ( int i = 0; i < 4; i++ )
+	{
+		t [i]     = _mm256_permute2x128_si256( r [i], r [i + 4], 0x20 );
+		t [i + 4] = _mm256_permute2x128_si256( r [i], r [i + 4], 0x31 );
+	}
+	for ( int i = 0; i < 8; i++ )
+		r [i] = t [i];
+}
+
+// AVX2 has a signed 32x32 to 64 multiply, so no offset is needed
+BLARGG_TARGET_AVX2
+static inline __m256i fmul_avx2( __m256i x, __m256i y )
+{
+	__m256i even = _mm256_srli_epi64( _mm256_mul_epi32( x, y ), 15 );
+	__m256i odd  = _mm256_slli_epi64( _mm256_mul_epi32( _mm256_srli_epi64( x, 32 ), y ), 32 - 15 );
+	return _mm256_blend_epi32( even, odd, 0xAA );
+}
+
+BLARGG_TARGET_AVX2
+static inline __m256i load_ring_avx2( blip_sample_t const* buf, unsigned pos, unsigned mask )
+{
+	if ( pos + 8 <= mask + 1 )
+		return _mm256_cvtepi16_epi32( _mm_loadu_si128( (__m128i const*) (buf + pos) ) );
+	return _mm256_setr_epi32( buf [pos], buf [(pos + 1) & mask], buf [(pos + 2) & mask],
+			buf [(pos + 3) & mask], buf [(pos + 4) & mask], buf [(pos + 5) & mask],
+			buf [(pos + 6) & mask], buf [(pos + 7) & mask] );
+}
+
+BLARGG_TARGET_AVX2
+static inline __m256i load_ring_pairs_avx2( blip_sample_t const* buf, unsigned pos, unsigned mask )
+{
+	if ( pos + 16 <= mask + 1 )
+	{
+		__m256i v = _mm256_loadu_si256( (__m256i const*) (buf + pos) );
+		return _mm256_srai_epi32( _mm256_slli_epi32( v, 16 ), 16 );
+	}
+	return _mm256_setr_epi32( buf [pos], buf [(pos + 2) & mask], buf [(pos + 4) & mask],
+			buf [(pos + 6) & mask], buf [(pos + 8) & mask], buf [(pos + 10) & mask],
+			buf [(pos + 12) & mask], buf [(pos + 14) & mask] );
+}
+
+// Same as mix_effects_sse2() with eight frames at a time. All seven
+// integrators fit in one vector.
+template<class T>
+BLARGG_TARGET_AVX2
+static void mix_effects_avx2( effects_mix_t& m, T* out, int32_t count )
+{
+	__m256i const pan_1_l = _mm256_set1_epi32( m.levels [0] );
+	__m256i const pan_1_r = _mm256_set1_epi32( m.levels [1] );
+	__m256i const pan_2_l = _mm256_set1_epi32( m.levels [2] );
+	__m256i const pan_2_r = _mm256_set1_epi32( m.levels [3] );
+	__m256i const reverb_level = _mm256_set1_epi32( m.levels [4] );
+	__m256i const echo_level = _mm256_set1_epi32( m.levels [5] );
+	__m256i const low_16 = _mm256_set1_epi32( 0xFFFF );
+	__m128i const shift = _mm_cvtsi32_si128( m.bass );
+
+	__m256i acc = _mm256_setr_epi32( m.accum [0], m.accum [1], m.accum [2], m.accum [3],
+			m.accum [4], m.accum [5], m.accum [6], 0 );
+
+	int32_t const mixed = count & ~7;
+	for ( int32_t n = 0; n < mixed; n += 8 )
+	{
+		__m256i v [8];
+		for ( int i = 0; i < 7; i++ )
+			v [i] = m.in [i] ? _mm256_loadu_si256( (__m256i const*) (m.in [i] + n) ) :
+					_mm256_setzero_si256();
+		v [7] = _mm256_setzero_si256();
+
+		transpose8( v );
+		for ( int i = 0; i < 8; i++ )
+		{
+			__m256i s = _mm256_srai_epi32( acc, blip_sample_bits - 16 );
+			acc = _mm256_add_epi32( acc, _mm256_sub_epi32( v [i], _mm256_sra_epi32( acc, shift ) ) );
+			v [i] = s;
+		}
+		transpose8( v );
+
+		__m256i const sq1 = v [0], sq2 = v [1], c = v [2];
+		__m256i reverb_l = _mm256_add_epi32( _mm256_add_epi32( fmul_avx2( sq1, pan_1_l ),
+				fmul_avx2( sq2, pan_2_l ) ), _mm256_add_epi32( v [3], load_ring_pairs_avx2( m.reverb_buf,
+				(m.reverb_pos + m.reverb_delay [0]) & reverb_mask, reverb_mask ) ) );
+		__m256i reverb_r = _mm256_add_epi32( _mm256_add_epi32( fmul_avx2( sq1, pan_1_r ),
+				fmul_avx2( sq2, pan_2_r ) ), _mm256_add_epi32( v [4], load_ring_pairs_avx2( m.reverb_buf,
+				(m.reverb_pos + m.reverb_delay [1]) & reverb_mask, reverb_mask ) ) );
+
+		__m256i echo_l = load_ring_avx2( m.echo_buf, (m.echo_pos + m.echo_delay [0]) & echo_mask, echo_mask );
+		__m256i echo_r = load_ring_avx2( m.echo_buf, (m.echo_pos + m.echo_delay [1]) & echo_mask, echo_mask );
+
+		blip_sample_t temp [16];
+		_mm256_storeu_si256( (__m256i*) temp, _mm256_or_si256(
+				_mm256_and_si256( fmul_avx2( reverb_l, reverb_level ), low_16 ),
+				_mm256_slli_epi32( fmul_avx2( reverb_r, reverb_level ), 16 ) ) );
+		store_ring( m.reverb_buf, m.reverb_pos, reverb_mask, temp, 16 );
+		m.reverb_pos = (m.reverb_pos + 16) & reverb_mask;
+
+		__m256i c16 = _mm256_srai_epi32( _mm256_slli_epi32( c, 16 ), 16 );
+		_mm_storeu_si128( (__m128i*) temp, _mm_packs_epi32( _mm256_castsi256_si128( c16 ),
+				_mm256_extracti128_si256( c16, 1 ) ) );
+		store_ring( m.echo_buf, m.echo_pos, echo_mask, temp, 8 );
+		m.echo_pos = (m.echo_pos + 8) & echo_mask;
+
+		__m256i left  = _mm256_add_epi32( _mm256_add_epi32( reverb_l, c ),
+				_mm256_add_epi32( v [5], fmul_avx2( echo_l, echo_level ) ) );
+		__m256i right = _mm256_add_epi32( _mm256_add_epi32( reverb_r, c ),
+				_mm256_add_epi32( v [6], fmul_avx2( echo_r, echo_level ) ) );
+
+		// frames 0-1 4-5 and 2-3 6-7
+		__m256i lo = _mm256_unpacklo_epi32( left, right );
+		__m256i hi = _mm256_unpackhi_epi32( left, right );
+		store_frames( out, m.stride, _mm256_castsi256_si128( lo ), _mm256_castsi256_si128( hi ) );
+		store_frames( out + m.stride * 4, m.stride, _mm256_extracti128_si256( lo, 1 ),
+				_mm256_extracti128_si256( hi, 1 ) );
+		out += m.stride * 8;
+	}
+
+	blip_long temp [8];
+	_mm256_storeu_si256( (__m256i*) temp, acc );
+	memcpy( m.accum, temp, 7 * sizeof *temp );
+	for ( int i = 0; i < 7; i++ )
+		if ( m.in [i] )
+			m.in [i] += mixed;
+
+	if ( count > mixed )
+		mix_effects_sse2( m, out, count - mixed );
+}
+
+// Mixes frames of one voice with the same result as mix_enhanced(), or
+// mix_mono_enhanced() if in [3] is null. Returns number of frames mixed, a
+// multiple of 4; the rest are left for scalar code.
+template<class T>
+int32_t Effects_Buffer::mix_effects_simd( T* out, int stride, int voice, blip_long const* const in [7],
+		blip_long accum [7], int bass, int32_t count )
+{
+	// delays shorter than four frames would read what a block writes
+	if ( chans.reverb_delay_l >= (int) reverb_size - 6 || chans.reverb_delay_r >= (int) reverb_size - 6 ||
+			chans.echo_delay_l >= (int) echo_size - 3 || chans.echo_delay_r >= (int) echo_size - 3 )
+		return 0;
+
+	// negative levels only come from extreme pan settings
+	fixed_t const levels [6] = { chans.pan_1_levels [0], chans.pan_1_levels [1],
+			chans.pan_2_levels [0], chans.pan_2_levels [1], chans.reverb_level, chans.echo_level };
+	for ( int i = 0; i < 6; i++ )
+		if ( (unsigned long) levels [i] > INT32_MAX )
+			return 0;
+
+	effects_mix_t m;
+	for ( int i = 0; i < 7; i++ )
+		m.in [i] = in [i];
+	m.accum = accum;
+	m.bass = bass;
+	m.stride = stride;
+	m.reverb_buf = reverb_buf( voice );
+	m.echo_buf = echo_buf( voice );
+	m.reverb_pos = reverb_pos [voice];
+	m.echo_pos = echo_pos [voice];
+	m.reverb_delay [0] = chans.reverb_delay_l;
+	m.reverb_delay [1] = chans.reverb_delay_r;
+	m.echo_delay [0] = chans.echo_delay_l;
+	m.echo_delay [1] = chans.echo_delay_r;
+	for ( int i = 0; i < 6; i++ )
+		m.levels [i] = (int32_t) levels [i];
+
+	// checked on first use, since buffers can be mixed from other static constructors
+	static bool const use_avx2 = blargg_cpu_has_avx2();
+	int32_t const mixed = count & ~3;
+	if ( use_avx2 )
+		mix_effects_avx2( m, out, mixed );
+	else
+		mix_effects_sse2( m, out, mixed );
+
+	reverb_pos [voice] = m.reverb_pos;
+	echo_pos [voice] = m.echo_pos;
+	return mixed;
+}
+
+#endif
+
+template<class T>
+void Effects_Buffer::mix_mono_enhanced( output_t<T> const& out_, int32_t frames )
 {
 	for(int i=0; i<max_voices; i++)
 	{
-	blip_sample_t* BLIP_RESTRICT out = out_;
+	T* BLIP_RESTRICT out = out_.voice( i );
 	int const bass = BLIP_READER_BASS( bufs [i*max_buf_count+2] );
 	BLIP_READER_BEGIN( center, bufs [i*max_buf_count+2] );
 	BLIP_READER_BEGIN( sq1, bufs [i*max_buf_count+0] );
 	BLIP_READER_BEGIN( sq2, bufs [i*max_buf_count+1] );
 
-	blip_sample_t* const reverb_buf = &this->reverb_buf[i][0];
-	blip_sample_t* const echo_buf = &this->echo_buf[i][0];
+	int count = frames;
+#if BLIP_SYNTH_SIMD
+	{
+		blip_long const* const in [7] = { sq1_reader_buf, sq2_reader_buf, center_reader_buf };
+		blip_long accum [7] = { sq1_reader_accum, sq2_reader_accum, center_reader_accum };
+		int32_t n = mix_effects_simd( out, out_.stride, i, in, accum, bass, count );
+		out   += n * out_.stride;
+		count -= n;
+		sq1_reader_buf    += n;
+		sq2_reader_buf    += n;
+		center_reader_buf += n;
+		sq1_reader_accum    = accum [0];
+		sq2_reader_accum    = accum [1];
+		center_reader_accum = accum [2];
+	}
+#endif
+
+	blip_sample_t* const reverb_buf = this->reverb_buf( i );
+	blip_sample_t* const echo_buf = this->echo_buf( i );
 	int echo_pos = this->echo_pos[i];
 	int reverb_pos = this->reverb_pos[i];
 
-	int count = frames;
 	while ( count-- )
 	{
 		int sum1_s = BLIP_READER_READ( sq1 );
@@ -483,15 +867,9 @@ void Effects_Buffer::mix_mono_enhanced( blip_sample_t* out_, int32_t frames )
 		echo_buf [echo_pos] = sum3_s;
 		echo_pos = (echo_pos + 1) & echo_mask;
 
-		if ( (int16_t) left != left )
-			left = 0x7FFF - (left >> 24);
-
-		if ( (int16_t) right != right )
-			right = 0x7FFF - (right >> 24);
-
-		out [i*2+0] = left;
-		out [i*2+1] = right;
-		out += max_voices*2;
+		blip_store( out [0], left );
+		blip_store( out [1], right );
+		out += out_.stride;
 	}
 	this->reverb_pos[i] = reverb_pos;
 	this->echo_pos[i] = echo_pos;
@@ -502,11 +880,12 @@ void Effects_Buffer::mix_mono_enhanced( blip_sample_t* out_, int32_t frames )
     }
 }
 
-void Effects_Buffer::mix_enhanced( blip_sample_t* out_, int32_t frames )
+template<class T>
+void Effects_Buffer::mix_enhanced( output_t<T> const& out_, int32_t frames )
 {
     for(int i=0; i<max_voices; i++)
     {
-	blip_sample_t* BLIP_RESTRICT out = out_;
+	T* BLIP_RESTRICT out = out_.voice( i );
 	int const bass = BLIP_READER_BASS( bufs [i*max_buf_count+2] );
 	BLIP_READER_BEGIN( center, bufs [i*max_buf_count+2] );
 	BLIP_READER_BEGIN( l1, bufs [i*max_buf_count+3] );
@@ -516,12 +895,38 @@ void Effects_Buffer::mix_enhanced( blip_sample_t* out_, int32_t frames )
 	BLIP_READER_BEGIN( sq1, bufs [i*max_buf_count+0] );
 	BLIP_READER_BEGIN( sq2, bufs [i*max_buf_count+1] );
 
-	blip_sample_t* const reverb_buf = &this->reverb_buf[i][0];
-	blip_sample_t* const echo_buf = &this->echo_buf[i][0];
+	int count = frames;
+#if BLIP_SYNTH_SIMD
+	{
+		blip_long const* const in [7] = { sq1_reader_buf, sq2_reader_buf, center_reader_buf,
+				l1_reader_buf, r1_reader_buf, l2_reader_buf, r2_reader_buf };
+		blip_long accum [7] = { sq1_reader_accum, sq2_reader_accum, center_reader_accum,
+				l1_reader_accum, r1_reader_accum, l2_reader_accum, r2_reader_accum };
+		int32_t n = mix_effects_simd( out, out_.stride, i, in, accum, bass, count );
+		out   += n * out_.stride;
+		count -= n;
+		sq1_reader_buf    += n;
+		sq2_reader_buf    += n;
+		center_reader_buf += n;
+		l1_reader_buf     += n;
+		r1_reader_buf     += n;
+		l2_reader_buf     += n;
+		r2_reader_buf     += n;
+		sq1_reader_accum    = accum [0];
+		sq2_reader_accum    = accum [1];
+		center_reader_accum = accum [2];
+		l1_reader_accum     = accum [3];
+		r1_reader_accum     = accum [4];
+		l2_reader_accum     = accum [5];
+		r2_reader_accum     = accum [6];
+	}
+#endif
+
+	blip_sample_t* const reverb_buf = this->reverb_buf( i );
+	blip_sample_t* const echo_buf = this->echo_buf( i );
 	int echo_pos = this->echo_pos[i];
 	int reverb_pos = this->reverb_pos[i];
 
-	int count = frames;
 	while ( count-- )
 	{
 		int sum1_s = BLIP_READER_READ( sq1 );
@@ -560,16 +965,10 @@ void Effects_Buffer::mix_enhanced( blip_sample_t* out_, int32_t frames )
 		echo_buf [echo_pos] = sum3_s;
 		echo_pos = (echo_pos + 1) & echo_mask;
 
-		if ( (int16_t) left != left )
-			left = 0x7FFF - (left >> 24);
+		blip_store( out [0], left );
+		blip_store( out [1], right );
 
-		if ( (int16_t) right != right )
-			right = 0x7FFF - (right >> 24);
-
-		out [i*2+0] = left;
-		out [i*2+1] = right;
-
-		out += max_voices*2;
+		out += out_.stride;
 	}
 	this->reverb_pos[i] = reverb_pos;
 	this->echo_pos[i] = echo_pos;
@@ -584,3 +983,110 @@ void Effects_Buffer::mix_enhanced( blip_sample_t* out_, int32_t frames )
     }
 }
 
+template<class T>
+long Effects_Buffer::read_samples_( output_t<T> out, long frames )
+{
+	const int buf_count_per_voice = buf_count/max_voices;
+
+	long remain = bufs [0].samples_avail();
+	frames = remain = min( remain, frames );
+
+	while ( remain )
+	{
+		int active_bufs = buf_count_per_voice;
+		long count = remain;
+
+		// optimizing mixing to skip any channels which had nothing added
+		if ( effect_remain )
+		{
+			if ( count > effect_remain )
+				count = effect_remain;
+
+			if ( stereo_remain )
+			{
+				mix_enhanced( out, count );
+			}
+			else
+			{
+				mix_mono_enhanced( out, count );
+				active_bufs = 3;
+			}
+		}
+		else if ( stereo_remain )
+		{
+			mix_stereo( out, count );
+			active_bufs = 3;
+		}
+		else
+		{
+			mix_mono( out, count );
+			active_bufs = 1;
+		}
+
+		out.pos += count * out.stride;
+		remain -= count;
+
+		stereo_remain -= count;
+		if ( stereo_remain < 0 )
+			stereo_remain = 0;
+
+		effect_remain -= count;
+		if ( effect_remain < 0 )
+			effect_remain = 0;
+
+		// skip the output from any buffers that didn't contribute to the sound output
+		// during this frame (e.g. if we only render mono then only the very first buf
+		// is 'active')
+		for ( int v = 0; v < max_voices; v++ ) // foreach voice
+		{
+			for ( int i = 0; i < buf_count_per_voice; i++) // foreach buffer of that voice
+			{
+				if ( i < active_bufs )
+					bufs [v*buf_count_per_voice + i].remove_samples( count );
+				else // keep time synchronized
+					bufs [v*buf_count_per_voice + i].remove_silence( count );
+			}
+		}
+	}
+
+	return frames;
+}
+
+template<class T>
+long Effects_Buffer::read_interleaved( T* out, long total_samples )
+{
+	const int n_channels = max_voices * 2;
+	require( total_samples % n_channels == 0 ); // as many items needed to fill at least one frame
+
+	output_t<T> o = { nullptr, out, n_channels, 0 };
+	return read_samples_( o, total_samples / n_channels ) * n_channels;
+}
+
+template<class T>
+long Effects_Buffer::read_planar( T* const* out, long count )
+{
+	require( count % 2 == 0 ); // stereo pairs
+
+	output_t<T> o = { out, nullptr, 2, 0 };
+	return read_samples_( o, count / 2 ) * 2;
+}
+
+long Effects_Buffer::read_samples( blip_sample_t* out, long total_samples )
+{
+	return read_interleaved( out, total_samples );
+}
+
+long Effects_Buffer::read_samples_float( float* out, long total_samples )
+{
+	return read_interleaved( out, total_samples );
+}
+
+long Effects_Buffer::read_samples_planar( blip_sample_t* const* out, long count )
+{
+	return read_planar( out, count );
+}
+
+long Effects_Buffer::read_samples_planar_float( float* const* out, long count )
+{
+	return read_planar( out, count );
+}
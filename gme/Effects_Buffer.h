@@ -47,11 +47,16 @@ public:
 	blargg_err_t set_sample_rate( long samples_per_sec, int msec = blip_default_length ) noexcept override;
 	void clock_rate( uint32_t ) override;
 	void bass_freq( int ) override;
+	void fast_synthesis( bool ) override;
 	void clear() override;
 	channel_t channel( int, int ) override;
 	void end_frame( blip_time_t ) override;
 	long read_samples( blip_sample_t*, long ) override;
+	long read_samples_float( float*, long ) override;
+	long read_samples_planar( blip_sample_t* const*, long ) override;
+	long read_samples_planar_float( float* const*, long ) override;
 	long samples_avail() const override;
+	void copy_state( State_Copier& ) override;
 private:
 	typedef long fixed_t;
 	int max_voices;
@@ -65,8 +70,13 @@ private:
 	int buf_count;
 	bool effects_enabled;
 
-	std::vector<std::vector<blip_sample_t> > reverb_buf;
-	std::vector<std::vector<blip_sample_t> > echo_buf;
+	// Reverb and echo delay lines of all voices share one block, aligned to a
+	// cache line. Each voice has a reverb ring followed by an echo ring.
+	blargg_vector<blip_sample_t> delay_buf;
+	blip_sample_t* delay_lines;
+	blip_sample_t* reverb_buf( int voice ) const;
+	blip_sample_t* echo_buf( int voice ) const;
+	void clear_delay_lines();
 	std::vector<int> reverb_pos;
 	std::vector<int> echo_pos;
 
@@ -81,10 +91,27 @@ private:
 		fixed_t reverb_level;
 	} chans;
 
-	void mix_mono( blip_sample_t*, int32_t );
-	void mix_stereo( blip_sample_t*, int32_t );
-	void mix_enhanced( blip_sample_t*, int32_t );
-	void mix_mono_enhanced( blip_sample_t*, int32_t );
+	// Where mixers write each voice's stereo pairs: to its own buffer, or
+	// interleaved with the other voices
+	template<class T> struct output_t {
+		T* const* voices;   // null if interleaved
+		T* interleaved;
+		int stride;         // distance between frames
+		long pos;
+		T* voice( int i ) const { return voices ? voices [i] + pos : interleaved + pos + i * 2; }
+	};
+
+	template<class T> long read_interleaved( T*, long );
+	template<class T> long read_planar( T* const*, long );
+	template<class T> long read_samples_( output_t<T>, long frames );
+	template<class T> void mix_mono( output_t<T> const&, int32_t );
+	template<class T> void mix_stereo( output_t<T> const&, int32_t );
+	template<class T> void mix_enhanced( output_t<T> const&, int32_t );
+	template<class T> void mix_mono_enhanced( output_t<T> const&, int32_t );
+#if BLIP_SYNTH_SIMD
+	template<class T> int32_t mix_effects_simd( T*, int stride, int voice, blip_long const* const in [7],
+			blip_long accum [7], int bass, int32_t count );
+#endif
 };
 
 #endif
@@ -2,9 +2,11 @@
 
 #include "Fir_Resampler.h"
 
+#include "State_Copier.h"
 #include <cstring>
 #include <cstdlib>
 #include <cmath>
+#include <mutex>
 
 /* Copyright (C) 2004-2006 Shay Green. This module is free software; you
 can redistribute it and/or modify it under the terms of the GNU Lesser
@@ -51,85 +53,263 @@ static void gen_sinc( double rolloff, int width, double offset, double spacing,
 	}
 }
 
-Fir_Resampler_::Fir_Resampler_( int width, sample_t* impulses_ ) :
-	width_( width ),
-	write_offset( width * stereo - stereo ),
-	impulses( impulses_ )
+struct fir_table_t
 {
-	write_pos = nullptr;
-	res       = 1;
-	imp_phase = 0;
-	skip_bits = 0;
-	step      = stereo;
-	ratio_    = 1.0;
+	fir_table_t* next;
+	int refs;
+
+	// settings passed to time_ratio()
+	double factor;
+	double rolloff;
+	double gain;
+	int width;
+	int max_res;
+
+	double ratio;
+	int res;
+	int step;
+	int input_per_cycle;
+	short* steps;
+	short* impulses;
+	short* kernels;
+
+	bool matches( double factor, double rolloff, double gain, int width, int max_res ) const;
+	void generate();
+};
+
+// used if a table can't be allocated; passes input through unchanged
+static short const fir_passthrough_step [1] = { 2 };
+
+static std::mutex table_mutex;
+static fir_table_t* table_list;
+
+bool fir_table_t::matches( double f, double r, double g, int w, int m ) const
+{
+	return factor == f && rolloff == r && gain == g && width == w && max_res == m;
+}
+
+// Number of phases up to max_res whose cycle best matches factor
+static int find_res( double factor, int max_res, double* ratio )
+{
+	double least_error = 2;
+	double pos = 0;
+	int res = -1;
+	for ( int r = 1; r <= max_res; r++ )
+	{
+		pos += factor;
+		double nearest = floor( pos + 0.5 );
+		double error = fabs( pos - nearest );
+		if ( error < least_error )
+		{
+			res = r;
+			*ratio = nearest / res;
+			least_error = error;
+		}
+	}
+	return res;
 }
 
-Fir_Resampler_::~Fir_Resampler_() { }
+void fir_table_t::generate()
+{
+	int const stereo = 2;
+
+	step = stereo * (int) floor( ratio );
+	double fstep = fmod( ratio, 1.0 );
+
+	double filter = (ratio < 1.0) ? 1.0 : 1.0 / ratio;
+	double pos = 0.0;
+	input_per_cycle = 0;
+	for ( int i = 0; i < res; i++ )
+	{
+		gen_sinc( rolloff, int (width * filter + 1) & ~1, pos, filter,
+				double (0x7FFF * gain * filter),
+				width, impulses + i * width );
+
+		steps [i] = (short) step;
+		pos += fstep;
+		if ( pos >= 0.9999999 )
+		{
+			pos -= 1.0;
+			steps [i] += stereo;
+		}
+		input_per_cycle += steps [i];
+	}
+
+	if ( kernels )
+	{
+		// L0 R0 L1 R1 input is shuffled to L0 L1 R0 R1, so each pair of taps
+		// is stored twice
+		for ( int i = 0; i < res * width; i += 2 )
+		{
+			short* out = &kernels [i * 2];
+			out [0] = out [2] = impulses [i];
+			out [1] = out [3] = impulses [i + 1];
+		}
+	}
+}
+
+static fir_table_t* new_table( double factor, double rolloff, double gain, int width, int max_res )
+{
+	double ratio = 0.0;
+	int const res = find_res( factor, max_res, &ratio );
+
+	int const impulses_size = res * width;
+	int const kernels_size = FIR_RESAMPLER_SIMD ? impulses_size * 2 : 0;
+	fir_table_t* t = (fir_table_t*) malloc( sizeof (fir_table_t) +
+			(res + impulses_size + kernels_size) * sizeof (short) );
+	if ( !t )
+		return nullptr;
+
+	t->next     = nullptr;
+	t->refs     = 0;
+	t->factor   = factor;
+	t->rolloff  = rolloff;
+	t->gain     = gain;
+	t->width    = width;
+	t->max_res  = max_res;
+	t->ratio    = ratio;
+	t->res      = res;
+	t->steps    = (short*) (t + 1);
+	t->impulses = t->steps + res;
+	t->kernels  = kernels_size ? t->impulses + impulses_size : nullptr;
+	t->generate();
+	return t;
+}
+
+static fir_table_t* find_table( double factor, double rolloff, double gain, int width, int max_res )
+{
+	std::lock_guard<std::mutex> lock( table_mutex );
+
+	fir_table_t* t = table_list;
+	while ( t && !t->matches( factor, rolloff, gain, width, max_res ) )
+		t = t->next;
+
+	if ( !t )
+	{
+		t = new_table( factor, rolloff, gain, width, max_res );
+		if ( !t )
+			return nullptr;
+		t->next = table_list;
+		table_list = t;
+	}
+	t->refs++;
+	return t;
+}
+
+static void release_table( fir_table_t* t )
+{
+	if ( !t )
+		return;
+
+	std::lock_guard<std::mutex> lock( table_mutex );
+	if ( --t->refs )
+		return;
+
+	fir_table_t** p = &table_list;
+	while ( *p != t )
+		p = &(*p)->next;
+	*p = t->next;
+	free( t );
+}
+
+Fir_Resampler_::Fir_Resampler_( int width ) :
+	max_width( width )
+{
+	read_pos     = nullptr;
+	write_pos    = nullptr;
+	buf_size     = 0;
+	res          = 1;
+	imp_phase    = 0;
+	width_       = width;
+	write_offset = width * stereo - stereo;
+	step         = stereo;
+	input_per_cycle = stereo;
+	quality_     = normal_quality;
+	channels_    = stereo;
+	ratio_       = 1.0;
+	table        = nullptr;
+	steps        = fir_passthrough_step;
+	impulses     = nullptr;
+	kernels      = nullptr;
+}
+
+Fir_Resampler_::~Fir_Resampler_()
+{
+	release_table( table );
+}
 
 void Fir_Resampler_::clear()
 {
 	imp_phase = 0;
 	if ( buf.size() )
 	{
+		read_pos  = buf.begin();
 		write_pos = &buf [write_offset];
 		memset( buf.begin(), 0, write_offset * sizeof buf [0] );
 	}
 }
 
+void Fir_Resampler_::set_channels( int n )
+{
+	require( n >= stereo && n <= max_channels && n % stereo == 0 );
+	channels_    = n;
+	write_offset = width_ * n - n;
+}
+
 blargg_err_t Fir_Resampler_::buffer_size( int new_size )
 {
-	RETURN_ERR( buf.resize( new_size + write_offset ) );
+	// twice the window, so input is moved back at most once per window of reads
+	int const size = new_size + max_width * channels_ - channels_;
+	RETURN_ERR( buf.resize( size * 2 ) );
+	buf_size = size;
 	clear();
 	return 0;
 }
 
-double Fir_Resampler_::time_ratio( double new_factor, double rolloff, double gain )
+void Fir_Resampler_::remove_input( sample_t const* new_read_pos )
 {
-	ratio_ = new_factor;
-
-	double fstep = 0.0;
+	int count = write_pos - new_read_pos;
+	read_pos = &buf [new_read_pos - buf.begin()];
+	if ( read_pos + buf_size > buf.end() )
 	{
-		double least_error = 2;
-		double pos = 0;
-		res = -1;
-		for ( int r = 1; r <= max_res; r++ )
-		{
-			pos += ratio_;
-			double nearest = floor( pos + 0.5 );
-			double error = fabs( pos - nearest );
-			if ( error < least_error )
-			{
-				res = r;
-				fstep = nearest / res;
-				least_error = error;
-			}
-		}
+		memmove( buf.begin(), read_pos, count * sizeof *read_pos );
+		read_pos = buf.begin();
 	}
+	write_pos = read_pos + count;
+}
 
-	skip_bits = 0;
-
-	step = stereo * (int) floor( fstep );
+double Fir_Resampler_::time_ratio( double factor, double rolloff, double gain )
+{
+	int width = max_width;
+	if ( quality_ == fast_quality && width >= 8 )
+		width = width / 2 & ~1;
+	int const max_phases = (quality_ == precise_quality) ? max_precise_res : max_res;
 
-	ratio_ = fstep;
-	fstep = fmod( fstep, 1.0 );
+	fir_table_t* t = find_table( factor, rolloff, gain, width, max_phases );
+	release_table( table );
+	table = t;
 
-	double filter = (ratio_ < 1.0) ? 1.0 : 1.0 / ratio_;
-	double pos = 0.0;
-	input_per_cycle = 0;
-	for ( int i = 0; i < res; i++ )
+	width_       = width;
+	write_offset = width * channels_ - channels_;
+	if ( t )
 	{
-		gen_sinc( rolloff, int (width_ * filter + 1) & ~1, pos, filter,
-				double (0x7FFF * gain * filter),
-				(int) width_, impulses + i * width_ );
-
-		pos += fstep;
-		input_per_cycle += step;
-		if ( pos >= 0.9999999 )
-		{
-			pos -= 1.0;
-			skip_bits |= 1 << i;
-			input_per_cycle++;
-		}
+		ratio_   = t->ratio;
+		res      = t->res;
+		step     = t->step;
+		input_per_cycle = t->input_per_cycle;
+		steps    = t->steps;
+		impulses = t->impulses;
+		kernels  = t->kernels;
+	}
+	else
+	{
+		ratio_   = 1.0;
+		res      = 1;
+		step     = stereo;
+		input_per_cycle = stereo;
+		steps    = fir_passthrough_step;
+		impulses = nullptr;
+		kernels  = nullptr;
 	}
 
 	clear();
@@ -137,64 +317,366 @@ double Fir_Resampler_::time_ratio( double new_factor, double rolloff, double gai
 	return ratio_;
 }
 
+// Steps in tables are in stereo samples, so those counts are converted to and from
+// units of that size for more channels
+
 int Fir_Resampler_::input_needed( int32_t output_count ) const
 {
+	int const pairs = channels_ / stereo;
+	output_count /= pairs;
 	int32_t input_count = 0;
 
-	unsigned long skip = skip_bits >> imp_phase;
-	int remain = res - imp_phase;
+	int phase = imp_phase;
 	while ( (output_count -= 2) > 0 )
 	{
-		input_count += step + (skip & 1) * stereo;
-		skip >>= 1;
-		if ( !--remain )
-		{
-			skip = skip_bits;
-			remain = res;
-		}
+		input_count += steps [phase];
+		if ( ++phase >= res )
+			phase = 0;
 		output_count -= 2;
 	}
 
-	long input_extra = input_count - (write_pos - &buf [(width_ - 1) * stereo]);
+	long input_extra = input_count * pairs - (write_pos - (read_pos + (width_ - 1) * channels_));
 	if ( input_extra < 0 )
 		input_extra = 0;
 	return input_extra;
 }
 
+int Fir_Resampler_::avail() const
+{
+	int const pairs = channels_ / stereo;
+	return avail_( (write_pos - (read_pos + width_ * channels_)) / pairs ) * pairs;
+}
+
 int Fir_Resampler_::avail_( int32_t input_count ) const
 {
 	int cycle_count = input_count / input_per_cycle;
 	int output_count = cycle_count * res * stereo;
 	input_count -= cycle_count * input_per_cycle;
 
-	uint32_t skip = skip_bits >> imp_phase;
-	int remain = res - imp_phase;
+	int phase = imp_phase;
 	while ( input_count >= 0 )
 	{
-		input_count -= step + (skip & 1) * stereo;
-		skip >>= 1;
-		if ( !--remain )
-		{
-			skip = skip_bits;
-			remain = res;
-		}
+		input_count -= steps [phase];
+		if ( ++phase >= res )
+			phase = 0;
 		output_count += 2;
 	}
 	return output_count;
 }
 
+void Fir_Resampler_::copy_state( State_Copier& copier )
+{
+	copier.copy_int( imp_phase );
+	int count = write_pos - read_pos;
+	copier.copy_int( count );
+	if ( (unsigned) count > (unsigned) buf_size || (unsigned) imp_phase >= (unsigned) res )
+	{
+		copier.set_error( ERR_STATE_INVALID );
+		count     = buf_size;
+		imp_phase = 0;
+	}
+	copier.copy_ints( read_pos, count );
+	write_pos = read_pos + count;
+}
+
+int Fir_Resampler_::skip_output( int32_t count )
+{
+	// same stepping as read()
+	sample_t const* in = read_pos;
+	sample_t const* end_pos = write_pos;
+	int phase = imp_phase;
+	bool const should_resample = fabs( ratio() - 1.0 ) >= 0.00001;
+	int const pairs = channels_ / stereo;
+	int32_t skipped = 0;
+
+	count /= channels_;
+	if ( end_pos - in >= width_ * channels_ )
+	{
+		end_pos -= width_ * channels_;
+		do
+		{
+			if ( --count < 0 )
+				break;
+
+			if ( should_resample )
+			{
+				in += steps [phase] * pairs;
+				if ( ++phase >= res )
+					phase = 0;
+			}
+			else
+			{
+				in += step * pairs;
+			}
+
+			skipped += channels_;
+		}
+		while ( in <= end_pos );
+	}
+
+	imp_phase = phase;
+	remove_input( in );
+
+	return skipped;
+}
+
 int Fir_Resampler_::skip_input( long count )
 {
-	int remain = write_pos - buf.begin();
-	int max_count = remain - width_ * stereo;
+	int max_count = write_pos - read_pos - width_ * channels_;
 	if ( max_count < 0 )
 		max_count = 0;
 	if ( count > max_count )
 		count = max_count;
 
-	remain -= count;
-	write_pos = &buf [remain];
-	memmove( buf.begin(), &buf [count], remain * sizeof buf [0] );
+	remove_input( read_pos + count );
 
 	return count;
 }
+
+// Stores 'count' channels of 'width'-point FIR at 'in', where there are 'chans'
+// interleaved channels
+static void fir_wide_calc( short const* in, short const* imp, int width, int chans,
+		int count, short* out )
+{
+	int32_t sum [Fir_Resampler_::max_channels] = { 0 };
+	for ( int n = 0; n < width; n++, in += chans )
+	{
+		int const pt = imp [n];
+		for ( int c = 0; c < count; c++ )
+			sum [c] += pt * in [c];
+	}
+	for ( int c = 0; c < count; c++ )
+		out [c] = (short) (sum [c] >> 15);
+}
+
+#if FIR_RESAMPLER_SIMD
+
+#include <emmintrin.h>
+#include <immintrin.h>
+
+// Sums are the same 32-bit products and wrap the same as the portable loop,
+// so output is identical
+
+struct fir_dot_sse2 {
+	static __m128i shuffle( __m128i in )
+	{
+		in = _mm_shufflelo_epi16( in, _MM_SHUFFLE( 3, 1, 2, 0 ) );
+		return _mm_shufflehi_epi16( in, _MM_SHUFFLE( 3, 1, 2, 0 ) );
+	}
+
+	// Stores L and R of 'width'-point FIR at 'in' to out [0] and out [1]
+	static void calc( short const* in, short const* kernel, int width, short* out )
+	{
+		// lanes hold partial L, R, L, R
+		__m128i sum = _mm_setzero_si128();
+		int n = width * 2;
+		for ( ; n >= 8; n -= 8, in += 8, kernel += 8 )
+			sum = _mm_add_epi32( sum, _mm_madd_epi16(
+					shuffle( _mm_loadu_si128( (__m128i const*) in ) ),
+					_mm_loadu_si128( (__m128i const*) kernel ) ) );
+		if ( n )
+			sum = _mm_add_epi32( sum, _mm_madd_epi16(
+					shuffle( _mm_loadl_epi64( (__m128i const*) in ) ),
+					_mm_loadl_epi64( (__m128i const*) kernel ) ) );
+
+		sum = _mm_add_epi32( sum, _mm_shuffle_epi32( sum, _MM_SHUFFLE( 1, 0, 3, 2 ) ) );
+		sum = _mm_srai_epi32( sum, 15 );
+		out [0] = (short) _mm_cvtsi128_si32( sum );
+		out [1] = (short) _mm_cvtsi128_si32( _mm_srli_si128( sum, 4 ) );
+	}
+};
+
+struct fir_dot_avx2 {
+	BLARGG_TARGET_AVX2
+	static void calc( short const* in, short const* kernel, int width, short* out )
+	{
+		__m256i const order = _mm256_setr_epi8(
+				0, 1, 4, 5, 2, 3, 6, 7, 8, 9, 12, 13, 10, 11, 14, 15,
+				0, 1, 4, 5, 2, 3, 6, 7, 8, 9, 12, 13, 10, 11, 14, 15 );
+		__m256i sum8 = _mm256_setzero_si256();
+		int n = width * 2;
+		for ( ; n >= 16; n -= 16, in += 16, kernel += 16 )
+			sum8 = _mm256_add_epi32( sum8, _mm256_madd_epi16(
+					_mm256_shuffle_epi8( _mm256_loadu_si256( (__m256i const*) in ), order ),
+					_mm256_loadu_si256( (__m256i const*) kernel ) ) );
+
+		__m128i sum = _mm_add_epi32( _mm256_castsi256_si128( sum8 ),
+				_mm256_extracti128_si256( sum8, 1 ) );
+		__m128i const order4 = _mm256_castsi256_si128( order );
+		if ( n >= 8 )
+		{
+			sum = _mm_add_epi32( sum, _mm_madd_epi16(
+					_mm_shuffle_epi8( _mm_loadu_si128( (__m128i const*) in ), order4 ),
+					_mm_loadu_si128( (__m128i const*) kernel ) ) );
+			n -= 8;
+			in += 8;
+			kernel += 8;
+		}
+		if ( n )
+			sum = _mm_add_epi32( sum, _mm_madd_epi16(
+					_mm_shuffle_epi8( _mm_loadl_epi64( (__m128i const*) in ), order4 ),
+					_mm_loadl_epi64( (__m128i const*) kernel ) ) );
+
+		sum = _mm_add_epi32( sum, _mm_shuffle_epi32( sum, _MM_SHUFFLE( 1, 0, 3, 2 ) ) );
+		sum = _mm_srai_epi32( sum, 15 );
+		out [0] = (short) _mm_cvtsi128_si32( sum );
+		out [1] = (short) _mm_extract_epi32( sum, 1 );
+	}
+};
+
+struct fir_read_t {
+	short const* in;
+	short* out;
+	int count;
+	int phase;
+};
+
+// Same stepping as Fir_Resampler<width>::read()
+template<class Dot>
+static inline void fir_read( fir_read_t& r, short const* end_pos, short const* kernels,
+		int width, short const* steps, int res )
+{
+	short const* in = r.in;
+	short* out = r.out;
+	int count = r.count;
+	int phase = r.phase;
+	short const* kernel = kernels + phase * width * 2;
+	do
+	{
+		if ( --count < 0 )
+			break;
+
+		Dot::calc( in, kernel, width, out );
+		kernel += width * 2;
+
+		in += steps [phase];
+		if ( ++phase >= res )
+		{
+			kernel = kernels;
+			phase = 0;
+		}
+
+		out += 2;
+	}
+	while ( in <= end_pos );
+
+	r.in = in;
+	r.out = out;
+	r.phase = phase;
+}
+
+typedef void (*fir_read_func_t)( fir_read_t&, short const*, short const*, int, short const*, int );
+
+static void fir_read_sse2( fir_read_t& r, short const* end_pos, short const* kernels,
+		int width, short const* steps, int res )
+{
+	fir_read<fir_dot_sse2>( r, end_pos, kernels, width, steps, res );
+}
+
+BLARGG_TARGET_AVX2
+static void fir_read_avx2( fir_read_t& r, short const* end_pos, short const* kernels,
+		int width, short const* steps, int res )
+{
+	fir_read<fir_dot_avx2>( r, end_pos, kernels, width, steps, res );
+}
+
+int Fir_Resampler_::read_simd( sample_t* out_begin, int32_t count )
+{
+	// picked on first use, since resamplers can run from other static constructors
+	static fir_read_func_t const fir_read_kernel = blargg_cpu_has_avx2() ? fir_read_avx2 : fir_read_sse2;
+
+	fir_read_t r;
+	r.in    = read_pos;
+	r.out   = out_begin;
+	r.count = count >> 1;
+	r.phase = imp_phase;
+	if ( write_pos - r.in >= width_ * stereo )
+		fir_read_kernel( r, write_pos - width_ * stereo, kernels, width_, steps, res );
+	imp_phase = r.phase;
+	remove_input( r.in );
+
+	return r.out - out_begin;
+}
+
+#endif
+
+#if FIR_RESAMPLER_SIMD
+
+// Calculates eight channels at a time, pairing taps as fir_dot_sse2 does
+static void fir_wide_calc_sse2( short const* in, short const* imp, int width, int chans, short* out )
+{
+	int c = 0;
+	for ( ; c + 8 <= chans; c += 8 )
+	{
+		__m128i lo = _mm_setzero_si128();
+		__m128i hi = _mm_setzero_si128();
+		short const* i = in + c;
+		for ( int n = 0; n < width; n += 2, i += chans * 2 )
+		{
+			__m128i a = _mm_loadu_si128( (__m128i const*) i );
+			__m128i b = _mm_loadu_si128( (__m128i const*) (i + chans) );
+			__m128i k = _mm_unpacklo_epi16( _mm_set1_epi16( imp [n] ), _mm_set1_epi16( imp [n + 1] ) );
+			lo = _mm_add_epi32( lo, _mm_madd_epi16( _mm_unpacklo_epi16( a, b ), k ) );
+			hi = _mm_add_epi32( hi, _mm_madd_epi16( _mm_unpackhi_epi16( a, b ), k ) );
+		}
+
+		// truncate to 16 bits as the portable code does, rather than saturate
+		lo = _mm_srai_epi32( _mm_slli_epi32( _mm_srai_epi32( lo, 15 ), 16 ), 16 );
+		hi = _mm_srai_epi32( _mm_slli_epi32( _mm_srai_epi32( hi, 15 ), 16 ), 16 );
+		_mm_storeu_si128( (__m128i*) (out + c), _mm_packs_epi32( lo, hi ) );
+	}
+	if ( c < chans )
+		fir_wide_calc( in + c, imp, width, chans, chans - c, out + c );
+}
+
+#endif
+
+// Same stepping as Fir_Resampler<width>::read(), with all channels calculated
+// for each output frame
+int Fir_Resampler_::read_wide( sample_t* out_begin, int32_t count )
+{
+	int const chans = channels_;
+	int const pairs = chans / stereo;
+	sample_t* out = out_begin;
+	sample_t const* in = read_pos;
+	int phase = imp_phase;
+	bool const should_resample = fabs( ratio() - 1.0 ) >= 0.00001;
+
+	count /= chans;
+	if ( write_pos - in >= width_ * chans )
+	{
+		sample_t const* end_pos = write_pos - width_ * chans;
+		do
+		{
+			if ( --count < 0 )
+				break;
+
+			if ( !should_resample )
+			{
+				memcpy( out, in, chans * sizeof *out );
+				in += step * pairs;
+			}
+			else
+			{
+				sample_t const* imp = &impulses [phase * width_];
+				#if FIR_RESAMPLER_SIMD
+					fir_wide_calc_sse2( in, imp, width_, chans, out );
+				#else
+					fir_wide_calc( in, imp, width_, chans, chans, out );
+				#endif
+
+				in += steps [phase] * pairs;
+				if ( ++phase >= res )
+					phase = 0;
+			}
+
+			out += chans;
+		}
+		while ( in <= end_pos );
+	}
+
+	imp_phase = phase;
+	remove_input( in );
+
+	return out - out_begin;
+}
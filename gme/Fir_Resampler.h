@@ -5,9 +5,20 @@
 #define FIR_RESAMPLER_H
 
 #include "blargg_common.h"
+#include "blargg_simd.h"
 #include <cstring>
 #include <cstdint>
 
+class State_Copier;
+
+// Use SSE2/AVX2 to calculate output samples in read(), selected at run time.
+// Define to 0 to always use the portable code.
+#ifndef FIR_RESAMPLER_SIMD
+	#define FIR_RESAMPLER_SIMD BLARGG_SIMD
+#endif
+
+struct fir_table_t;
+
 class Fir_Resampler_ {
 public:
 
@@ -20,6 +31,20 @@ public:
 	// Current input/output ratio
 	double ratio() const { return ratio_; }
 
+	// Quality used by following calls to time_ratio(). fast_quality uses half as
+	// many points. precise_quality rounds the ratio to 512 phases rather than 32,
+	// which avoids pitch and timing drift for ratios such as 32000:44100.
+	enum { normal_quality = 0, fast_quality = 1, precise_quality = 2 };
+	void set_quality( int q ) { quality_ = q; }
+	int quality() const { return quality_; }
+
+	// Number of interleaved channels in input and output, which must be even. Each
+	// pair is resampled as a separate stereo resampler would, but in a single pass.
+	// Call buffer_size() after this. Default is 2.
+	enum { max_channels = 32 };
+	void set_channels( int );
+	int channels() const { return channels_; }
+
 // Input
 
 	typedef short sample_t;
@@ -32,7 +57,7 @@ public:
 	void clear();
 
 	// Number of input samples that can be written
-	int max_write() const { return buf.end() - write_pos; }
+	int max_write() const { return read_pos + buf_size - write_pos; }
 
 	// Pointer to place to write input samples
 	sample_t* buffer() { return write_pos; }
@@ -41,38 +66,61 @@ public:
 	void write( long count );
 
 	// Number of input samples in buffer
-	int written() const { return write_pos - &buf [write_offset]; }
+	int written() const { return write_pos - (read_pos + write_offset); }
 
 	// Skip 'count' input samples. Returns number of samples actually skipped.
 	int skip_input( long count );
 
+	// Save/load buffered input and phase
+	void copy_state( State_Copier& );
+
 // Output
 
 	// Number of extra input samples needed until 'count' output samples are available
 	int input_needed( int32_t count ) const;
 
 	// Number of output samples available
-	int avail() const { return avail_( write_pos - &buf [width_ * stereo] ); }
+	int avail() const;
+
+	// Remove input for at most 'count' output samples without calculating them,
+	// leaving resampler as read() would. Returns number of samples skipped.
+	int skip_output( int32_t count );
 
 public:
 	~Fir_Resampler_();
 protected:
 	enum { stereo = 2 };
-	enum { max_res = 32 };
+	enum { max_res = 32, max_precise_res = 512 };
+
+	// Input is read from a window of buf_size samples that advances through buf,
+	// so it only needs to be moved back to the beginning once the window
+	// reaches the end, rather than after every read
 	blargg_vector<sample_t> buf;
+	sample_t* read_pos;
 	sample_t* write_pos;
+	int buf_size;
 	int res;
 	int imp_phase;
-	int const width_;
-	int const write_offset;
-	uint32_t skip_bits;
+	int const max_width;
+	int width_;
+	int write_offset;
 	int step;
 	int input_per_cycle;
+	int quality_;
+	int channels_;
 	double ratio_;
-	sample_t* impulses;
 
-	Fir_Resampler_( int width, sample_t* );
+	// Tables are shared by all resamplers with the same settings
+	fir_table_t* table;
+	short const* steps;         // input to advance after each phase
+	sample_t const* impulses;   // [res] [width_]
+	sample_t const* kernels;    // impulse pairs repeated to line up with stereo input
+
+	Fir_Resampler_( int width );
 	int avail_( int32_t input_count ) const;
+	int read_simd( sample_t*, int32_t count );
+	int read_wide( sample_t*, int32_t count );
+	void remove_input( sample_t const* new_read_pos );
 };
 
 // Width is number of points in FIR. Must be even and 4 or more. More points give
@@ -80,9 +128,8 @@ protected:
 template<int width>
 class Fir_Resampler : public Fir_Resampler_ {
 	static_assert( width >= 4 && width % 2 == 0, "FIR width must be even and have 4 or more points" );
-	short impulses [max_res] [width];
 public:
-	Fir_Resampler() : Fir_Resampler_( width, impulses [0] ) { }
+	Fir_Resampler() : Fir_Resampler_( width ) { }
 
 	// Read at most 'count' samples. Returns number of samples actually read.
 	typedef short sample_t;
@@ -94,21 +141,18 @@ public:
 inline void Fir_Resampler_::write( long count )
 {
 	write_pos += count;
-	assert( write_pos <= buf.end() );
+	assert( write_pos <= read_pos + buf_size );
 }
 
 template<int width>
 int Fir_Resampler<width>::read( sample_t* out_begin, int32_t count )
 {
 	sample_t* out = out_begin;
-	const sample_t* in = buf.begin();
+	const sample_t* in = read_pos;
 	sample_t* end_pos = write_pos;
-	uint32_t skip = skip_bits >> imp_phase;
-	sample_t const* imp = impulses [imp_phase];
-	int remain = res - imp_phase;
-	int const step = this->step;
-
-	count >>= 1;
+	int phase = imp_phase;
+	sample_t const* imp = &impulses [phase * width_];
+	int const taps = width_;
 
 	// Resampling can add noise so don't actually do it if we've matched sample
 	// rate
@@ -116,9 +160,19 @@ int Fir_Resampler<width>::read( sample_t* out_begin, int32_t count )
 	const bool should_resample =
 		( ratio1 >= 0 ? ratio1 : -ratio1 ) >= 0.00001;
 
-	if ( end_pos - in >= width * stereo )
+	if ( channels_ != stereo )
+		return read_wide( out_begin, count );
+
+	#if FIR_RESAMPLER_SIMD
+		if ( should_resample )
+			return read_simd( out_begin, count );
+	#endif
+
+	count >>= 1;
+
+	if ( end_pos - in >= taps * stereo )
 	{
-		end_pos -= width * stereo;
+		end_pos -= taps * stereo;
 		do
 		{
 			count--;
@@ -129,6 +183,7 @@ int Fir_Resampler<width>::read( sample_t* out_begin, int32_t count )
 			{
 				out [0] = static_cast<sample_t>( in [0] );
 				out [1] = static_cast<sample_t>( in [1] );
+				in += step;
 			}
 			else
 			{
@@ -138,7 +193,7 @@ int Fir_Resampler<width>::read( sample_t* out_begin, int32_t count )
 
 				const sample_t* i = in;
 
-				for ( int n = width / 2; n; --n )
+				for ( int n = taps / 2; n; --n )
 				{
 					int pt0 = imp [0];
 					l += pt0 * i [0];
@@ -150,36 +205,28 @@ int Fir_Resampler<width>::read( sample_t* out_begin, int32_t count )
 					i += 4;
 				}
 
-				remain--;
-
 				l >>= 15;
 				r >>= 15;
 
-				in += (skip * stereo) & stereo;
-				skip >>= 1;
+				in += steps [phase];
 
-				if ( !remain )
+				if ( ++phase >= res )
 				{
-					imp = impulses [0];
-					skip = skip_bits;
-					remain = res;
+					imp = impulses;
+					phase = 0;
 				}
 
 				out [0] = (sample_t) l;
 				out [1] = (sample_t) r;
 			}
 
-			in += step;
 			out += 2;
 		}
 		while ( in <= end_pos );
 	}
 
-	imp_phase = res - remain;
-
-	int left = write_pos - in;
-	write_pos = &buf [left];
-	memmove( buf.begin(), in, left * sizeof *in );
+	imp_phase = phase;
+	remove_input( in );
 
 	return out - out_begin;
 }
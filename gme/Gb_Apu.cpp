@@ -2,6 +2,7 @@
 
 #include "Gb_Apu.h"
 
+#include "State_Copier.h"
 #include <cstring>
 #include <algorithm>
 
@@ -148,19 +149,17 @@ void Gb_Apu::run_until( blip_time_t end_time )
 		{
 			Gb_Osc& osc = *oscs [i];
 			if ( osc.output )
-			{
 				osc.output->set_modified(); // TODO: misses optimization opportunities?
-				int playing = false;
-				if ( osc.enabled && osc.volume &&
-						(!(osc.regs [4] & osc.len_enabled_mask) || osc.length) )
-					playing = -1;
-				switch ( i )
-				{
-				case 0: square1.run( last_time, time, playing ); break;
-				case 1: square2.run( last_time, time, playing ); break;
-				case 2: wave   .run( last_time, time, playing ); break;
-				case 3: noise  .run( last_time, time, playing ); break;
-				}
+			int playing = false;
+			if ( osc.enabled && osc.volume &&
+					(!(osc.regs [4] & osc.len_enabled_mask) || osc.length) )
+				playing = -1;
+			switch ( i )
+			{
+			case 0: square1.run( last_time, time, playing ); break;
+			case 1: square2.run( last_time, time, playing ); break;
+			case 2: wave   .run( last_time, time, playing ); break;
+			case 3: noise  .run( last_time, time, playing ); break;
 			}
 		}
 		last_time = time;
@@ -309,3 +308,48 @@ int Gb_Apu::read_register( blip_time_t time, unsigned addr )
 
 	return data;
 }
+
+void Gb_Apu::copy_state( State_Copier& copier )
+{
+	copier.copy_int( next_frame_time );
+	copier.copy_int( last_time );
+	copier.copy_int( frame_count );
+	copier.copy( regs, sizeof regs );
+
+	for ( int i = 0; i < osc_count; i++ )
+	{
+		Gb_Osc& osc = *oscs [i];
+		copier.copy_int( osc.output_select );
+		if ( (unsigned) osc.output_select > 3 )
+		{
+			copier.set_error( ERR_STATE_INVALID );
+			osc.output_select = 0;
+		}
+		osc.output = osc.outputs [osc.output_select];
+		copier.copy_int( osc.delay );
+		copier.copy_int( osc.last_amp );
+		copier.copy_int( osc.volume );
+		copier.copy_int( osc.length );
+		copier.copy_int( osc.enabled );
+	}
+
+	Gb_Square* const squares [2] = { &square1, &square2 };
+	for ( int i = 0; i < 2; i++ )
+	{
+		Gb_Square& sq = *squares [i];
+		copier.copy_int( sq.env_delay );
+		copier.copy_int( sq.sweep_delay );
+		copier.copy_int( sq.sweep_freq );
+		copier.copy_int( sq.phase );
+	}
+
+	copier.copy_int( noise.env_delay );
+	copier.copy_int( noise.bits );
+
+	copier.copy_int( wave.wave_pos );
+	wave.wave_pos &= wave.wave_size - 1;
+	copier.copy( wave.wave, sizeof wave.wave );
+
+	if ( copier.loading() )
+		update_volume();
+}
@@ -6,6 +6,8 @@
 
 #include "Gb_Oscs.h"
 
+class State_Copier;
+
 class Gb_Apu {
 public:
 
@@ -50,6 +52,9 @@ public:
 
 	void set_tempo( double );
 
+	// Save/load emulation state between frames, using a portable format
+	void copy_state( State_Copier& );
+
 public:
 	Gb_Apu();
 private:
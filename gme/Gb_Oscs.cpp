@@ -125,6 +125,26 @@ void Gb_Square::run( blip_time_t time, blip_time_t end_time, int playing )
 		playing = false;
 	}
 
+	if ( !output )
+	{
+		// keep phase and amplitude the same as when playing, so it sounds the
+		// same after being muted during a skip
+		last_amp = amp;
+		time += delay;
+		if ( !playing )
+			time = end_time;
+		if ( time < end_time )
+		{
+			int const period = (2048 - frequency) * 4;
+			int count = (end_time - time + period - 1) / period;
+			phase = (phase + count) & 7;
+			time += count * period;
+			last_amp = (phase >= duty) ? -volume : volume;
+		}
+		delay = time - end_time;
+		return;
+	}
+
 	{
 		int delta = amp - last_amp;
 		if ( delta )
@@ -171,6 +191,39 @@ void Gb_Noise::run( blip_time_t time, blip_time_t end_time, int playing )
 	if ( bits >> tap & 2 )
 		amp = -amp;
 
+	if ( !output )
+	{
+		// keep shift register the same as when playing
+		last_amp = amp;
+		time += delay;
+		if ( !playing )
+			time = end_time;
+		if ( time < end_time )
+		{
+			static unsigned char const table [8] = { 8, 16, 32, 48, 64, 80, 96, 112 };
+			int period = table [regs [3] & 7] << (regs [3] >> 4);
+			unsigned bits = this->bits;
+			int delta = amp * 2;
+			do
+			{
+				unsigned changed = (bits >> tap) + 1;
+				time += period;
+				bits <<= 1;
+				if ( changed & 2 )
+				{
+					delta = -delta;
+					bits |= 1;
+				}
+			}
+			while ( time < end_time );
+
+			this->bits = bits;
+			last_amp = delta >> 1;
+		}
+		delay = time - end_time;
+		return;
+	}
+
 	{
 		int delta = amp - last_amp;
 		if ( delta )
@@ -262,6 +315,25 @@ void Gb_Wave::run( blip_time_t time, blip_time_t end_time, int playing )
 			playing = false;
 		}
 
+		if ( !output )
+		{
+			// keep wave position and amplitude the same as when playing
+			last_amp = amp;
+			time += delay;
+			if ( !playing )
+				time = end_time;
+			if ( time < end_time )
+			{
+				int const period = (2048 - frequency) * 2;
+				int count = (end_time - time + period - 1) / period;
+				time += count * period;
+				wave_pos = (wave_pos + count) & (wave_size - 1);
+				last_amp = (wave [wave_pos] >> volume_shift) * 2;
+			}
+			delay = time - end_time;
+			return;
+		}
+
 		int delta = amp - last_amp;
 		if ( delta )
 		{
@@ -2,6 +2,7 @@
 
 #include "Gbs_Emu.h"
 
+#include "State_Copier.h"
 #include "blargg_endian.h"
 #include <cstring>
 
@@ -159,6 +160,7 @@ void Gbs_Emu::set_bank( int n )
 	{
 		return;
 	}
+	bank = n;
 	cpu::map_code( bank_size, bank_size, rom.at_addr( rom.mask_addr( addr ) ) );
 }
 
@@ -224,6 +226,7 @@ blargg_err_t Gbs_Emu::start_track_( int track )
 
 	cpu::map_code( ram_addr, 0x10000 - ram_addr, ram );
 	cpu::map_code( 0, bank_size, rom.at_addr( 0 ) );
+	bank = -1;
 	set_bank( rom.size() > bank_size );
 
 	ram [hi_page + 6] = header_.timer_modulo;
@@ -240,6 +243,34 @@ blargg_err_t Gbs_Emu::start_track_( int track )
 	return 0;
 }
 
+void Gbs_Emu::copy_state_( State_Copier& copier )
+{
+	copy_buffer_state( copier );
+
+	copier.copy_int( cpu::r.c );
+	copier.copy_int( cpu::r.b );
+	copier.copy_int( cpu::r.e );
+	copier.copy_int( cpu::r.d );
+	copier.copy_int( cpu::r.l );
+	copier.copy_int( cpu::r.h );
+	copier.copy_int( cpu::r.a );
+	copier.copy_int( cpu::r.flags );
+	copier.copy_int( cpu::r.pc );
+	copier.copy_int( cpu::r.sp );
+
+	copier.copy( ram, sizeof ram );
+	copier.copy_int( next_play );
+	copier.copy_int( bank );
+	if ( copier.loading() )
+	{
+		if ( bank >= 0 )
+			set_bank( bank );
+		update_timer();
+	}
+
+	apu.copy_state( copier );
+}
+
 blargg_err_t Gbs_Emu::run_clocks( blip_time_t& duration, int )
 {
 	cpu_time = 0;
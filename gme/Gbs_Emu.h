@@ -57,10 +57,12 @@ protected:
 	void set_voice( int, Blip_Buffer*, Blip_Buffer*, Blip_Buffer* );
 	void update_eq( blip_eq_t const& );
 	void unload();
+	void copy_state_( State_Copier& );
 private:
 	// rom
 	enum { bank_size = 0x4000 };
 	Rom_Data<bank_size> rom;
+	int bank; // currently mapped, or -1 if none
 	void set_bank( int );
 
 	// timer
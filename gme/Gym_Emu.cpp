@@ -2,6 +2,7 @@
 
 #include "Gym_Emu.h"
 
+#include "State_Copier.h"
 #include "blargg_endian.h"
 #include <cstring>
 
@@ -200,6 +201,34 @@ void Gym_Emu::set_tempo_( double t )
 	}
 }
 
+void Gym_Emu::set_synthesis_quality_( int quality )
+{
+	blip_buf.fast_synthesis( quality == gme_synthesis_fast );
+}
+
+blargg_err_t Gym_Emu::set_resampler_quality_( int quality )
+{
+	Dual_Resampler::set_quality( quality );
+	if ( !sample_rate() )
+		return 0;
+
+	double factor = Dual_Resampler::setup( oversample_factor, 0.990, fm_gain * gain() );
+	if ( fm_sample_rate != sample_rate() * factor )
+	{
+		// FM rate depends on actual resampling ratio
+		fm_sample_rate = sample_rate() * factor;
+		RETURN_ERR( fm.set_rate( fm_sample_rate, base_clock / 7.0 ) );
+	}
+	RETURN_ERR( Dual_Resampler::reset( long (1.0 / 60 / min_tempo * sample_rate()) ) );
+	set_tempo_( tempo() );
+	return 0;
+}
+
+blargg_err_t Gym_Emu::set_ym2612_emu_( int emu )
+{
+	return fm.set_emu( emu );
+}
+
 void Gym_Emu::mute_voices_( int mask )
 {
 	Music_Emu::mute_voices_( mask );
@@ -247,6 +276,34 @@ blargg_err_t Gym_Emu::start_track_( int track )
 	return 0;
 }
 
+void Gym_Emu::copy_state_( State_Copier& copier )
+{
+	// positions are stored as offsets into data
+	long pos_offset  = pos - data;
+	long loop_offset = loop_begin ? loop_begin - data : -1;
+	copier.copy_int( pos_offset );
+	copier.copy_int( loop_offset );
+	unsigned long size = data_end - data;
+	if ( (unsigned long) pos_offset > size || (loop_offset != -1 && (unsigned long) loop_offset >= size) )
+	{
+		copier.set_error( ERR_STATE_INVALID );
+		pos_offset  = 0;
+		loop_offset = -1;
+	}
+	pos        = data + pos_offset;
+	loop_begin = (loop_offset < 0) ? nullptr : data + loop_offset;
+
+	copier.copy_int( loop_remain );
+	copier.copy_int( dac_amp );
+	copier.copy_int( prev_dac_count );
+	copier.copy_int( dac_enabled );
+
+	fm.copy_state( copier );
+	apu.copy_state( copier );
+	blip_buf.copy_state( copier );
+	Dual_Resampler::copy_state( copier );
+}
+
 void Gym_Emu::run_dac( int dac_count )
 {
 	// Guess beginning and end of sample and adjust rate and buffer position accordingly.
@@ -378,3 +435,13 @@ blargg_err_t Gym_Emu::play_( long count, sample_t* out )
 	Dual_Resampler::dual_play( count, out, blip_buf );
 	return 0;
 }
+
+blargg_err_t Gym_Emu::fast_forward_( long count )
+{
+	// FM chip must still be run, but PSG can be muted
+	int saved_mute = mute_mask();
+	mute_voices( saved_mute | 0x80 );
+	Dual_Resampler::dual_skip( count, blip_buf );
+	mute_voices( saved_mute );
+	return 0;
+}
@@ -2,6 +2,7 @@
 
 #include "Hes_Apu.h"
 
+#include "State_Copier.h"
 #include <cstring>
 #include <cstdint>
 
@@ -179,6 +180,55 @@ void Hes_Osc::run_until( synth_t& synth_, blip_time_t end_time )
 		last_amp [0] = dac * volume_0;
 		last_amp [1] = dac * volume_1;
 	}
+	else if ( control & 0x80 )
+	{
+		// keep phase, noise and DAC the same as when playing, so it sounds the
+		// same after being muted during a skip
+		int const volume_0 = volume [0];
+		int const volume_1 = volume [1];
+		blip_time_t time = last_time + delay;
+		if ( time < end_time )
+		{
+			if ( noise & 0x80 )
+			{
+				if ( volume_0 | volume_1 )
+				{
+					int const period = (32 - (noise & 0x1F)) * 64;
+					unsigned noise_lfsr = this->noise_lfsr;
+					int new_dac;
+					do
+					{
+						new_dac = 0x1F & uMinus(noise_lfsr >> 1 & 1);
+						noise_lfsr = (noise_lfsr >> 1) ^ (0xE008 & uMinus(noise_lfsr & 1));
+						time += period;
+					}
+					while ( time < end_time );
+
+					dac = new_dac;
+					this->noise_lfsr = noise_lfsr;
+				}
+			}
+			else if ( !(control & 0x40) )
+			{
+				int period = this->period * 2;
+				bool const audible = (period >= 14 && (volume_0 | volume_1));
+				if ( !period )
+					period = 1;
+				int32_t count = (end_time - time + period - 1) / period;
+				phase = (phase + count) & 0x1F;
+				time += count * period;
+				if ( audible )
+					dac = wave [phase];
+			}
+		}
+		time -= end_time;
+		if ( time < 0 )
+			time = 0;
+		delay = time;
+
+		last_amp [0] = dac * volume_0;
+		last_amp [1] = dac * volume_1;
+	}
 	last_time = end_time;
 }
 
@@ -314,3 +364,37 @@ void Hes_Apu::end_frame( blip_time_t end_time )
 	}
 	while ( osc != oscs );
 }
+
+void Hes_Apu::copy_state( State_Copier& copier )
+{
+	copier.copy_int( latch );
+	latch &= 7;
+	copier.copy_int( balance );
+	for ( int i = 0; i < osc_count; i++ )
+	{
+		Hes_Osc& osc = oscs [i];
+		copier.copy( osc.wave, sizeof osc.wave );
+		copier.copy_ints( osc.volume, 2 );
+		copier.copy_ints( osc.last_amp, 2 );
+		copier.copy_int( osc.delay );
+		copier.copy_int( osc.period );
+		copier.copy_int( osc.noise );
+		copier.copy_int( osc.phase );
+		osc.phase &= 0x1F;
+		copier.copy_int( osc.balance );
+		copier.copy_int( osc.dac );
+		copier.copy_int( osc.last_time );
+		copier.copy_int( osc.noise_lfsr );
+		copier.copy_int( osc.control );
+
+		// same output selection as balance_changed(), which can't be used
+		// since it also adjusts last_amp
+		osc.outputs [0] = osc.chans [0];
+		osc.outputs [1] = nullptr;
+		if ( osc.volume [0] != osc.volume [1] )
+		{
+			osc.outputs [0] = osc.chans [1];
+			osc.outputs [1] = osc.chans [2];
+		}
+	}
+}
@@ -6,6 +6,8 @@
 
 #include "Blip_Buffer.h"
 
+class State_Copier;
+
 struct Hes_Osc
 {
 	unsigned char wave [32];
@@ -46,6 +48,9 @@ public:
 
 	void end_frame( blip_time_t );
 
+	// Save/load emulation state between frames, using a portable format
+	void copy_state( State_Copier& );
+
 public:
 	Hes_Apu();
 private:
@@ -2,6 +2,8 @@
 
 #include "Hes_Apu_Adpcm.h"
 
+#include "State_Copier.h"
+
 /* Copyright (C) 2006-2008 Shay Green. This module is free software; you
 can redistribute it and/or modify it under the terms of the GNU Lesser
 General Public License as published by the Free Software Foundation; either
@@ -122,10 +124,11 @@ void Hes_Apu_Adpcm::run_until( blip_time_t end_time )
 		amp = amp * volume / 0xFF;
 		int delta = amp - last_amp;
 
-		if ( output && delta )
+		if ( delta )
 		{
 			last_amp = amp;
-			synth.offset_inline( last_time, delta, output );
+			if ( output )
+				synth.offset_inline( last_time, delta, output );
 		}
 
 		last_time += state.freq;
@@ -329,3 +332,34 @@ int Hes_Apu_Adpcm::adpcm_decode( int code )
 
 	return state.ad_sample;
 }
+
+void Hes_Apu_Adpcm::copy_state( State_Copier& copier )
+{
+	copier.copy( state.pcmbuf, sizeof state.pcmbuf );
+	copier.copy( state.port, sizeof state.port );
+	copier.copy_int( state.ad_sample );
+	copier.copy_int( state.ad_ref_index );
+	if ( (unsigned) state.ad_ref_index > 48 )
+	{
+		copier.set_error( ERR_STATE_INVALID );
+		state.ad_ref_index = 0;
+	}
+	copier.copy_int( state.ad_low_nibble );
+	copier.copy_int( state.freq );
+	copier.copy_int( state.addr );
+	copier.copy_int( state.writeptr );
+	copier.copy_int( state.readptr );
+	copier.copy_int( state.playptr );
+	copier.copy_int( state.playflag );
+	copier.copy_int( state.repeatflag );
+	copier.copy_int( state.length );
+	copier.copy_int( state.playlength );
+	copier.copy_int( state.playedsamplecount );
+	copier.copy_int( state.volume );
+	copier.copy_int( state.fadetimer );
+	copier.copy_int( state.fadecount );
+
+	copier.copy_int( last_time );
+	copier.copy( &next_timer, sizeof next_timer ); // state is only valid for same build
+	copier.copy_int( last_amp );
+}
@@ -7,6 +7,8 @@
 #include "blargg_common.h"
 #include "Blip_Buffer.h"
 
+class State_Copier;
+
 class Hes_Apu_Adpcm {
 public:
 // Basics
@@ -39,6 +41,9 @@ public:
 	
 	// Sets overall volume, where 1.0 is normal
 	void volume( double v )                 { synth.volume( 0.6 / osc_count / amp_range * v ); }
+
+	// Saves/loads emulation state between frames, using a portable format
+	void copy_state( State_Copier& );
 	
 	// Registers are at io_addr to io_addr+io_size-1
 	enum { io_addr = 0x1800 };
@@ -2,6 +2,7 @@
 
 #include "Hes_Emu.h"
 
+#include "State_Copier.h"
 #include "blargg_endian.h"
 #include <cstring>
 #include <algorithm>
@@ -256,6 +257,58 @@ blargg_err_t Hes_Emu::start_track_( int track )
 	return 0;
 }
 
+void Hes_Emu::copy_state_( State_Copier& copier )
+{
+	copy_buffer_state( copier );
+
+	copier.copy_int( r.pc );
+	copier.copy_int( r.a );
+	copier.copy_int( r.x );
+	copier.copy_int( r.y );
+	copier.copy_int( r.status );
+	copier.copy_int( r.sp );
+	copier.copy( ram, sizeof ram );
+	copier.copy( sgx, sizeof sgx );
+	copier.copy( mmr, sizeof mmr );
+	if ( copier.loading() )
+	{
+		for ( int i = 0; i <= page_count; i++ )
+			set_mmr( i, mmr [i] );
+	}
+
+	// CPU time can run past end of frame
+	hes_time_t end_t = end_time();
+	hes_time_t irq_t = irq_time();
+	hes_time_t t     = time();
+	copier.copy_int( end_t );
+	copier.copy_int( irq_t );
+	copier.copy_int( t );
+	if ( copier.loading() )
+	{
+		set_end_time( end_t );
+		set_irq_time( irq_t );
+		set_time( t );
+	}
+
+	copier.copy_int( last_frame_hook );
+	copier.copy_int( timer.last_time );
+	copier.copy_int( timer.count );
+	copier.copy_int( timer.raw_load );
+	copier.copy_int( timer.enabled );
+	copier.copy_int( timer.fired );
+	if ( copier.loading() )
+		recalc_timer_load();
+	copier.copy_int( vdp.next_vbl );
+	copier.copy_int( vdp.latch );
+	copier.copy_int( vdp.control );
+	copier.copy_int( irq.timer );
+	copier.copy_int( irq.vdp );
+	copier.copy_int( irq.disables );
+
+	apu.copy_state( copier );
+	adpcm.copy_state( copier );
+}
+
 // Hardware
 
 void Hes_Emu::cpu_write_vdp( int addr, int data )
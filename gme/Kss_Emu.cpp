@@ -2,6 +2,7 @@
 
 #include "Kss_Emu.h"
 
+#include "State_Copier.h"
 #include "blargg_endian.h"
 #include <cstring>
 #include <algorithm>
@@ -116,6 +117,7 @@ extern gme_type_t const gme_kss_type = &gme_kss_type_;
 void Kss_Emu::update_gain()
 {
 	double g = gain() * 1.4;
+	gain_boosted = scc_accessed;
 	if ( scc_accessed )
 		g *= 1.5;
 	ay.volume( g );
@@ -243,6 +245,8 @@ blargg_err_t Kss_Emu::start_track_( int track )
 	ram [idle_addr] = 0xFF;
 	cpu::reset( unmapped_write, unmapped_read );
 	cpu::map_mem( 0, mem_size, ram, ram );
+	banks [0] = -1;
+	banks [1] = -1;
 
 	ay.reset();
 	scc.reset();
@@ -269,6 +273,7 @@ void Kss_Emu::set_bank( int logical, int physical )
 	unsigned addr = 0x8000;
 	if ( logical && bank_size == 8 * 1024 )
 		addr = 0xA000;
+	banks [addr >> 13 & 1] = physical;
 
 	physical -= header_.first_bank;
 	if ( (unsigned) physical >= (unsigned) bank_count )
@@ -378,6 +383,65 @@ int kss_cpu_in( Kss_Cpu*, cpu_time_t, unsigned addr )
 	return 0;
 }
 
+static void copy_registers( State_Copier& copier, Kss_Cpu::registers_t& r )
+{
+	copier.copy_int( r.pc );
+	copier.copy_int( r.sp );
+	copier.copy_int( r.ix );
+	copier.copy_int( r.iy );
+	copier.copy_int( r.w.bc );
+	copier.copy_int( r.w.de );
+	copier.copy_int( r.w.hl );
+	copier.copy_int( r.w.fa );
+	copier.copy_int( r.alt.w.bc );
+	copier.copy_int( r.alt.w.de );
+	copier.copy_int( r.alt.w.hl );
+	copier.copy_int( r.alt.w.fa );
+	copier.copy_int( r.iff1 );
+	copier.copy_int( r.iff2 );
+	copier.copy_int( r.r );
+	copier.copy_int( r.i );
+	copier.copy_int( r.im );
+}
+
+void Kss_Emu::copy_state_( State_Copier& copier )
+{
+	copy_buffer_state( copier );
+
+	copy_registers( copier, r );
+	cpu_time_t t = time();
+	copier.copy_int( t );
+	set_time( t );
+	copier.copy( ram, mem_size );
+	copier.copy_ints( banks, 2 );
+	if ( copier.loading() )
+	{
+		// only regions which were switched need to be remapped
+		for ( int i = 0; i < 2; i++ )
+			if ( banks [i] >= 0 )
+				set_bank( i, banks [i] );
+	}
+
+	copier.copy_int( next_play );
+	copier.copy_int( ay_latch );
+	ay_latch &= 0x0F;
+	copier.copy_int( scc_accessed );
+	copier.copy_int( gain_updated );
+	copier.copy_int( gain_boosted );
+	if ( copier.loading() )
+	{
+		bool accessed = scc_accessed;
+		scc_accessed = gain_boosted;
+		update_gain();
+		scc_accessed = accessed;
+	}
+
+	ay.copy_state( copier );
+	scc.copy_state( copier );
+	if ( sn )
+		sn->copy_state( copier );
+}
+
 // Emulation
 
 blargg_err_t Kss_Emu::run_clocks( blip_time_t& duration, int )
@@ -59,16 +59,19 @@ protected:
 	void set_voice( int, Blip_Buffer*, Blip_Buffer*, Blip_Buffer* );
 	void update_eq( blip_eq_t const& );
 	void unload();
+	void copy_state_( State_Copier& );
 private:
 	Rom_Data<page_size> rom;
 	composite_header_t header_;
 
 	bool scc_accessed;
 	bool gain_updated;
+	bool gain_boosted; // scc_accessed when update_gain() was last called
 	void update_gain();
 
 	unsigned scc_enabled; // 0 or 0xC000
 	int bank_count;
+	int banks [2]; // physical bank selected at $8000 and $A000, or -1 if none
 	void set_bank( int logical, int physical );
 	int32_t bank_size() const { return (16 * 1024L) >> (header_.bank_mode >> 7 & 1); }
 
@@ -1,6 +1,8 @@
 // Game_Music_Emu https://bitbucket.org/mpyne/game-music-emu/
 
 #include "Kss_Scc_Apu.h"
+
+#include "State_Copier.h"
 #include <cstdint>
 
 /* Copyright (C) 2006 Shay Green. This module is free software; you
@@ -27,16 +29,18 @@ void Scc_Apu::run_until( blip_time_t end_time )
 		osc_t& osc = oscs [index];
 
 		Blip_Buffer* const output = osc.output;
-		if ( !output )
-			continue;
-		output->set_modified();
+		if ( output )
+		{
+			output->set_modified();
+			clock_rate_ = output->clock_rate();
+		}
 
 		blip_time_t period = (regs [0x80 + index * 2 + 1] & 0x0F) * 0x100 +
 				regs [0x80 + index * 2] + 1;
 		int volume = 0;
 		if ( regs [0x8F] & (1 << index) )
 		{
-			blip_time_t inaudible_period = (uint32_t) (output->clock_rate() +
+			blip_time_t inaudible_period = (uint32_t) (clock_rate_ +
 					inaudible_freq * 32) / (inaudible_freq * 16);
 			if ( period > inaudible_period )
 				volume = (regs [0x8A + index] & 0x0F) * (amp_range / 256 / 15);
@@ -45,6 +49,23 @@ void Scc_Apu::run_until( blip_time_t end_time )
 		int8_t const* wave = (int8_t*) regs + index * wave_size;
 		if ( index == osc_count - 1 )
 			wave -= wave_size; // last two oscs share wave
+
+		if ( !output )
+		{
+			// keep phase and amplitude the same as when playing, so it sounds the
+			// same after being muted during a skip
+			blip_time_t time = last_time + osc.delay;
+			if ( time < end_time )
+			{
+				int32_t count = (end_time - time + period - 1) / period;
+				osc.phase = (osc.phase + count) & (wave_size - 1);
+				time += count * period;
+			}
+			osc.last_amp = wave [osc.phase] * volume;
+			osc.delay = time - end_time;
+			continue;
+		}
+
 		{
 			int amp = wave [osc.phase] * volume;
 			int delta = amp - osc.last_amp;
@@ -94,3 +115,16 @@ void Scc_Apu::run_until( blip_time_t end_time )
 	}
 	last_time = end_time;
 }
+
+void Scc_Apu::copy_state( State_Copier& copier )
+{
+	for ( int i = 0; i < osc_count; i++ )
+	{
+		osc_t& osc = oscs [i];
+		copier.copy_int( osc.delay );
+		copier.copy_int( osc.phase );
+		copier.copy_int( osc.last_amp );
+	}
+	copier.copy_int( last_time );
+	copier.copy( regs, sizeof regs );
+}
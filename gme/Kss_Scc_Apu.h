@@ -6,6 +6,8 @@
 
 #include "Blip_Buffer.h"
 #include <cstring>
+
+class State_Copier;
 #include <cstddef>
 
 class Scc_Apu {
@@ -25,6 +27,9 @@ public:
 	// can be whatever length is convenient.
 	void end_frame( blip_time_t length );
 
+	// Save/load emulation state between frames, using a portable format
+	void copy_state( State_Copier& );
+
 // Additional features
 
 	// Set sound output of specific oscillator to buffer, where index is
@@ -51,6 +56,7 @@ private:
 	};
 	osc_t oscs [osc_count];
 	blip_time_t last_time;
+	long clock_rate_; // of last output, used while all oscillators are muted
 	unsigned char regs [reg_count];
 	Blip_Synth<blip_med_quality,1> synth;
 
@@ -65,6 +71,8 @@ inline void Scc_Apu::osc_output( int index, Blip_Buffer* b )
 {
 	assert( (unsigned) index < osc_count );
 	oscs [index].output = b;
+	if ( b )
+		clock_rate_ = b->clock_rate();
 }
 
 inline void Scc_Apu::write( blip_time_t time, int addr, int data )
@@ -85,11 +93,12 @@ inline void Scc_Apu::end_frame( blip_time_t end_time )
 inline void Scc_Apu::output( Blip_Buffer* buf )
 {
 	for ( int i = 0; i < osc_count; i++ )
-		oscs [i].output = buf;
+		osc_output( i, buf );
 }
 
 inline Scc_Apu::Scc_Apu()
 {
+	clock_rate_ = 0;
 	output( nullptr );
 }
 
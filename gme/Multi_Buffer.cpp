@@ -2,6 +2,9 @@
 
 #include "Multi_Buffer.h"
 
+#include "State_Copier.h"
+#include <algorithm>
+
 /* Copyright (C) 2003-2006 Shay Green. This module is free software; you
 can redistribute it and/or modify it under the terms of the GNU Lesser
 General Public License as published by the Free Software Foundation; either
@@ -19,6 +22,8 @@ Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA */
 	#include BLARGG_ENABLE_OPTIMIZER
 #endif
 
+using std::min;
+
 Multi_Buffer::Multi_Buffer( int spf ) : samples_per_frame_( spf )
 {
 	length_ = 0;
@@ -28,6 +33,86 @@ Multi_Buffer::Multi_Buffer( int spf ) : samples_per_frame_( spf )
 
 blargg_err_t Multi_Buffer::set_channel_count( int ) { return 0; }
 
+long Multi_Buffer::read_samples_float( float* out, long count )
+{
+	blip_sample_t buf [1024];
+	long total = 0;
+	while ( total < count )
+	{
+		long n = sizeof buf / sizeof buf [0];
+		if ( n > count - total )
+			n = count - total;
+		n = read_samples( buf, n );
+		if ( !n )
+			break;
+		for ( long i = 0; i < n; i++ )
+			out [total + i] = buf [i] * (1.0f / 0x8000);
+		total += n;
+	}
+	return total;
+}
+
+static inline void store_sample( blip_sample_t& out, blip_sample_t in ) { out = in; }
+static inline void store_sample( float& out, blip_sample_t in ) { out = in * (1.0f / 0x8000); }
+
+template<class T>
+static long read_planar( Multi_Buffer* mb, T* const* out, long count )
+{
+	int const outs = mb->samples_per_frame() / 2;
+	blip_sample_t buf [1024];
+	long const block = sizeof buf / sizeof buf [0] / (outs * 2) * 2; // samples for each out
+	long total = 0;
+	while ( total < count )
+	{
+		long n = min( block, count - total );
+		n = mb->read_samples( buf, n * outs ) / outs;
+		if ( !n )
+			break;
+		blip_sample_t const* in = buf;
+		for ( long i = 0; i < n; i += 2 )
+		{
+			for ( int j = 0; j < outs; j++ )
+			{
+				store_sample( out [j] [total + i],     in [0] );
+				store_sample( out [j] [total + i + 1], in [1] );
+				in += 2;
+			}
+		}
+		total += n;
+	}
+	return total;
+}
+
+long Multi_Buffer::read_samples_planar( blip_sample_t* const* out, long count )
+{
+	return read_planar( this, out, count );
+}
+
+long Multi_Buffer::read_samples_planar_float( float* const* out, long count )
+{
+	return read_planar( this, out, count );
+}
+
+void Multi_Buffer::skip_samples( long count )
+{
+	blip_sample_t buf [1024];
+	while ( count > 0 )
+	{
+		long n = sizeof buf / sizeof buf [0];
+		if ( n > count )
+			n = count;
+		n = read_samples( buf, n );
+		if ( !n )
+			break;
+		count -= n;
+	}
+}
+
+void Multi_Buffer::copy_state( State_Copier& copier )
+{
+	copier.set_error( ERR_STATE_NOT_SUPPORTED );
+}
+
 // Silent_Buffer
 
 Silent_Buffer::Silent_Buffer() : Multi_Buffer( 1 ) // 0 channels would probably confuse
@@ -85,6 +170,12 @@ void Stereo_Buffer::bass_freq( int bass )
 		bufs [i].bass_freq( bass );
 }
 
+void Stereo_Buffer::fast_synthesis( bool fast )
+{
+	for ( int i = 0; i < buf_count; i++ )
+		bufs [i].fast_synthesis( fast );
+}
+
 void Stereo_Buffer::clear()
 {
 	stereo_added = 0;
@@ -103,7 +194,190 @@ void Stereo_Buffer::end_frame( blip_time_t clock_count )
 	}
 }
 
-long Stereo_Buffer::read_samples( blip_sample_t* out, long count )
+void Stereo_Buffer::copy_state( State_Copier& copier )
+{
+	copier.copy_int( stereo_added );
+	copier.copy_int( was_stereo );
+	for ( int i = 0; i < buf_count; i++ )
+		bufs [i].copy_state( copier );
+}
+
+#if BLIP_SYNTH_SIMD
+
+#include <emmintrin.h>
+
+// Each sum is under 1 << 18, so saturating matches blip_store() exactly
+static inline void store_pairs( blip_sample_t* out, __m128i first, __m128i second )
+{
+	_mm_storeu_si128( (__m128i*) out, _mm_packs_epi32( first, second ) );
+}
+
+static inline void store_pairs( float* out, __m128i first, __m128i second )
+{
+	__m128 const scale = _mm_set1_ps( 1.0f / 0x8000 );
+	_mm_storeu_ps( out,     _mm_mul_ps( _mm_cvtepi32_ps( first  ), scale ) );
+	_mm_storeu_ps( out + 4, _mm_mul_ps( _mm_cvtepi32_ps( second ), scale ) );
+}
+
+// Runs the center, left and right integrators side by side in vector lanes, four
+// samples at a time, and writes center + left, center + right pairs. Center can be
+// null to leave it out. Returns number of samples mixed, a multiple of 4; the rest
+// are left for scalar code.
+template<class T>
+static int32_t mix_stereo_sse2( T* out, blip_long const* center, blip_long const* left,
+		blip_long const* right, blip_long accum [3], int32_t count, int bass )
+{
+	__m128i acc = _mm_setr_epi32( accum [0], accum [1], accum [2], 0 );
+	__m128i const shift = _mm_cvtsi32_si128( bass );
+	__m128i const zero = _mm_setzero_si128();
+
+	#define STEP( s, in ) \
+		__m128i s = _mm_srai_epi32( acc, blip_sample_bits - 16 );\
+		acc = _mm_add_epi32( acc, _mm_sub_epi32( in, _mm_sra_epi32( acc, shift ) ) )
+
+	// lanes hold center, left, right, unused; produce left + center, right + center
+	#define PAIR( s ) \
+		_mm_add_epi32( _mm_shuffle_epi32( s, _MM_SHUFFLE( 0, 0, 2, 1 ) ), _mm_shuffle_epi32( s, 0 ) )
+
+	int32_t const mixed = count & ~3;
+	for ( count = mixed; count; count -= 4 )
+	{
+		// transpose four samples from each buffer into one vector per sample
+		__m128i c = center ? _mm_loadu_si128( (__m128i const*) center ) : zero;
+		__m128i l = _mm_loadu_si128( (__m128i const*) left  );
+		__m128i r = _mm_loadu_si128( (__m128i const*) right );
+		__m128i cl_lo = _mm_unpacklo_epi32( c, l );
+		__m128i cl_hi = _mm_unpackhi_epi32( c, l );
+		__m128i r_lo  = _mm_unpacklo_epi32( r, zero );
+		__m128i r_hi  = _mm_unpackhi_epi32( r, zero );
+
+		STEP( s0, _mm_unpacklo_epi64( cl_lo, r_lo ) );
+		STEP( s1, _mm_unpackhi_epi64( cl_lo, r_lo ) );
+		STEP( s2, _mm_unpacklo_epi64( cl_hi, r_hi ) );
+		STEP( s3, _mm_unpackhi_epi64( cl_hi, r_hi ) );
+
+		store_pairs( out, _mm_unpacklo_epi64( PAIR( s0 ), PAIR( s1 ) ),
+				_mm_unpacklo_epi64( PAIR( s2 ), PAIR( s3 ) ) );
+
+		out += 8;
+		if ( center )
+			center += 4;
+		left  += 4;
+		right += 4;
+	}
+
+	#undef STEP
+	#undef PAIR
+
+	blip_long lanes [4];
+	_mm_storeu_si128( (__m128i*) lanes, acc );
+	accum [0] = lanes [0];
+	accum [1] = lanes [1];
+	accum [2] = lanes [2];
+	return mixed;
+}
+
+#endif
+
+template<class T>
+void Stereo_Buffer::mix_stereo( T* out_, int32_t count )
+{
+	T* BLIP_RESTRICT out = out_;
+	int const bass = BLIP_READER_BASS( bufs [1] );
+	BLIP_READER_BEGIN( left, bufs [1] );
+	BLIP_READER_BEGIN( right, bufs [2] );
+	BLIP_READER_BEGIN( center, bufs [0] );
+
+#if BLIP_SYNTH_SIMD
+	{
+		blip_long accum [3] = { center_reader_accum, left_reader_accum, right_reader_accum };
+		int32_t n = mix_stereo_sse2( out, center_reader_buf, left_reader_buf, right_reader_buf,
+				accum, count, bass );
+		out   += n * 2;
+		count -= n;
+		center_reader_buf += n;
+		left_reader_buf   += n;
+		right_reader_buf  += n;
+		center_reader_accum = accum [0];
+		left_reader_accum   = accum [1];
+		right_reader_accum  = accum [2];
+	}
+#endif
+
+	for ( ; count; --count )
+	{
+		int c = BLIP_READER_READ( center );
+		blip_store( out [0], c + BLIP_READER_READ( left ) );
+		blip_store( out [1], c + BLIP_READER_READ( right ) );
+		out += 2;
+
+		BLIP_READER_NEXT( center, bass );
+		BLIP_READER_NEXT( left, bass );
+		BLIP_READER_NEXT( right, bass );
+	}
+
+	BLIP_READER_END( center, bufs [0] );
+	BLIP_READER_END( right, bufs [2] );
+	BLIP_READER_END( left, bufs [1] );
+}
+
+template<class T>
+void Stereo_Buffer::mix_stereo_no_center( T* out_, int32_t count )
+{
+	T* BLIP_RESTRICT out = out_;
+	int const bass = BLIP_READER_BASS( bufs [1] );
+	BLIP_READER_BEGIN( left, bufs [1] );
+	BLIP_READER_BEGIN( right, bufs [2] );
+
+#if BLIP_SYNTH_SIMD
+	{
+		blip_long accum [3] = { 0, left_reader_accum, right_reader_accum };
+		int32_t n = mix_stereo_sse2( out, nullptr, left_reader_buf, right_reader_buf,
+				accum, count, bass );
+		out   += n * 2;
+		count -= n;
+		left_reader_buf  += n;
+		right_reader_buf += n;
+		left_reader_accum  = accum [1];
+		right_reader_accum = accum [2];
+	}
+#endif
+
+	for ( ; count; --count )
+	{
+		blip_store( out [0], BLIP_READER_READ( left ) );
+		blip_store( out [1], BLIP_READER_READ( right ) );
+		out += 2;
+
+		BLIP_READER_NEXT( left, bass );
+		BLIP_READER_NEXT( right, bass );
+	}
+
+	BLIP_READER_END( right, bufs [2] );
+	BLIP_READER_END( left, bufs [1] );
+}
+
+template<class T>
+void Stereo_Buffer::mix_mono( T* out_, int32_t count )
+{
+	T* BLIP_RESTRICT out = out_;
+	int const bass = BLIP_READER_BASS( bufs [0] );
+	BLIP_READER_BEGIN( center, bufs [0] );
+
+	for ( ; count; --count )
+	{
+		blip_store( out [0], BLIP_READER_READ( center ) );
+		out [1] = out [0];
+		out += 2;
+
+		BLIP_READER_NEXT( center, bass );
+	}
+
+	BLIP_READER_END( center, bufs [0] );
+}
+
+template<class T>
+long Stereo_Buffer::read_samples_( T* out, long count )
 {
 	require( !(count & 1) ); // count must be even
 	count = (unsigned) count / 2;
@@ -148,85 +422,42 @@ long Stereo_Buffer::read_samples( blip_sample_t* out, long count )
 	return count * 2;
 }
 
-void Stereo_Buffer::mix_stereo( blip_sample_t* out_, int32_t count )
+long Stereo_Buffer::read_samples( blip_sample_t* out, long count )
 {
-	blip_sample_t* BLIP_RESTRICT out = out_;
-	int const bass = BLIP_READER_BASS( bufs [1] );
-	BLIP_READER_BEGIN( left, bufs [1] );
-	BLIP_READER_BEGIN( right, bufs [2] );
-	BLIP_READER_BEGIN( center, bufs [0] );
-
-	for ( ; count; --count )
-	{
-		int c = BLIP_READER_READ( center );
-		int32_t l = c + BLIP_READER_READ( left );
-		int32_t r = c + BLIP_READER_READ( right );
-		if ( (int16_t) l != l )
-			l = 0x7FFF - (l >> 24);
-
-		BLIP_READER_NEXT( center, bass );
-		if ( (int16_t) r != r )
-			r = 0x7FFF - (r >> 24);
-
-		BLIP_READER_NEXT( left, bass );
-		BLIP_READER_NEXT( right, bass );
-
-		out [0] = l;
-		out [1] = r;
-		out += 2;
-	}
-
-	BLIP_READER_END( center, bufs [0] );
-	BLIP_READER_END( right, bufs [2] );
-	BLIP_READER_END( left, bufs [1] );
+	return read_samples_( out, count );
 }
 
-void Stereo_Buffer::mix_stereo_no_center( blip_sample_t* out_, int32_t count )
+long Stereo_Buffer::read_samples_float( float* out, long count )
 {
-	blip_sample_t* BLIP_RESTRICT out = out_;
-	int const bass = BLIP_READER_BASS( bufs [1] );
-	BLIP_READER_BEGIN( left, bufs [1] );
-	BLIP_READER_BEGIN( right, bufs [2] );
-
-	for ( ; count; --count )
-	{
-		int32_t l = BLIP_READER_READ( left );
-		if ( (int16_t) l != l )
-			l = 0x7FFF - (l >> 24);
-
-		int32_t r = BLIP_READER_READ( right );
-		if ( (int16_t) r != r )
-			r = 0x7FFF - (r >> 24);
-
-		BLIP_READER_NEXT( left, bass );
-		BLIP_READER_NEXT( right, bass );
-
-		out [0] = l;
-		out [1] = r;
-		out += 2;
-	}
-
-	BLIP_READER_END( right, bufs [2] );
-	BLIP_READER_END( left, bufs [1] );
+	return read_samples_( out, count );
 }
 
-void Stereo_Buffer::mix_mono( blip_sample_t* out_, int32_t count )
+void Stereo_Buffer::skip_samples( long count )
 {
-	blip_sample_t* BLIP_RESTRICT out = out_;
-	int const bass = BLIP_READER_BASS( bufs [0] );
-	BLIP_READER_BEGIN( center, bufs [0] );
+	require( !(count & 1) ); // count must be even
+	count = (unsigned) count / 2;
 
-	for ( ; count; --count )
+	long avail = bufs [0].samples_avail();
+	if ( count > avail )
+		count = avail;
+	if ( count )
 	{
-		int32_t s = BLIP_READER_READ( center );
-		if ( (int16_t) s != s )
-			s = 0x7FFF - (s >> 24);
+		// same buffers are removed with filtering as when reading
+		int bufs_used = stereo_added | was_stereo;
+		for ( int i = 0; i < buf_count; i++ )
+		{
+			int used = (bufs_used <= 1) ? (i == 0) : (i != 0 || (bufs_used & 1));
+			if ( used )
+				bufs [i].skip_samples( count );
+			else
+				bufs [i].remove_silence( count );
+		}
 
-		BLIP_READER_NEXT( center, bass );
-		out [0] = s;
-		out [1] = s;
-		out += 2;
+		if ( !bufs [0].samples_avail() )
+		{
+			was_stereo   = stereo_added;
+			stereo_added = 0;
+		}
 	}
-
-	BLIP_READER_END( center, bufs [0] );
 }
+
@@ -8,6 +8,8 @@
 #include "Blip_Buffer.h"
 #include <cstdint>
 
+class State_Copier;
+
 // Interface to one or more Blip_Buffers mapped to one or more channels
 // consisting of left, center, and right buffers.
 class Multi_Buffer {
@@ -35,6 +37,9 @@ public:
 	virtual void clear() = 0;
 	long sample_rate() const;
 
+	// Set Blip_Buffer::fast_synthesis() of all buffers. Ignored by default.
+	virtual void fast_synthesis( bool ) { }
+
 	// Length of buffer, in milliseconds
 	int length() const;
 
@@ -52,6 +57,24 @@ public:
 	virtual long read_samples( blip_sample_t*, long ) = 0;
 	virtual long samples_avail() const = 0;
 
+	// Same as read_samples(), but writes floating-point samples where 1.0
+	// corresponds to 0x8000. Default converts output of read_samples().
+	virtual long read_samples_float( float*, long );
+
+	// Same as read_samples(), but writes each stereo pair of channels to its own
+	// buffer, out [0] to out [samples_per_frame() / 2 - 1]. 'count' is the number
+	// of samples for each buffer. Default separates output of read_samples().
+	virtual long read_samples_planar( blip_sample_t* const* out, long count );
+	virtual long read_samples_planar_float( float* const* out, long count );
+
+	// Remove count samples as read_samples() would, without writing them anywhere.
+	// Default reads them into a temporary buffer.
+	virtual void skip_samples( long count );
+
+	// Save/load unread samples and effect state (see State_Copier.h). Not
+	// supported by default.
+	virtual void copy_state( State_Copier& );
+
 public:
 	BLARGG_DISABLE_NOTHROW
 protected:
@@ -81,11 +104,15 @@ public:
 	blargg_err_t set_sample_rate( long rate, int msec = blip_default_length ) override;
 	void clock_rate( uint32_t rate ) override { buf.clock_rate( rate ); }
 	void bass_freq( int freq ) override { buf.bass_freq( freq ); }
+	void fast_synthesis( bool fast ) override { buf.fast_synthesis( fast ); }
 	void clear() override { buf.clear(); }
 	long samples_avail() const override { return buf.samples_avail(); }
 	long read_samples( blip_sample_t* p, long s ) override { return buf.read_samples( p, s ); }
+	long read_samples_float( float* p, long s ) override { return buf.read_samples( p, s ); }
+	void skip_samples( long s ) override { buf.skip_samples( s ); }
 	channel_t channel( int, int ) override { return chan; }
 	void end_frame( blip_time_t t ) override { buf.end_frame( t ); }
+	void copy_state( State_Copier& copier ) override { buf.copy_state( copier ); }
 };
 
 // Uses three buffers (one for center) and outputs stereo sample pairs.
@@ -103,12 +130,16 @@ public:
 	blargg_err_t set_sample_rate( long, int msec = blip_default_length ) override;
 	void clock_rate( uint32_t ) override;
 	void bass_freq( int ) override;
+	void fast_synthesis( bool ) override;
 	void clear() override;
 	channel_t channel( int, int ) override { return chan; }
 	void end_frame( blip_time_t ) override;
 
 	long samples_avail() const override { return bufs [0].samples_avail() * 2; }
 	long read_samples( blip_sample_t*, long ) override;
+	long read_samples_float( float*, long ) override;
+	void skip_samples( long ) override;
+	void copy_state( State_Copier& ) override;
 
 private:
 	enum { buf_count = 3 };
@@ -117,9 +148,10 @@ private:
 	int stereo_added;
 	int was_stereo;
 
-	void mix_stereo_no_center( blip_sample_t*, int32_t );
-	void mix_stereo( blip_sample_t*, int32_t );
-	void mix_mono( blip_sample_t*, int32_t );
+	template<class T> long read_samples_( T*, long );
+	template<class T> void mix_stereo_no_center( T*, int32_t );
+	template<class T> void mix_stereo( T*, int32_t );
+	template<class T> void mix_mono( T*, int32_t );
 };
 
 // Silent_Buffer generates no samples, useful where no sound is wanted
@@ -135,6 +167,9 @@ public:
 	void end_frame( blip_time_t ) override { }
 	long samples_avail() const override { return 0; }
 	long read_samples( blip_sample_t*, long ) override { return 0; }
+	long read_samples_float( float*, long ) override { return 0; }
+	void skip_samples( long ) override { }
+	void copy_state( State_Copier& ) override { }
 };
 
 
@@ -3,8 +3,11 @@
 #include "Music_Emu.h"
 
 #include "Multi_Buffer.h"
+#include "State_Copier.h"
 #include <cstring>
+#include <cmath>
 #include <algorithm>
+#include <thread>
 
 /* Copyright (C) 2003-2006 Shay Green. This module is free software; you
 can redistribute it and/or modify it under the terms of the GNU Lesser
@@ -27,6 +30,55 @@ static int const fade_shift = 8; // fade ends with gain at 1.0 / (1 << fade_shif
 using std::min;
 using std::max;
 
+// floating-point samples are scaled so that 1.0 corresponds to 0x8000
+static inline void copy_samples( Music_Emu::sample_t* out, Music_Emu::sample_t const* in, long count )
+{
+	memcpy( out, in, count * sizeof *out );
+}
+
+static inline void copy_samples( float* out, Music_Emu::sample_t const* in, long count )
+{
+	for ( long i = 0; i < count; i++ )
+		out [i] = in [i] * (1.0f / 0x8000);
+}
+
+static inline void copy_samples( float* out, float const* in, long count )
+{
+	memcpy( out, in, count * sizeof *out );
+}
+
+// Output is either interleaved in out [0] (outs = 1), or a stereo buffer for each
+// of 'outs' voices. Positions and counts are of interleaved samples, and always
+// whole frames.
+
+template<class T>
+static void clear_out( T* const* out, int outs, long pos, long count )
+{
+	for ( int i = 0; i < outs; i++ )
+		memset( out [i] + pos / outs, 0, count / outs * sizeof (T) );
+}
+
+// copies interleaved samples to output
+template<class T, class U>
+static void copy_out( T* const* out, int outs, long pos, U const* in, long count )
+{
+	if ( outs == 1 )
+	{
+		copy_samples( out [0] + pos, in, count );
+		return;
+	}
+
+	for ( int i = 0; i < outs; i++ )
+	{
+		T* p = out [i] + pos / outs;
+		for ( long n = 0; n < count; n += outs * 2 )
+		{
+			copy_samples( p, &in [n + i * 2], 2 );
+			p += 2;
+		}
+	}
+}
+
 Music_Emu::equalizer_t const Music_Emu::tv_eq =
 	Music_Emu::make_equalizer( -8.0, 180 );
 
@@ -43,12 +95,15 @@ void Music_Emu::clear_track_vars()
 	silence_time     = 0;
 	silence_count    = 0;
 	buf_remain       = 0;
+	buf_is_float     = false;
+	parallel_inexact = false;
 	warning(); // clear warning
 }
 
 void Music_Emu::unload()
 {
 	voice_count_ = 0;
+	clear_keyframes();
 	clear_track_vars();
 	Gme_File::unload();
 }
@@ -57,20 +112,33 @@ Music_Emu::Music_Emu()
 {
 	effects_buffer = nullptr;
 	multi_channel_ = false;
+	stem_count_  = 8;
+	buf_size     = max_buf_size;
 	sample_rate_ = 0;
 	mute_mask_   = 0;
 	tempo_       = 1.0;
 	gain_        = 1.0;
+	synthesis_quality_ = gme_synthesis_full;
+	resampler_quality_ = gme_resampler_normal;
+	ym2612_emu_        = gme_ym2612_default;
 
 	// defaults
 	max_initial_silence = 2;
 	silence_lookahead   = 3;
 	ignore_silence_     = false;
+	low_latency_        = false;
 	equalizer_.treble   = -1.0;
 	equalizer_.bass     = 60;
 
 	emu_autoload_playback_limit_ = true;
 
+	keyframe_interval  = 0;
+	keyframe_count     = 0;
+	keyframe_data_size = 0;
+
+	raw_pos    = nullptr;
+	raw_remain = 0;
+
 	static const char* const names [] = {
 		"Voice 1", "Voice 2", "Voice 3", "Voice 4",
 		"Voice 5", "Voice 6", "Voice 7", "Voice 8"
@@ -85,6 +153,7 @@ blargg_err_t Music_Emu::set_sample_rate( long rate )
 {
 	require( !sample_rate() ); // sample rate can't be changed once set
 	RETURN_ERR( set_sample_rate_( rate ) );
+	buf_size = max_buf_size - max_buf_size % out_channels();
 	RETURN_ERR( buf.resize( buf_size ) );
 	sample_rate_ = rate;
 	return 0;
@@ -102,6 +171,31 @@ void Music_Emu::set_equalizer( equalizer_t const& eq )
 	set_equalizer_( eq );
 }
 
+void Music_Emu::set_synthesis_quality( int quality )
+{
+	synthesis_quality_ = quality;
+	set_synthesis_quality_( quality );
+}
+
+blargg_err_t Music_Emu::set_resampler_quality( int quality )
+{
+	if ( quality == resampler_quality_ )
+		return 0;
+	resampler_quality_ = quality;
+	clear_keyframes(); // saved resampler state no longer matches
+	return set_resampler_quality_( quality );
+}
+
+blargg_err_t Music_Emu::set_ym2612_emu( int emu )
+{
+	if ( emu == ym2612_emu_ )
+		return set_ym2612_emu_( emu ); // only fails if there's no YM2612, as it's unchanged
+	RETURN_ERR( set_ym2612_emu_( emu ) );
+	ym2612_emu_ = emu;
+	clear_keyframes(); // saved FM state no longer matches
+	return 0;
+}
+
 bool Music_Emu::multi_channel() const
 {
 	return this->multi_channel_;
@@ -113,11 +207,13 @@ blargg_err_t Music_Emu::set_multi_channel( bool )
 	return ERR_MULTICHANNEL_NOT_SUPPORTED;
 }
 
-blargg_err_t Music_Emu::set_multi_channel_( bool isEnabled )
+blargg_err_t Music_Emu::set_multi_channel_( bool isEnabled, int stems )
 {
 	// multi channel support must be set at the very beginning
 	require( !sample_rate() );
+	require( 0 < stems && stems <= max_stems );
 	multi_channel_ = isEnabled;
+	stem_count_    = stems;
 	return 0;
 }
 
@@ -152,6 +248,7 @@ void Music_Emu::set_tempo( double t )
 	if ( t > max ) t = max;
 	tempo_ = t;
 	set_tempo_( t );
+	clear_keyframes(); // emulator timing changed
 }
 
 void Music_Emu::post_load_()
@@ -161,6 +258,13 @@ void Music_Emu::post_load_()
 }
 
 blargg_err_t Music_Emu::start_track( int track )
+{
+	clear_keyframes();
+	return restart_track( track );
+}
+
+// Starts track without discarding keyframes, which remain valid
+blargg_err_t Music_Emu::restart_track( int track )
 {
 	clear_track_vars();
 
@@ -172,15 +276,19 @@ blargg_err_t Music_Emu::start_track( int track )
 	emu_track_ended_ = false;
 	track_ended_     = false;
 
-	if ( !ignore_silence_ )
+	if ( !ignore_silence_ && !low_latency_ )
 	{
-		// play until non-silence or end of track
+		// play until non-silence or end of track, without keyframes since
+		// emu_time is rebased afterwards
+		int32_t saved_next_keyframe = next_keyframe;
+		next_keyframe = INT_MAX / 2 + 1;
 		for ( long end = max_initial_silence * out_channels() * sample_rate(); emu_time < end; )
 		{
 			fill_buf();
 			if ( buf_remain | (int) emu_track_ended_ )
 				break;
 		}
+		next_keyframe = saved_next_keyframe;
 
 		emu_time        = buf_remain;
 		out_time        = 0;
@@ -238,8 +346,8 @@ long Music_Emu::tell_scaled() const
 
 blargg_err_t Music_Emu::seek_samples( long time )
 {
-	if ( time < out_time )
-		RETURN_ERR( start_track( current_track_ ) );
+	if ( !load_keyframe( time ) && time < out_time )
+		RETURN_ERR( restart_track( current_track_ ) );
 	return skip( time - out_time );
 }
 
@@ -252,8 +360,9 @@ blargg_err_t Music_Emu::seek_scaled( long msec )
 {
 	require( tempo_ > 0 );
 	int32_t frames = int32_t((msec / 1000.0) * sample_rate());
-	if ( frames < out_time_scaled )
-		RETURN_ERR( start_track( current_track_ ) );
+	long time = long (frames / tempo_) * out_channels(); // unscaled, for keyframes
+	if ( !load_keyframe( time ) && frames < out_time_scaled )
+		RETURN_ERR( restart_track( current_track_ ) );
 	int samples_to_skip = int((frames - out_time_scaled) * out_channels() / tempo_);
 	samples_to_skip += samples_to_skip % out_channels();
 	return skip( samples_to_skip );
@@ -276,6 +385,19 @@ blargg_err_t Music_Emu::skip( long count )
 		count -= n;
 	}
 
+	// stop at each keyframe along the way
+	while ( count && !emu_track_ended_ && next_keyframe < emu_time + count )
+	{
+		long n = next_keyframe - emu_time;
+		if ( n > 0 )
+		{
+			count -= n;
+			emu_time += n;
+			end_track_if_error( skip_( n ) );
+		}
+		save_keyframe();
+	}
+
 	if ( count && !emu_track_ended_ )
 	{
 		emu_time += count;
@@ -294,16 +416,9 @@ blargg_err_t Music_Emu::skip_( long count )
 	const long threshold = 30000;
 	if ( count > threshold )
 	{
-		int saved_mute = mute_mask_;
-		mute_voices( ~0 );
-
-		while ( count > threshold / 2 && !emu_track_ended_ )
-		{
-			RETURN_ERR( play_( buf_size, buf.begin() ) );
-			count -= buf_size;
-		}
-
-		mute_voices( saved_mute );
+		long n = (count - threshold / 2 + buf_size - 1) / buf_size * buf_size;
+		count -= n;
+		RETURN_ERR( fast_forward_( n ) );
 	}
 
 	while ( count && !emu_track_ended_ )
@@ -317,6 +432,283 @@ blargg_err_t Music_Emu::skip_( long count )
 	return 0;
 }
 
+blargg_err_t Music_Emu::play_float_( long count, float* out )
+{
+	while ( count )
+	{
+		sample_t temp [1024];
+		long n = min( count, (long) (sizeof temp / sizeof temp [0]) );
+		RETURN_ERR( play_( n, temp ) );
+		copy_samples( out, temp, n );
+		out   += n;
+		count -= n;
+	}
+	return 0;
+}
+
+template<class T>
+blargg_err_t Music_Emu::separate_voices( long count, T* const* out )
+{
+	int const outs = planar_count();
+	for ( long pos = 0; pos < count; )
+	{
+		T temp [1024];
+		long n = min( count - pos, (long) (sizeof temp / sizeof temp [0]) / outs & ~1 );
+		RETURN_ERR( render_( n * outs, temp ) );
+		copy_out( out, outs, pos * outs, temp, n * outs );
+		pos += n;
+	}
+	return 0;
+}
+
+blargg_err_t Music_Emu::play_planar_( long count, sample_t* const* out )
+{
+	return separate_voices( count, out );
+}
+
+blargg_err_t Music_Emu::play_planar_float_( long count, float* const* out )
+{
+	return separate_voices( count, out );
+}
+
+blargg_err_t Music_Emu::fast_forward_( long count )
+{
+	int saved_mute = mute_mask_;
+	mute_voices( ~0 );
+
+	while ( count && !emu_track_ended_ )
+	{
+		long n = min( count, (long) buf_size );
+		RETURN_ERR( play_( n, buf.begin() ) );
+		count -= n;
+	}
+
+	mute_voices( saved_mute );
+	return 0;
+}
+
+void Music_Emu::copy_state_( State_Copier& copier )
+{
+	copier.set_error( ERR_STATE_NOT_SUPPORTED );
+}
+
+// Keyframes
+
+void Music_Emu::set_keyframe_interval( long msec )
+{
+	require( sample_rate() ); // sample rate must be set first
+	keyframe_interval = (msec > 0 ? max( msec_to_samples( msec ), (int32_t) buf_size ) : 0);
+	clear_keyframes();
+}
+
+void Music_Emu::clear_keyframes()
+{
+	keyframe_count     = 0;
+	keyframe_data_size = 0;
+	keyframes.clear();
+	keyframe_data.clear();
+	next_keyframe = (keyframe_interval ? keyframe_interval : INT_MAX / 2 + 1);
+}
+
+// Called when emu_time reaches next_keyframe
+void Music_Emu::save_keyframe()
+{
+	// later keyframes might already exist if an earlier one was loaded
+	next_keyframe = emu_time + keyframe_interval;
+	if ( keyframe_count )
+		next_keyframe = max( next_keyframe, keyframes [keyframe_count - 1].emu_time + keyframe_interval );
+	if ( emu_track_ended_ || (keyframe_count && keyframes [keyframe_count - 1].emu_time >= emu_time) )
+		return;
+
+	State_Copier sizer;
+	copy_state_( sizer );
+	if ( sizer.error() )
+	{
+		// not supported, so don't try again
+		keyframe_interval = 0;
+		clear_keyframes();
+		return;
+	}
+
+	// grow geometrically, since a long track can accumulate many keyframes
+	long size = sizer.pos();
+	if ( keyframe_data_size + size > (long) keyframe_data.size() )
+	{
+		if ( keyframe_data.resize( max( keyframe_data_size + size, (long) keyframe_data.size() * 2 ) ) )
+			return;
+	}
+	if ( keyframe_count >= (long) keyframes.size() )
+	{
+		if ( keyframes.resize( max( 16L, keyframe_count * 2 ) ) )
+			return;
+	}
+
+	State_Copier out;
+	out.begin_save( keyframe_data.begin() + keyframe_data_size, size );
+	copy_state_( out );
+	if ( out.error() )
+		return;
+
+	keyframe_t& k   = keyframes [keyframe_count++];
+	k.emu_time      = emu_time;
+	k.silence_time  = silence_time;
+	k.pos           = keyframe_data_size;
+	k.size          = size;
+	keyframe_data_size += size;
+}
+
+// Loads most recent keyframe at or before time, if that is closer than current
+// position. Returns false if no keyframe was loaded.
+bool Music_Emu::load_keyframe( long time )
+{
+	if ( current_track_ < 0 )
+		return false;
+
+	long i = keyframe_count;
+	while ( i && keyframes [i - 1].emu_time > time )
+		i--;
+	if ( !i )
+		return false;
+
+	keyframe_t const& k = keyframes [i - 1];
+	if ( time >= out_time && k.emu_time <= emu_time )
+		return false; // skipping from current position is quicker
+
+	State_Copier in;
+	in.begin_load( keyframe_data.begin() + k.pos, k.size );
+	copy_state_( in );
+	if ( in.error() )
+	{
+		// emulator state is now inconsistent, so start over
+		clear_keyframes();
+		end_track_if_error( restart_track( current_track_ ) );
+		return true;
+	}
+
+	emu_time         = k.emu_time;
+	out_time         = k.emu_time;
+	out_time_scaled  = int32_t(out_time * tempo_ / out_channels());
+	silence_time     = k.silence_time;
+	silence_count    = 0;
+	buf_remain       = 0;
+	emu_track_ended_ = false;
+	track_ended_     = false;
+	return true;
+}
+
+// State
+
+// Header which must match when loading, then track position and silence buffer
+void Music_Emu::copy_track_state( State_Copier& copier )
+{
+	unsigned long system = 0;
+	for ( const char* p = type()->system; *p; p++ )
+		system = (system * 31 + (unsigned char) *p) & 0x7FFFFFFF;
+
+	copier.verify( 0x53454D47 ); // 'GMES'
+	copier.verify( 1 ); // version
+	copier.verify( current_track_ ); // read separately by load_state()
+	copier.verify( (long) system );
+	copier.verify( sample_rate_ );
+	copier.verify( out_channels() );
+	copier.verify( voice_count_ );
+	copier.verify( track_count() );
+
+	copier.copy_int( out_time );
+	copier.copy_int( out_time_scaled );
+	copier.copy_int( emu_time );
+	copier.copy_int( emu_track_ended_ );
+	bool ended = track_ended_;
+	copier.copy_int( ended );
+	track_ended_ = ended;
+	copier.copy_int( fade_start );
+	copier.copy_int( fade_step );
+	copier.copy_int( silence_time );
+	copier.copy_int( silence_count );
+
+	copier.copy_int( buf_remain );
+	if ( buf_remain < 0 || buf_remain > buf_size )
+	{
+		copier.set_error( ERR_STATE_INVALID );
+		buf_remain = 0;
+	}
+	if ( buf_is_float && !copier.loading() )
+	{
+		// always stored as 16-bit
+		for ( long i = buf_size - buf_remain; i < buf_size; i++ )
+		{
+			sample_t s;
+			blip_store( s, (blip_long) floor( float_buf [i] * 0x8000 + 0.5f ) );
+			copier.copy_int( s );
+		}
+	}
+	else
+	{
+		if ( copier.loading() )
+			buf_is_float = false;
+		copier.copy_ints( &buf [buf_size - buf_remain], buf_remain );
+	}
+}
+
+long Music_Emu::state_size()
+{
+	if ( current_track_ < 0 )
+		return 0;
+
+	State_Copier sizer;
+	copy_track_state( sizer );
+	copy_state_( sizer );
+	return sizer.error() ? 0 : sizer.pos();
+}
+
+blargg_err_t Music_Emu::save_state( void* out, long size )
+{
+	require( current_track() >= 0 ); // start_track() must have been called already
+
+	State_Copier copier;
+	copier.begin_save( out, size );
+	copy_track_state( copier );
+	copy_state_( copier );
+	return copier.error();
+}
+
+blargg_err_t Music_Emu::load_state( void const* in, long size )
+{
+	require( sample_rate() ); // sample rate must be set first
+
+	// track number is part of header
+	State_Copier header;
+	header.begin_load( in, size );
+	header.verify( 0x53454D47 );
+	header.verify( 1 );
+	long track = -1;
+	header.copy_int( track );
+	if ( header.error() || track < 0 || track >= track_count() )
+		return ERR_STATE_INVALID;
+
+	// start track without silence detection, then overwrite its state
+	clear_keyframes();
+	clear_track_vars();
+	int remapped = (int) track;
+	RETURN_ERR( remap_track_( &remapped ) );
+	current_track_ = (int) track;
+	blargg_err_t err = start_track_( remapped );
+	if ( !err )
+	{
+		State_Copier copier;
+		copier.begin_load( in, size );
+		copy_track_state( copier );
+		copy_state_( copier );
+		err = copier.error();
+	}
+	if ( err )
+	{
+		clear_track_vars();
+		return err;
+	}
+	return 0;
+}
+
 // Fading
 
 void Music_Emu::set_fade( long start_msec, long length_msec )
@@ -333,7 +725,26 @@ static int int_log( int32_t x, int step, int unit )
 	return ((unit - fraction) + (fraction >> 1)) >> shift;
 }
 
-void Music_Emu::handle_fade( long out_count, sample_t* out )
+static inline void fade_sample( Music_Emu::sample_t& s, int gain, int shift )
+{
+	s = Music_Emu::sample_t ((s * gain) >> shift);
+}
+
+static inline void fade_sample( float& s, int gain, int shift )
+{
+	s *= gain * (1.0f / (1 << shift));
+}
+
+// Index of first sample in planar buffer j at or after interleaved position pos
+static long planar_index( long pos, int j, int outs )
+{
+	long frame = pos / (outs * 2);
+	long rem = pos - frame * (outs * 2) - j * 2;
+	return frame * 2 + max( 0L, min( rem, 2L ) );
+}
+
+template<class T>
+void Music_Emu::handle_fade( long out_count, T* const* out, int outs )
 {
 	for ( int i = 0; i < out_count; i += fade_block_size )
 	{
@@ -344,46 +755,150 @@ void Music_Emu::handle_fade( long out_count, sample_t* out )
 		if ( gain < (unit >> fade_shift) )
 			track_ended_ = emu_track_ended_ = true;
 
-		sample_t* io = &out [i];
-		for ( int count = min( fade_block_size, out_count - i ); count; --count )
+		// planar samples are faded by their position in interleaved output, so
+		// they match gme_play() even where a block splits a frame
+		long end = min( (long) i + fade_block_size, out_count );
+		for ( int j = 0; j < outs; j++ )
 		{
-			*io = sample_t ((*io * gain) >> shift);
-			++io;
+			T* const io = out [j];
+			for ( long k = planar_index( i, j, outs ), n = planar_index( end, j, outs ); k < n; k++ )
+				fade_sample( io [k], gain, shift );
 		}
 	}
 }
 
 // Silence detection
 
-void Music_Emu::emu_play( long count, sample_t* out )
+template<class T>
+void Music_Emu::emu_play( long count, T* const* out, int outs, long pos )
 {
 	check( current_track_ >= 0 );
+
+	// stop at each keyframe along the way
+	while ( count )
+	{
+		if ( emu_time >= next_keyframe )
+			save_keyframe();
+		long n = min( count, (long) (next_keyframe - emu_time) );
+		emu_play_( n, out, outs, pos );
+		pos   += n;
+		count -= n;
+	}
+}
+
+template<class T>
+void Music_Emu::emu_play_( long count, T* const* out, int outs, long pos )
+{
 	emu_time += count;
 	if ( current_track_ >= 0 && !emu_track_ended_ )
-		end_track_if_error( play_( count, out ) );
+	{
+		// use output rendered by play_parallel() first
+		long n = min( count, raw_remain );
+		if ( n )
+		{
+			copy_out( out, outs, pos, raw_pos, n );
+			raw_pos    += n;
+			raw_remain -= n;
+			pos        += n;
+		}
+		if ( count > n )
+		{
+			if ( outs == 1 )
+			{
+				end_track_if_error( render_( count - n, out [0] + pos ) );
+			}
+			else
+			{
+				T* voices [max_stems];
+				for ( int i = 0; i < outs; i++ )
+					voices [i] = out [i] + pos / outs;
+				end_track_if_error( render_( (count - n) / outs, voices ) );
+			}
+		}
+	}
 	else
-		memset( out, 0, count * sizeof *out );
+	{
+		clear_out( out, outs, pos, count );
+	}
+}
+
+static inline bool is_silent( Music_Emu::sample_t s )
+{
+	return (unsigned) (s + silence_threshold / 2) <= (unsigned) silence_threshold;
+}
+
+static inline bool is_silent( float s )
+{
+	return s >= -(silence_threshold / 2) * (1.0f / 0x8000) &&
+			s <= (silence_threshold - silence_threshold / 2) * (1.0f / 0x8000);
 }
 
 // number of consecutive silent samples at end
-static long count_silence( Music_Emu::sample_t* begin, long size )
+template<class T>
+static long count_silence( T* begin, long size )
 {
-	Music_Emu::sample_t first = *begin;
+	T first = *begin;
 	*begin = silence_threshold; // sentinel
-	Music_Emu::sample_t* p = begin + size;
-	while ( (unsigned) (*--p + silence_threshold / 2) <= (unsigned) silence_threshold ) { }
+	T* p = begin + size;
+	while ( is_silent( *--p ) ) { }
 	*begin = first;
 	return size - (p - begin);
 }
 
-// fill internal buffer and check it for silence
+template<class T>
+static long count_silence( T* const* out, int outs, long pos, long size )
+{
+	if ( outs == 1 )
+		return count_silence( out [0] + pos, size );
+
+	// same result as above, which never examines first sample
+	for ( long i = size; --i > 0; )
+	{
+		long frame = i / (outs * 2);
+		int  chan  = int(i % (outs * 2));
+		if ( !is_silent( out [chan >> 1] [pos / outs + frame * 2 + (chan & 1)] ) )
+			return size - i;
+	}
+	return size;
+}
+
+// Converts samples waiting in silence buffer between 16-bit and floating-point
+blargg_err_t Music_Emu::use_float_buf( bool use_float )
+{
+	if ( use_float == buf_is_float )
+		return 0;
+
+	if ( use_float )
+	{
+		RETURN_ERR( float_buf.resize( buf_size ) );
+		copy_samples( &float_buf [buf_size - buf_remain], &buf [buf_size - buf_remain], buf_remain );
+	}
+	else
+	{
+		for ( long i = buf_size - buf_remain; i < buf_size; i++ )
+			blip_store( buf [i], (blip_long) floor( float_buf [i] * 0x8000 + 0.5f ) );
+	}
+	buf_is_float = use_float;
+	return 0;
+}
+
 void Music_Emu::fill_buf()
+{
+	if ( buf_is_float )
+		fill_buf_( float_buf.begin() );
+	else
+		fill_buf_( buf.begin() );
+}
+
+// fill internal buffer and check it for silence
+template<class T>
+void Music_Emu::fill_buf_( T* out )
 {
 	assert( !buf_remain );
 	if ( !emu_track_ended_ )
 	{
-		emu_play( buf_size, buf.begin() );
-		long silence = count_silence( buf.begin(), buf_size );
+		emu_play( buf_size, &out, 1, 0 );
+		long silence = count_silence( out, buf_size );
 		if ( silence < buf_size )
 		{
 			silence_time = emu_time - silence;
@@ -395,10 +910,35 @@ void Music_Emu::fill_buf()
 }
 
 blargg_err_t Music_Emu::play( long out_count, sample_t* out )
+{
+	RETURN_ERR( use_float_buf( false ) );
+	return play_samples( out_count, &out, 1 );
+}
+
+blargg_err_t Music_Emu::play_float( long out_count, float* out )
+{
+	RETURN_ERR( use_float_buf( true ) );
+	return play_samples( out_count, &out, 1 );
+}
+
+blargg_err_t Music_Emu::play_planar( long count, sample_t* const* out )
+{
+	RETURN_ERR( use_float_buf( false ) );
+	return play_samples( count * planar_count(), out, planar_count() );
+}
+
+blargg_err_t Music_Emu::play_planar_float( long count, float* const* out )
+{
+	RETURN_ERR( use_float_buf( true ) );
+	return play_samples( count * planar_count(), out, planar_count() );
+}
+
+template<class T>
+blargg_err_t Music_Emu::play_samples( long out_count, T* const* out, int outs )
 {
 	if ( track_ended_ )
 	{
-		memset( out, 0, out_count * sizeof *out );
+		clear_out( out, outs, 0, out_count );
 	}
 	else
 	{
@@ -415,12 +955,12 @@ blargg_err_t Music_Emu::play( long out_count, sample_t* out )
 		{
 			// during a run of silence, run emulator at >=2x speed so it gets ahead
 			long ahead_time = silence_lookahead * (out_time + out_count - silence_time) + silence_time;
-			while ( emu_time < ahead_time && !(buf_remain | static_cast<long>(emu_track_ended_)) )
+			while ( !low_latency_ && emu_time < ahead_time && !(buf_remain | static_cast<long>(emu_track_ended_)) )
 				fill_buf();
 
 			// fill with silence
 			pos = min( silence_count, out_count );
-			memset( out, 0, pos * sizeof *out );
+			clear_out( out, outs, 0, pos );
 			silence_count -= pos;
 
 			if ( !ignore_silence_ && emu_time - silence_time > silence_max * out_channels() * sample_rate() )
@@ -435,7 +975,7 @@ blargg_err_t Music_Emu::play( long out_count, sample_t* out )
 		{
 			// empty silence buf
 			long n = min( buf_remain, out_count - pos );
-			memcpy( &out [pos], buf.begin() + (buf_size - buf_remain), n * sizeof *out );
+			copy_out( out, outs, pos, buf_begin( out [0] ) + (buf_size - buf_remain), n );
 			buf_remain -= n;
 			pos += n;
 		}
@@ -444,29 +984,275 @@ blargg_err_t Music_Emu::play( long out_count, sample_t* out )
 		long remain = out_count - pos;
 		if ( remain )
 		{
-			emu_play( remain, out + pos );
+			emu_play( remain, out, outs, pos );
 			track_ended_ |= emu_track_ended_;
 
 			if ( !ignore_silence_ && out_time > fade_start )
 			{
 				// check end for a new run of silence
-				long silence = count_silence( out + pos, remain );
+				long silence = count_silence( out, outs, pos, remain );
 				if ( silence < remain )
 					silence_time = emu_time - silence;
 
-				if ( emu_time - silence_time >= buf_size )
+				if ( low_latency_ )
+				{
+					// no lookahead, so silence must actually be played before ending
+					if ( emu_time - silence_time > silence_max * out_channels() * sample_rate() )
+						track_ended_ = emu_track_ended_ = true;
+				}
+				else if ( emu_time - silence_time >= buf_size )
+				{
 					fill_buf(); // cause silence detection on next play()
+				}
 			}
 		}
 
 		if ( fade_start >= 0 && out_time > fade_start )
-			handle_fade( out_count, out );
+			handle_fade( out_count, out, outs );
 	}
 	out_time += out_count;
 	out_time_scaled += int32_t(out_count * tempo_ / out_channels());
 	return 0;
 }
 
+// Parallel rendering
+
+// Segments of emulator output are rendered by workers which each start from state
+// saved during a fast muted pass, a little before their segment. Playing this
+// pre-roll normally brings buffered sound to its exact value, which is verified
+// by comparing state at the segment start with the end state of the previous one.
+// For a track where it doesn't, play_parallel() falls back to playing normally.
+
+static int const parallel_pre_roll = 1000; // msec
+
+struct Music_Emu::segment_t
+{
+	Music_Emu* emu;
+	sample_t* out;
+	long count;
+	long pre_roll;
+	blargg_vector<byte> start; // full state to start pre-roll from
+	blargg_vector<byte> begin; // emulator state at beginning of segment
+	blargg_vector<byte> end;   // emulator state at end of segment
+	blargg_err_t err;          // worker couldn't load state
+	bool failed;               // emulator ended or had error, so result can't be used
+};
+
+// Plays directly from emulator, in same size pieces as all other segments
+blargg_err_t Music_Emu::play_raw( long count, sample_t* out )
+{
+	while ( count && !emu_track_ended_ )
+	{
+		long n = min( count, (long) buf_size );
+		RETURN_ERR( play_( n, out ? out : buf.begin() ) );
+		if ( out )
+			out += n;
+		count -= n;
+	}
+	return 0;
+}
+
+blargg_err_t Music_Emu::save_state_to( blargg_vector<byte>& out, bool with_track )
+{
+	State_Copier sizer;
+	if ( with_track )
+		copy_track_state( sizer );
+	copy_state_( sizer );
+	RETURN_ERR( sizer.error() );
+	RETURN_ERR( out.resize( sizer.pos() ) );
+
+	State_Copier copier;
+	copier.begin_save( out.begin(), out.size() );
+	if ( with_track )
+		copy_track_state( copier );
+	copy_state_( copier );
+	return copier.error();
+}
+
+blargg_err_t Music_Emu::load_state_from( blargg_vector<byte> const& in, bool with_track )
+{
+	State_Copier copier;
+	copier.begin_load( in.begin(), in.size() );
+	if ( with_track )
+		copy_track_state( copier );
+	copy_state_( copier );
+	return copier.error();
+}
+
+static bool same_state( blargg_vector<byte> const& a, blargg_vector<byte> const& b )
+{
+	return a.size() == b.size() && !memcmp( a.begin(), b.begin(), a.size() );
+}
+
+// Runs on worker thread
+void Music_Emu::render_segment( segment_t* s )
+{
+	Music_Emu& emu = *s->emu;
+	s->err = emu.load_state( s->start.begin(), s->start.size() );
+	if ( s->err )
+		return;
+
+	blargg_err_t err = emu.play_raw( s->pre_roll, nullptr );
+	if ( !err )
+		err = emu.save_state_to( s->begin, false );
+	if ( !err )
+		err = emu.play_raw( s->count, s->out );
+	if ( !err )
+		err = emu.save_state_to( s->end, false );
+	s->failed = (err || emu.emu_track_ended_);
+}
+
+// Renders emulator output for segments of size samples (except last), leaving
+// emulator at end of last segment. Sets failed on first segment if
+// this isn't possible.
+blargg_err_t Music_Emu::render_segments( segment_t* segs, int seg_count, long size )
+{
+	// full state at start, then approximate states before each segment
+	long pos = 0;
+	for ( int i = 0; i < seg_count; i++ )
+	{
+		segment_t& s = segs [i];
+		long start = i * size;
+		s.pre_roll = min( start, (long) msec_to_samples( parallel_pre_roll ) / buf_size * buf_size );
+		if ( start - s.pre_roll > pos )
+		{
+			blargg_err_t err = skip_( start - s.pre_roll - pos );
+			pos = start - s.pre_roll;
+			if ( err || emu_track_ended_ )
+			{
+				segs [0].failed = true;
+				return 0;
+			}
+		}
+		RETURN_ERR( save_state_to( s.start, true ) );
+	}
+
+	std::thread* threads = BLARGG_NEW std::thread [seg_count - 1];
+	CHECK_ALLOC( threads );
+	for ( int i = 1; i < seg_count; i++ )
+		threads [i - 1] = std::thread( render_segment, &segs [i] );
+	render_segment( &segs [0] );
+	for ( int i = 1; i < seg_count; i++ )
+		threads [i - 1].join();
+	delete [] threads;
+
+	for ( int i = 0; i < seg_count; i++ )
+		RETURN_ERR( segs [i].err );
+
+	// first segment started from exact state, and each following segment must
+	// begin exactly where the previous one ended
+	if ( segs [0].failed )
+		return 0;
+	int i = 1;
+	while ( i < seg_count && !segs [i].failed && same_state( segs [i].begin, segs [i - 1].end ) )
+		i++;
+
+	if ( i < seg_count )
+	{
+		// muted skip didn't leave emulator as playing would, so render the rest
+		// again without checking each, and just play from now on
+		if ( !segs [i].failed )
+			parallel_inexact = true;
+		RETURN_ERR( load_state_from( segs [i - 1].end, false ) );
+		for ( ; i < seg_count; i++ )
+		{
+			blargg_err_t err = play_raw( segs [i].count, segs [i].out );
+			if ( err || emu_track_ended_ )
+			{
+				segs [0].failed = true;
+				return 0;
+			}
+		}
+		return 0;
+	}
+	return load_state_from( segs [seg_count - 1].end, false );
+}
+
+// Renders count samples of emulator output into out, using each worker for a
+// segment, and sets raw_pos and raw_remain to have emu_play() use it. If this
+// isn't possible, leaves raw_remain at 0 so play() runs emulator normally.
+blargg_err_t Music_Emu::render_parallel( sample_t* out, long count, Music_Emu* const* workers, int worker_count )
+{
+	// segments are multiples of buf_size, so emulators all call play_() at the
+	// same points and their states can be compared
+	int seg_count = (int) min( (long) worker_count, count / buf_size );
+	if ( seg_count < 2 || parallel_inexact || !state_size() )
+		return 0;
+	long size = count / seg_count / buf_size * buf_size;
+
+	for ( int i = 0; i < seg_count; i++ )
+	{
+		Music_Emu& w = *workers [i];
+		require( &w != this );
+		if ( w.sample_rate() != sample_rate_ )
+			return ERR_STATE_INVALID;
+		w.set_tempo( tempo_ );
+		w.mute_voices( mute_mask_ );
+		w.set_equalizer( equalizer_ );
+		w.set_synthesis_quality( synthesis_quality_ );
+		RETURN_ERR( w.set_resampler_quality( resampler_quality_ ) );
+		if ( w.ym2612_emu_ != ym2612_emu_ )
+			RETURN_ERR( w.set_ym2612_emu( ym2612_emu_ ) );
+	}
+
+	segment_t* segs = BLARGG_NEW segment_t [seg_count];
+	CHECK_ALLOC( segs );
+	for ( int i = 0; i < seg_count; i++ )
+	{
+		segment_t& s = segs [i];
+		s.emu    = workers [i];
+		s.out    = out + i * size;
+		s.count  = (i < seg_count - 1) ? size : count - i * size;
+		s.err    = 0;
+		s.failed = false;
+	}
+
+	blargg_err_t err = render_segments( segs, seg_count, size );
+	if ( !err && !segs [0].failed )
+	{
+		// emulator is now at end of rendered output, but track position isn't
+		State_Copier in;
+		in.begin_load( segs [0].start.begin(), segs [0].start.size() );
+		copy_track_state( in );
+		err = in.error();
+		raw_pos    = out;
+		raw_remain = count;
+	}
+	else if ( segs [0].start.size() )
+	{
+		// restore original state
+		blargg_err_t restore_err = load_state_from( segs [0].start, true );
+		if ( !err )
+			err = restore_err;
+	}
+	delete [] segs;
+	return err;
+}
+
+blargg_err_t Music_Emu::play_parallel( long out_count, sample_t* out, Music_Emu* const* workers, int worker_count )
+{
+	require( current_track() >= 0 ); // start_track() must have been called already
+	require( out_count % out_channels() == 0 );
+
+	// emulator output is needed for what isn't already buffered
+	long count = out_count - silence_count - buf_remain;
+	blargg_vector<sample_t> raw;
+	if ( !track_ended_ && !emu_track_ended_ && count > 0 )
+	{
+		RETURN_ERR( raw.resize( count ) );
+		RETURN_ERR( render_parallel( raw.begin(), count, workers, worker_count ) );
+	}
+
+	// keyframes can't be saved until emulator is caught up with rendered output
+	int32_t saved_next_keyframe = next_keyframe;
+	if ( raw_remain )
+		next_keyframe = INT_MAX / 2 + 1;
+	blargg_err_t err = play( out_count, out );
+	next_keyframe = saved_next_keyframe;
+	raw_remain = 0;
+	return err;
+}
+
 // Gme_Info_
 
 blargg_err_t Gme_Info_::set_sample_rate_( long )            { return 0; }
@@ -6,6 +6,7 @@
 
 #include "Gme_File.h"
 class Multi_Buffer;
+class State_Copier;
 
 struct Music_Emu : public Gme_File {
 public:
@@ -27,6 +28,28 @@ public:
 	typedef short sample_t;
 	blargg_err_t play( long count, sample_t* buf );
 
+	// Same as play(), but generates floating-point samples where 1.0 corresponds to
+	// 0x8000. Output isn't clamped, for formats which mix at higher precision.
+	blargg_err_t play_float( long count, float* buf );
+
+	// Same as play(), but writes stereo output of each voice to its own buffer in
+	// multichannel mode, out [0] to out [planar_count() - 1], rather than
+	// interleaving them. 'count' is the number of samples for each buffer.
+	blargg_err_t play_planar( long count, sample_t* const* out );
+	blargg_err_t play_planar_float( long count, float* const* out );
+
+	// Number of buffers play_planar() writes to: one for each voice in multichannel
+	// mode (8, or 9 for SPC, whose echo gets its own), otherwise 1
+	int planar_count() const { return out_channels() / 2; }
+
+	// Generate 'count' samples exactly as play() would, splitting the work between
+	// worker emulators running on separate threads. Each worker must have the same
+	// file loaded with the same sample rate, gain and other settings; tempo, muting
+	// and equalizer are copied from this emulator. Segments whose start can't be
+	// verified are re-rendered here, so output always matches play(). Workers are
+	// left at an arbitrary position in the track.
+	blargg_err_t play_parallel( long count, sample_t* buf, Music_Emu* const* workers, int worker_count );
+
 // Informational
 
 	// Sample rate sound is generated at
@@ -66,6 +89,26 @@ public:
 	// Skip n samples
 	blargg_err_t skip( long n );
 
+	// Record a snapshot of emulator state every msec milliseconds while playing or
+	// skipping, so that later seeks only need to skip from the nearest snapshot.
+	// Snapshots are discarded when a track is started. 0 disables (default).
+	// Has no effect on emulators which can't save their state.
+	void set_keyframe_interval( long msec );
+
+	// Size of buffer needed by save_state() for current track, or 0 if no track
+	// is playing or emulator can't save its state
+	long state_size();
+
+	// Save complete state of current track into out, which must hold at least
+	// state_size() bytes. Loading the state later resumes playback at exactly
+	// the same sample. State is only valid for the same file, sample rate and
+	// library version.
+	blargg_err_t save_state( void* out, long size );
+
+	// Load state saved by save_state(), including fade. Settings such as tempo
+	// and muting aren't part of state. If state is invalid, current track is stopped.
+	blargg_err_t load_state( void const* in, long size );
+
 	// True if a track has reached its end
 	bool track_ended() const;
 
@@ -83,6 +126,13 @@ public:
 	// Disable automatic end-of-track detection and skipping of silence at beginning
 	void ignore_silence( bool disable = true );
 
+	// Play directly from emulator rather than through silence detection buffer, so
+	// work done by each play() is proportional to its sample count. Silence at
+	// beginning of track isn't skipped, and end-of-track silence is detected as it's
+	// played rather than ahead of time.
+	void set_low_latency( bool enable = true );
+	bool low_latency() const;
+
 	// Info for current track
 	using Gme_File::track_info;
 	blargg_err_t track_info( track_info_t* out ) const;
@@ -115,6 +165,23 @@ public:
 	// equalizer settings.
 	void enable_accuracy( bool enable = true );
 
+	// Set band-limited synthesis quality to gme_synthesis_full (default) or
+	// gme_synthesis_fast. Can be changed at any time.
+	void set_synthesis_quality( int );
+	int synthesis_quality() const;
+
+	// Set resampling quality of SPC and VGM/GYM FM sound to gme_resampler_normal
+	// (default), gme_resampler_fast or gme_resampler_precise. Clears resampler,
+	// so is best set before starting a track.
+	blargg_err_t set_resampler_quality( int );
+	int resampler_quality() const;
+
+	// Set YM2612 emulator used by VGM/GYM to gme_ym2612_default, gme_ym2612_nuked,
+	// gme_ym2612_mame or gme_ym2612_gens. Resets FM sound chip, so is best set
+	// before starting a track. Fails for emulators without a YM2612.
+	blargg_err_t set_ym2612_emu( int );
+	int ym2612_emu() const;
+
 // Sound equalization (treble/bass)
 
 	// Frequency equalizer parameters (see gme.txt)
@@ -149,18 +216,39 @@ protected:
 	void set_track_ended()                      { emu_track_ended_ = true; }
 	double gain() const                         { return gain_; }
 	double tempo() const                        { return tempo_; }
+	int mute_mask() const                       { return mute_mask_; }
 	void remute_voices();
-	blargg_err_t set_multi_channel_( bool is_enabled );
+	blargg_err_t set_multi_channel_( bool is_enabled, int stems = 8 ); // stems <= max_stems
 
 	virtual blargg_err_t set_sample_rate_( long sample_rate ) = 0;
 	virtual void set_equalizer_( equalizer_t const& ) { }
 	virtual void enable_accuracy_( bool /* enable */ ) { }
+	virtual void set_synthesis_quality_( int /* quality */ ) { }
+	virtual blargg_err_t set_resampler_quality_( int /* quality */ ) { return 0; }
+	virtual blargg_err_t set_ym2612_emu_( int /* emu */ ) { return ERR_YM2612_EMU_NOT_SUPPORTED; }
 	virtual void mute_voices_( int mask );
 	virtual void disable_echo_( bool /* disable */);
 	virtual void set_tempo_( double );
 	virtual blargg_err_t start_track_( int ); // tempo is set before this
 	virtual blargg_err_t play_( long count, sample_t* out ) = 0;
+	virtual blargg_err_t play_float_( long count, float* out ); // default converts play_() output
+
+	// Write 'count' samples of each voice's stereo output to out [0] to
+	// out [planar_count() - 1] in multichannel mode. Default separates play_() output.
+	enum { max_stems = 9 }; // most stereo outputs in multichannel mode
+	virtual blargg_err_t play_planar_( long count, sample_t* const* out );
+	virtual blargg_err_t play_planar_float_( long count, float* const* out );
 	virtual blargg_err_t skip_( long count );
+
+	// Skip count samples of output which is never heard, for long skips. Overrides
+	// should run emulator without generating sound where possible, while leaving it
+	// in the same state play_() would. Default plays with all voices muted.
+	virtual blargg_err_t fast_forward_( long count );
+
+	// Save/load complete emulator state between calls to play_() (see State_Copier.h).
+	// Settings such as tempo and muting aren't part of state. Default reports
+	// ERR_STATE_NOT_SUPPORTED.
+	virtual void copy_state_( State_Copier& );
 protected:
 	virtual void unload();
 	virtual void pre_load();
@@ -174,10 +262,14 @@ private:
 	int mute_mask_;
 	double tempo_;
 	double gain_;
+	int synthesis_quality_;
+	int resampler_quality_;
+	int ym2612_emu_;
 	bool multi_channel_;
+	int stem_count_;
 
 	// returns the number of output channels, i.e. usually 2 for stereo, unlesss multi_channel_ == true
-	int out_channels() const { return this->multi_channel() ? 2*8 : 2; }
+	int out_channels() const { return this->multi_channel() ? 2*stem_count_ : 2; }
 
 	long sample_rate_;
 	int32_t msec_to_samples( int32_t msec ) const;
@@ -196,18 +288,68 @@ private:
 	// fading
 	int32_t fade_start;
 	int fade_step;
-	void handle_fade( long count, sample_t* out );
+	template<class T> void handle_fade( long count, T* const* out, int outs );
 
 	// silence detection
 	int silence_lookahead; // speed to run emulator when looking ahead for silence
 	bool ignore_silence_;
+	bool low_latency_;
 	long silence_time;     // number of samples where most recent silence began
 	long silence_count;    // number of samples of silence to play before using buf
 	long buf_remain;       // number of samples left in silence buffer
-	enum { buf_size = 2048 };
+	enum { max_buf_size = 2048 };
+	long buf_size; // whole number of frames
 	blargg_vector<sample_t> buf;
+	blargg_vector<float> float_buf; // used instead of buf by play_float()
+	bool buf_is_float;
+	blargg_err_t use_float_buf( bool );
+	sample_t* buf_begin( sample_t* ) { return buf.begin(); }
+	float* buf_begin( float* )       { return float_buf.begin(); }
 	void fill_buf();
-	void emu_play( long count, sample_t* out );
+	template<class T> void fill_buf_( T* );
+	template<class T> void emu_play( long count, T* const* out, int outs, long pos );
+	template<class T> void emu_play_( long count, T* const* out, int outs, long pos );
+	blargg_err_t render_( long n, sample_t* out )  { return play_( n, out ); }
+	blargg_err_t render_( long n, float* out )     { return play_float_( n, out ); }
+	blargg_err_t render_( long n, sample_t* const* out ) { return play_planar_( n, out ); }
+	blargg_err_t render_( long n, float* const* out )    { return play_planar_float_( n, out ); }
+
+	// Output is either interleaved in out [0] (outs = 1) or a buffer for each
+	// stereo pair of channels. Counts and positions are of interleaved samples.
+	template<class T> blargg_err_t play_samples( long count, T* const* out, int outs );
+	template<class T> blargg_err_t separate_voices( long count, T* const* out );
+
+	// parallel rendering
+	sample_t const* raw_pos; // emulator output already rendered by play_parallel()
+	long raw_remain;
+	bool parallel_inexact; // muted skip wasn't exact for current track, so just play
+	struct segment_t;
+	static void render_segment( segment_t* );
+	blargg_err_t render_segments( segment_t*, int count, long size );
+	blargg_err_t render_parallel( sample_t* out, long count, Music_Emu* const* workers, int worker_count );
+	blargg_err_t play_raw( long count, sample_t* out );
+	blargg_err_t save_state_to( blargg_vector<byte>&, bool with_track );
+	blargg_err_t load_state_from( blargg_vector<byte> const&, bool with_track );
+
+	// keyframes for seeking
+	struct keyframe_t
+	{
+		int32_t emu_time;
+		long silence_time;
+		long pos;  // offset in keyframe_data
+		long size;
+	};
+	int32_t keyframe_interval; // in samples, or 0 if disabled
+	int32_t next_keyframe;     // emu_time to save next keyframe at
+	blargg_vector<keyframe_t> keyframes;
+	long keyframe_count;
+	blargg_vector<byte> keyframe_data;
+	long keyframe_data_size;
+	void clear_keyframes();
+	void save_keyframe();
+	bool load_keyframe( long time );
+	blargg_err_t restart_track( int );
+	void copy_track_state( State_Copier& );
 
 	Multi_Buffer* effects_buffer;
 	friend Music_Emu* gme_internal_new_emu_( gme_type_t, int, bool );
@@ -241,9 +383,14 @@ inline bool Music_Emu::track_ended() const          { return track_ended_; }
 inline const Music_Emu::equalizer_t& Music_Emu::equalizer() const { return equalizer_; }
 
 inline void Music_Emu::enable_accuracy( bool b )    { enable_accuracy_( b ); }
+inline int Music_Emu::synthesis_quality() const     { return synthesis_quality_; }
+inline int Music_Emu::resampler_quality() const     { return resampler_quality_; }
+inline int Music_Emu::ym2612_emu() const            { return ym2612_emu_; }
 inline void Music_Emu::set_tempo_( double t )       { tempo_ = t; }
 inline void Music_Emu::remute_voices()              { mute_voices( mute_mask_ ); }
 inline void Music_Emu::ignore_silence( bool b )     { ignore_silence_ = b; }
+inline void Music_Emu::set_low_latency( bool b )    { low_latency_ = b; }
+inline bool Music_Emu::low_latency() const          { return low_latency_; }
 inline blargg_err_t Music_Emu::start_track_( int track )
 {
 	if ( type()->track_count == 1 )
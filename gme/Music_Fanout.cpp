@@ -0,0 +1,125 @@
+// Game_Music_Emu https://bitbucket.org/mpyne/game-music-emu/
+
+#include "Music_Fanout.h"
+
+#include <cstring>
+#include <algorithm>
+
+/* Copyright (C) 2026 Game_Music_Emu contributors. This module is free
+software; you can redistribute it and/or modify it under the terms of the GNU
+Lesser General Public License as published by the Free Software Foundation;
+either version 2.1 of the License, or (at your option) any later version. This
+module is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+PARTICULAR PURPOSE. See the GNU Lesser General Public License for more details.
+You should have received a copy of the GNU Lesser General Public License along
+with this module; if not, write to the Free Software Foundation, Inc., 51
+Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA */
+
+#include "blargg_source.h"
+
+using std::min;
+
+static int const source_block = 2048;  // samples generated by source at a time
+static int const resampler_size = 4096; // input samples each output's resampler holds
+
+Music_Fanout::Music_Fanout( Music_Emu* e ) : emu( e )
+{
+	buf_count = 0;
+}
+
+Music_Fanout::~Music_Fanout()
+{
+	for ( unsigned i = 0; i < outputs.size(); i++ )
+		delete outputs [i];
+}
+
+blargg_err_t Music_Fanout::add_output( long sample_rate, int* index )
+{
+	require( emu->sample_rate() && sample_rate > 0 );
+	if ( emu->multi_channel() )
+		return ERR_MULTICHANNEL_NOT_SUPPORTED;
+
+	output_t* o = BLARGG_NEW output_t;
+	CHECK_ALLOC( o );
+	blargg_err_t err = o->resampler.buffer_size( resampler_size );
+	if ( !err )
+		err = outputs.resize( outputs.size() + 1 );
+	if ( err )
+	{
+		delete o;
+		return err;
+	}
+
+	// use all 512 phases so outputs at different rates don't drift apart
+	o->resampler.set_quality( emu->resampler_quality() == gme_resampler_fast ?
+			Fir_Resampler_::fast_quality : Fir_Resampler_::precise_quality );
+	o->resampler.time_ratio( (double) emu->sample_rate() / sample_rate, 0.9965 );
+	o->pos = buf_count;
+
+	*index = (int) outputs.size() - 1;
+	outputs [*index] = o;
+	return 0;
+}
+
+void Music_Fanout::clear()
+{
+	buf_count = 0;
+	for ( unsigned i = 0; i < outputs.size(); i++ )
+	{
+		outputs [i]->resampler.clear();
+		outputs [i]->pos = 0;
+	}
+}
+
+void Music_Fanout::remove_used()
+{
+	long used = buf_count;
+	for ( unsigned i = 0; i < outputs.size(); i++ )
+		used = min( used, outputs [i]->pos );
+
+	if ( used )
+	{
+		buf_count -= used;
+		memmove( buf.begin(), &buf [used], buf_count * sizeof buf [0] );
+		for ( unsigned i = 0; i < outputs.size(); i++ )
+			outputs [i]->pos -= used;
+	}
+}
+
+blargg_err_t Music_Fanout::fill_buf()
+{
+	remove_used();
+
+	// grows while an output falls behind the others
+	if ( buf_count + source_block > (long) buf.size() )
+		RETURN_ERR( buf.resize( buf_count * 2 + source_block ) );
+
+	RETURN_ERR( emu->play( source_block, &buf [buf_count] ) );
+	buf_count += source_block;
+	return 0;
+}
+
+blargg_err_t Music_Fanout::play( int index, long count, sample_t* out )
+{
+	require( (unsigned) index < outputs.size() );
+	require( (count & 1) == 0 ); // must be even
+	output_t& o = *outputs [index];
+	while ( count >= 2 )
+	{
+		int n = o.resampler.read( out, count );
+		out   += n;
+		count -= n;
+		if ( count < 2 )
+			break;
+
+		if ( o.pos >= buf_count )
+			RETURN_ERR( fill_buf() );
+
+		n = (int) min( (long) o.resampler.max_write(), buf_count - o.pos );
+		memcpy( o.resampler.buffer(), &buf [o.pos], n * sizeof buf [0] );
+		o.resampler.write( n );
+		o.pos += n;
+	}
+	return 0;
+}
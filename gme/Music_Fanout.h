@@ -0,0 +1,54 @@
+// Plays one emulator to several outputs at different sample rates
+
+// Game_Music_Emu https://bitbucket.org/mpyne/game-music-emu/
+#ifndef MUSIC_FANOUT_H
+#define MUSIC_FANOUT_H
+
+#include "Music_Emu.h"
+#include "Fir_Resampler.h"
+
+struct Music_Fanout {
+public:
+	typedef Music_Emu::sample_t sample_t;
+
+	// Source emulator, which must have a file loaded and a track started. It isn't
+	// owned by the fanout. Its sample rate is the rate every output is resampled
+	// from, so it should be the native rate where a format has one (32000 for SPC),
+	// otherwise the highest output rate.
+	explicit Music_Fanout( Music_Emu* );
+	Music_Emu* source() const { return emu; }
+
+	// Add output at 'sample_rate', setting *index to its index. Output starts with
+	// the next sound the source generates.
+	blargg_err_t add_output( long sample_rate, int* index );
+
+	// Number of outputs added
+	int output_count() const { return (int) outputs.size(); }
+
+	// Generate 'count' samples for output 'index'. The source is only run when
+	// this output has used everything it has already generated. Samples the other
+	// outputs have yet to use are kept, so outputs can be read at any pace.
+	blargg_err_t play( int index, long count, sample_t* out );
+
+	// Clear buffered sound of all outputs. Call after starting a new track or
+	// seeking the source.
+	void clear();
+
+public:
+	~Music_Fanout();
+	BLARGG_DISABLE_NOTHROW
+private:
+	struct output_t {
+		Fir_Resampler<24> resampler;
+		long pos; // next sample in buf to give to resampler
+	};
+	Music_Emu* const emu;
+	blargg_vector<output_t*> outputs;
+	blargg_vector<sample_t> buf;
+	long buf_count;
+
+	blargg_err_t fill_buf();
+	void remove_used();
+};
+
+#endif
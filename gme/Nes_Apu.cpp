@@ -2,6 +2,8 @@
 
 #include "Nes_Apu.h"
 
+#include "State_Copier.h"
+
 /* Copyright (C) 2003-2006 Shay Green. This module is free software; you
 can redistribute it and/or modify it under the terms of the GNU Lesser
 General Public License as published by the Free Software Foundation; either
@@ -389,3 +391,63 @@ int Nes_Apu::read_status( nes_time_t time )
 
 	return result;
 }
+
+static void copy_osc_state( State_Copier& copier, Nes_Osc& osc )
+{
+	copier.copy( osc.regs, sizeof osc.regs );
+	copier.copy_ints( osc.reg_written, 4 );
+	copier.copy_int( osc.length_counter );
+	copier.copy_int( osc.delay );
+	copier.copy_int( osc.last_amp );
+}
+
+static void copy_env_state( State_Copier& copier, Nes_Envelope& osc )
+{
+	copy_osc_state( copier, osc );
+	copier.copy_int( osc.envelope );
+	copier.copy_int( osc.env_delay );
+}
+
+void Nes_Apu::copy_state( State_Copier& copier )
+{
+	copy_env_state( copier, square1 );
+	copier.copy_int( square1.phase );
+	copier.copy_int( square1.sweep_delay );
+
+	copy_env_state( copier, square2 );
+	copier.copy_int( square2.phase );
+	copier.copy_int( square2.sweep_delay );
+
+	copy_osc_state( copier, triangle );
+	copier.copy_int( triangle.phase );
+	copier.copy_int( triangle.linear_counter );
+
+	copy_env_state( copier, noise );
+	copier.copy_int( noise.noise );
+
+	copy_osc_state( copier, dmc );
+	copier.copy_int( dmc.address );
+	copier.copy_int( dmc.period );
+	copier.copy_int( dmc.buf );
+	copier.copy_int( dmc.bits_remain );
+	copier.copy_int( dmc.bits );
+	copier.copy_int( dmc.buf_full );
+	copier.copy_int( dmc.silence );
+	copier.copy_int( dmc.dac );
+	copier.copy_int( dmc.next_irq );
+	copier.copy_int( dmc.irq_enabled );
+	copier.copy_int( dmc.irq_flag );
+
+	copier.copy_int( last_time );
+	copier.copy_int( last_dmc_time );
+	copier.copy_int( earliest_irq_ );
+	copier.copy_int( next_irq );
+	copier.copy_int( frame_delay );
+	copier.copy_int( frame );
+	copier.copy_int( osc_enables );
+	copier.copy_int( frame_mode );
+	copier.copy_int( irq_flag );
+
+	if ( copier.loading() )
+		set_tempo( tempo_ );
+}
@@ -9,6 +9,7 @@
 
 struct apu_state_t;
 class Nes_Buffer;
+class State_Copier;
 
 class Nes_Apu {
 public:
@@ -53,6 +54,9 @@ public:
 	void save_state( apu_state_t* out ) const;
 	void load_state( apu_state_t const& );
 
+	// Save/load emulation state between frames, using a portable format
+	void copy_state( State_Copier& );
+
 	// Set overall volume (default is 1.0)
 	void volume( double );
 
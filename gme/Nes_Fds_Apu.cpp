@@ -2,6 +2,8 @@
 
 #include "Nes_Fds_Apu.h"
 
+#include "State_Copier.h"
+
 /* Copyright (C) 2006 Shay Green. This module is free software; you
 can redistribute it and/or modify it under the terms of the GNU Lesser
 General Public License as published by the Free Software Foundation; either
@@ -49,6 +51,25 @@ void Nes_Fds_Apu::reset()
 	}
 }
 
+void Nes_Fds_Apu::copy_state( State_Copier& copier )
+{
+	copier.copy( regs_, sizeof regs_ );
+	copier.copy_int( env_delay );
+	copier.copy_int( env_speed );
+	copier.copy_int( env_gain );
+	copier.copy_int( sweep_delay );
+	copier.copy_int( sweep_speed );
+	copier.copy_int( sweep_gain );
+	copier.copy_int( wave_pos );
+	copier.copy_int( last_amp );
+	copier.copy_int( wave_fract );
+	copier.copy_int( mod_fract );
+	copier.copy_int( mod_pos );
+	copier.copy_int( mod_write_pos );
+	copier.copy( mod_wave, sizeof mod_wave );
+	copier.copy_int( last_time );
+}
+
 void Nes_Fds_Apu::write_( unsigned addr, int data )
 {
 	unsigned reg = addr - io_addr;
@@ -114,9 +135,12 @@ void Nes_Fds_Apu::run_until( blip_time_t final_end_time )
 {
 	int const wave_freq = (regs (0x4083) & 0x0F) * 0x100 + regs (0x4082);
 	Blip_Buffer* const output_ = this->output_;
-	if ( wave_freq && output_ && !((regs (0x4089) | regs (0x4083)) & 0x80) )
+	// muted sound is run the same way without adding sound, so it sounds the
+	// same after being muted during a skip
+	if ( wave_freq && !((regs (0x4089) | regs (0x4083)) & 0x80) )
 	{
-		output_->set_modified();
+		if ( output_ )
+			output_->set_modified();
 
 		// master_volume
 		#define MVOL_ENTRY( percent ) (master_vol_max * percent + 50) / 100
@@ -252,7 +276,8 @@ void Nes_Fds_Apu::run_until( blip_time_t final_end_time )
 					if ( delta )
 					{
 						last_amp = amp;
-						synth.offset_inline( time, delta, output_ );
+						if ( output_ )
+							synth.offset_inline( time, delta, output_ );
 					}
 
 					wave_fract += fract_range - delay * freq;
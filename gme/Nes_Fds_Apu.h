@@ -8,6 +8,8 @@
 #include "blargg_common.h"
 #include "Blip_Buffer.h"
 
+class State_Copier;
+
 class Nes_Fds_Apu {
 public:
 	// setup
@@ -24,6 +26,9 @@ public:
 	int read( blip_time_t time, unsigned addr );
 	void end_frame( blip_time_t );
 
+	// Save/load emulation state between frames, using a portable format
+	void copy_state( State_Copier& );
+
 public:
 	Nes_Fds_Apu();
 	void write_( unsigned addr, int data );
@@ -2,6 +2,8 @@
 
 #include "Nes_Fme7_Apu.h"
 
+#include "State_Copier.h"
+
 #include <cstring>
 
 /* Copyright (C) 2003-2006 Shay Green. This module is free software; you
@@ -49,9 +51,8 @@ void Nes_Fme7_Apu::run_until( blip_time_t end_time )
 		int volume = amp_table [vol_mode & 0x0F];
 
 		Blip_Buffer* const osc_output = oscs [index].output;
-		if ( !osc_output )
-			continue;
-		osc_output->set_modified();
+		if ( osc_output )
+			osc_output->set_modified();
 
 		// check for unsupported mode
 		#ifndef NDEBUG
@@ -74,6 +75,22 @@ void Nes_Fme7_Apu::run_until( blip_time_t end_time )
 				period = period_factor;
 		}
 
+		if ( !osc_output )
+		{
+			// keep phase and amplitude the same as when playing, so it sounds the
+			// same after being muted during a skip
+			blip_time_t time = last_time + delays [index];
+			if ( time < end_time )
+			{
+				int count = (end_time - time + period - 1) / period;
+				phases [index] ^= count & 1;
+				time += (int32_t) count * period;
+			}
+			oscs [index].last_amp = phases [index] ? volume : 0;
+			delays [index] = time - end_time;
+			continue;
+		}
+
 		// current amplitude
 		int amp = volume;
 		if ( !phases [index] )
@@ -119,3 +136,13 @@ void Nes_Fme7_Apu::run_until( blip_time_t end_time )
 	last_time = end_time;
 }
 
+void Nes_Fme7_Apu::copy_state( State_Copier& copier )
+{
+	copier.copy( regs, sizeof regs );
+	copier.copy( phases, sizeof phases );
+	copier.copy_int( latch );
+	copier.copy_ints( delays, osc_count );
+	for ( int i = 0; i < osc_count; i++ )
+		copier.copy_int( oscs [i].last_amp );
+	copier.copy_int( last_time );
+}
@@ -8,6 +8,8 @@
 #include "Blip_Buffer.h"
 #include <cstdint>
 
+class State_Copier;
+
 struct fme7_apu_state_t
 {
 	static const unsigned int reg_count = 14;
@@ -30,6 +32,9 @@ public:
 	void save_state( fme7_apu_state_t* ) const;
 	void load_state( fme7_apu_state_t const& );
 
+	// Save/load emulation state between frames, using a portable format
+	void copy_state( State_Copier& );
+
 	// Mask and addresses of registers
 	static const unsigned int addr_mask = 0xE000;
 	static const unsigned int data_addr = 0xE000;
@@ -2,6 +2,8 @@
 
 #include "Nes_Namco_Apu.h"
 
+#include "State_Copier.h"
+
 /* Copyright (C) 2003-2006 Shay Green. This module is free software; you
 can redistribute it and/or modify it under the terms of the GNU Lesser
 General Public License as published by the Free Software Foundation; either
@@ -15,6 +17,7 @@ Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA */
 
 Nes_Namco_Apu::Nes_Namco_Apu()
 {
+	resampled_factor = 0;
 	output( nullptr );
 	volume( 1.0 );
 	reset();
@@ -38,6 +41,20 @@ void Nes_Namco_Apu::reset()
 	}
 }
 
+void Nes_Namco_Apu::copy_state( State_Copier& copier )
+{
+	for ( int i = 0; i < osc_count; i++ )
+	{
+		Namco_Osc& osc = oscs [i];
+		copier.copy_int( osc.delay );
+		copier.copy_int( osc.last_amp );
+		copier.copy_int( osc.wave_pos );
+	}
+	copier.copy_int( last_time );
+	copier.copy_int( addr_reg );
+	copier.copy( reg, sizeof reg );
+}
+
 void Nes_Namco_Apu::output( Blip_Buffer* buf )
 {
 	for ( int i = 0; i < osc_count; i++ )
@@ -77,14 +94,18 @@ void Nes_Namco_Apu::run_until( blip_time_t nes_end_time )
 	for ( int i = osc_count - active_oscs; i < osc_count; i++ )
 	{
 		Namco_Osc& osc = oscs [i];
+		// muted oscillator is run the same way without adding sound, so it
+		// sounds the same after being muted during a skip
 		Blip_Buffer* output = osc.output;
-		if ( !output )
-			continue;
-		output->set_modified();
-
-		blip_resampled_time_t time =
-				output->resampled_time( last_time ) + osc.delay;
-		blip_resampled_time_t end_time = output->resampled_time( nes_end_time );
+		blip_resampled_time_t time = last_time * resampled_factor + osc.delay;
+		blip_resampled_time_t end_time = nes_end_time * resampled_factor;
+		if ( output )
+		{
+			output->set_modified();
+			resampled_factor = output->resampled_duration( 1 );
+			time = output->resampled_time( last_time ) + osc.delay;
+			end_time = output->resampled_time( nes_end_time );
+		}
 		osc.delay = 0;
 		if ( time < end_time )
 		{
@@ -100,7 +121,7 @@ void Nes_Namco_Apu::run_until( blip_time_t nes_end_time )
 			if ( freq < 64 * active_oscs )
 				continue; // prevent low frequencies from excessively delaying freq changes
 			blip_resampled_time_t period =
-					output->resampled_duration( 983040 ) / freq * active_oscs;
+					resampled_factor * 983040 / freq * active_oscs;
 
 			int wave_size = 32 - (osc_reg [4] >> 2 & 7) * 4;
 			if ( !wave_size )
@@ -122,7 +143,8 @@ void Nes_Namco_Apu::run_until( blip_time_t nes_end_time )
 				if ( delta )
 				{
 					last_amp = sample;
-					synth.offset_resampled( time, delta, output );
+					if ( output )
+						synth.offset_resampled( time, delta, output );
 				}
 
 				// next sample
@@ -9,6 +9,7 @@
 #include <cstdint>
 
 struct namco_state_t;
+class State_Copier;
 
 class Nes_Namco_Apu {
 public:
@@ -34,6 +35,9 @@ public:
 	void save_state( namco_state_t* out ) const;
 	void load_state( namco_state_t const& );
 
+	// Save/load emulation state between frames, using a portable format
+	void copy_state( State_Copier& );
+
 public:
 	Nes_Namco_Apu();
 	BLARGG_DISABLE_NOTHROW
@@ -52,6 +56,7 @@ private:
 	Namco_Osc oscs [osc_count];
 
 	blip_time_t last_time;
+	blip_resampled_time_t resampled_factor; // of last output, used while muted
 	int addr_reg;
 
 	static const int reg_count = 0x80;
@@ -92,6 +97,8 @@ inline void Nes_Namco_Apu::osc_output( int i, Blip_Buffer* buf )
 {
 	assert( (unsigned) i < osc_count );
 	oscs [i].output = buf;
+	if ( buf )
+		resampled_factor = buf->resampled_duration( 1 );
 }
 
 inline void Nes_Namco_Apu::write_data( blip_time_t time, int data )
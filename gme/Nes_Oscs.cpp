@@ -97,20 +97,32 @@ void Nes_Square::run( nes_time_t time, nes_time_t end_time )
 	const int period = this->period();
 	const int timer_period = (period + 1) * 2;
 
+	int offset = period >> (regs [1] & shift_mask);
+	if ( regs [1] & negate_flag )
+		offset = 0;
+
+	const int volume = this->volume();
+	bool const silent = (volume == 0 || period < 8 || (period + offset) >= 0x800);
+
 	if ( !output )
 	{
+		// keep phase and amplitude the same as when playing, so it sounds the
+		// same after being muted during a skip
 		delay = maintain_phase( time + delay, end_time, timer_period ) - end_time;
+		last_amp = 0;
+		if ( !silent )
+		{
+			int duty_select = (regs [0] >> 6) & 3;
+			int duty = (duty_select == 3) ? 2 : 1 << duty_select;
+			if ( (phase < duty) != (duty_select == 3) )
+				last_amp = volume;
+		}
 		return;
 	}
 
 	output->set_modified();
 
-	int offset = period >> (regs [1] & shift_mask);
-	if ( regs [1] & negate_flag )
-		offset = 0;
-
-	const int volume = this->volume();
-	if ( volume == 0 || period < 8 || (period + offset) >= 0x800 )
+	if ( silent )
 	{
 		if ( last_amp ) {
 			synth.offset( time, -last_amp, output );
@@ -210,6 +222,7 @@ void Nes_Triangle::run( nes_time_t time, nes_time_t end_time )
 		delay = 0;
 		if ( length_counter && linear_counter && timer_period >= 3 )
 			delay = maintain_phase( time, end_time, timer_period ) - end_time;
+		last_amp = calc_amp();
 		return;
 	}
 
@@ -398,12 +411,9 @@ void Nes_Dmc::fill_buffer()
 
 void Nes_Dmc::run( nes_time_t time, nes_time_t end_time )
 {
+	// muted DAC keeps changing, so it's the same as when playing afterwards
 	int delta = update_amp( dac );
-	if ( !output )
-	{
-		silence = true;
-	}
-	else
+	if ( output )
 	{
 		output->set_modified();
 		if ( delta )
@@ -435,7 +445,8 @@ void Nes_Dmc::run( nes_time_t time, nes_time_t end_time )
 					bits >>= 1;
 					if ( unsigned (dac + step) <= 0x7F ) {
 						dac += step;
-						synth.offset_inline( time, step, output );
+						if ( output )
+							synth.offset_inline( time, step, output );
 					}
 				}
 
@@ -451,8 +462,6 @@ void Nes_Dmc::run( nes_time_t time, nes_time_t end_time )
 						silence = false;
 						bits = buf;
 						buf_full = false;
-						if ( !output )
-							silence = true;
 						fill_buffer();
 					}
 				}
@@ -481,9 +490,36 @@ void Nes_Noise::run( nes_time_t time, nes_time_t end_time )
 
 	if ( !output )
 	{
-		// TODO: clean up
+		// keep noise register the same as when playing, so it sounds the same after
+		// being muted during a skip
 		time += delay;
-		delay = time + (end_time - time + period - 1) / period * period - end_time;
+		if ( time < end_time )
+		{
+			int count = (end_time - time + period - 1) / period;
+			time += count * period;
+
+			int noise = this->noise;
+			if ( !volume() )
+			{
+				if ( !(regs [2] & 0x80) )
+				{
+					int feedback = (noise << 13) ^ (noise << 14);
+					noise = (feedback & 0x4000) | (noise >> 1);
+				}
+			}
+			else
+			{
+				const int tap = (regs [2] & 0x80 ? 8 : 13);
+				for ( ; count; --count )
+				{
+					int feedback = (noise << tap) ^ (noise << 14);
+					noise = (feedback & 0x4000) | (noise >> 1);
+				}
+			}
+			this->noise = noise;
+		}
+		last_amp = (this->noise & 1) ? volume() : 0;
+		delay = time - end_time;
 		return;
 	}
 
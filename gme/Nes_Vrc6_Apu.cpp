@@ -2,6 +2,8 @@
 
 #include "Nes_Vrc6_Apu.h"
 
+#include "State_Copier.h"
+
 /* Copyright (C) 2003-2006 Shay Green. This module is free software; you
 can redistribute it and/or modify it under the terms of the GNU Lesser
 General Public License as published by the Free Software Foundation; either
@@ -102,12 +104,27 @@ void Nes_Vrc6_Apu::load_state( vrc6_apu_state_t const& in )
 		oscs [2].phase = 1;
 }
 
+void Nes_Vrc6_Apu::copy_state( State_Copier& copier )
+{
+	for ( int i = 0; i < osc_count; i++ )
+	{
+		Vrc6_Osc& osc = oscs [i];
+		copier.copy( osc.regs, sizeof osc.regs );
+		copier.copy_int( osc.delay );
+		copier.copy_int( osc.last_amp );
+		copier.copy_int( osc.phase );
+		copier.copy_int( osc.amp );
+	}
+	copier.copy_int( last_time );
+}
+
 void Nes_Vrc6_Apu::run_square( Vrc6_Osc& osc, blip_time_t end_time )
 {
+	// muted oscillator is run the same way without adding sound, so it
+	// sounds the same after being muted during a skip
 	Blip_Buffer* output = osc.output;
-	if ( !output )
-		return;
-	output->set_modified();
+	if ( output )
+		output->set_modified();
 
 	int volume = osc.regs [0] & 15;
 	if ( !(osc.regs [2] & 0x80) )
@@ -120,7 +137,8 @@ void Nes_Vrc6_Apu::run_square( Vrc6_Osc& osc, blip_time_t end_time )
 	if ( delta )
 	{
 		osc.last_amp += delta;
-		square_synth.offset( time, delta, output );
+		if ( output )
+			square_synth.offset( time, delta, output );
 	}
 
 	time += osc.delay;
@@ -139,12 +157,14 @@ void Nes_Vrc6_Apu::run_square( Vrc6_Osc& osc, blip_time_t end_time )
 				{
 					phase = 0;
 					osc.last_amp = volume;
-					square_synth.offset( time, volume, output );
+					if ( output )
+						square_synth.offset( time, volume, output );
 				}
 				if ( phase == duty )
 				{
 					osc.last_amp = 0;
-					square_synth.offset( time, -volume, output );
+					if ( output )
+						square_synth.offset( time, -volume, output );
 				}
 				time += period;
 			}
@@ -160,9 +180,8 @@ void Nes_Vrc6_Apu::run_saw( blip_time_t end_time )
 {
 	Vrc6_Osc& osc = oscs [2];
 	Blip_Buffer* output = osc.output;
-	if ( !output )
-		return;
-	output->set_modified();
+	if ( output )
+		output->set_modified();
 
 	int amp = osc.amp;
 	int amp_step = osc.regs [0] & 0x3F;
@@ -173,7 +192,8 @@ void Nes_Vrc6_Apu::run_saw( blip_time_t end_time )
 		osc.delay = 0;
 		int delta = (amp >> 3) - last_amp;
 		last_amp = amp >> 3;
-		saw_synth.offset( time, delta, output );
+		if ( output )
+			saw_synth.offset( time, delta, output );
 	}
 	else
 	{
@@ -195,7 +215,8 @@ void Nes_Vrc6_Apu::run_saw( blip_time_t end_time )
 				if ( delta )
 				{
 					last_amp = amp >> 3;
-					saw_synth.offset( time, delta, output );
+					if ( output )
+						saw_synth.offset( time, delta, output );
 				}
 
 				time += period;
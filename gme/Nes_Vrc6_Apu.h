@@ -9,6 +9,7 @@
 #include <cstdint>
 
 struct vrc6_apu_state_t;
+class State_Copier;
 
 class Nes_Vrc6_Apu {
 public:
@@ -23,6 +24,9 @@ public:
 	void save_state( vrc6_apu_state_t* ) const;
 	void load_state( vrc6_apu_state_t const& );
 
+	// Save/load emulation state between frames, using a portable format
+	void copy_state( State_Copier& );
+
 	// Oscillator 0 write-only registers are at $9000-$9002
 	// Oscillator 1 write-only registers are at $A000-$A002
 	// Oscillator 2 write-only registers are at $B000-$B002
@@ -1,9 +1,12 @@
 #include "Nes_Vrc7_Apu.h"
 
+#include "State_Copier.h"
+
 extern "C" {
 #include "ext/emu2413.h"
 }
 
+#include <cstdlib>
 #include <cstring>
 
 #include "blargg_source.h"
@@ -162,6 +165,49 @@ void Nes_Vrc7_Apu::load_snapshot( vrc7_snapshot_t const& in )
 	}
 }
 
+void Nes_Vrc7_Apu::copy_state( State_Copier& copier )
+{
+	copier.copy_int( addr );
+	copier.copy_int( next_time );
+	copier.copy( inst, sizeof inst );
+	for ( int i = 0; i < osc_count; i++ )
+	{
+		copier.copy( oscs [i].regs, sizeof oscs [i].regs );
+		copier.copy_int( oscs [i].last_amp );
+	}
+	copier.copy_int( mono.last_amp );
+
+	// OPLL is copied raw with its internal pointers converted to indices
+	OPLL* const chip = (OPLL*) opll;
+	if ( !copier.loading() )
+	{
+		OPLL_packPointers( chip );
+		copier.copy( chip, sizeof *chip );
+		OPLL_unpackPointers( chip );
+		return;
+	}
+
+	// load into copy so chip is unchanged if state is invalid
+	OPLL* in = (OPLL*) malloc( sizeof *in );
+	if ( !in )
+	{
+		copier.set_error( ERR_OUT_OF_MEMORY );
+		return;
+	}
+	copier.copy( in, sizeof *in );
+	if ( OPLL_unpackPointers( in ) || copier.error() )
+	{
+		copier.set_error( ERR_STATE_INVALID );
+	}
+	else
+	{
+		in->conv = chip->conv;
+		in->mask = chip->mask;
+		memcpy( chip, in, sizeof *chip );
+	}
+	free( in );
+}
+
 void Nes_Vrc7_Apu::run_until( blip_time_t end_time )
 {
 	require( end_time > next_time );
@@ -196,16 +242,15 @@ void Nes_Vrc7_Apu::run_until( blip_time_t end_time )
 			OPLL_calc_stereo( (OPLL *) opll, buffer );
 			for ( int i = 0; i < osc_count; ++i )
 			{
+				// muted oscillators keep amplitude the same as when playing
 				Vrc7_Osc& osc = oscs [i];
-				if ( osc.output )
+				int amp = ((OPLL *) opll)->ch_out[i];
+				int delta = amp - osc.last_amp;
+				if ( delta )
 				{
-					int amp = ((OPLL *) opll)->ch_out[i];
-					int delta = amp - osc.last_amp;
-					if ( delta )
-					{
-						osc.last_amp = amp;
+					osc.last_amp = amp;
+					if ( osc.output )
 						synth.offset( time, delta, osc.output );
-					}
 				}
 			}
 			time += period;
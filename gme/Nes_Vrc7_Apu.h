@@ -10,6 +10,7 @@
 #include <cstdint>
 
 struct vrc7_snapshot_t;
+class State_Copier;
 
 class Nes_Vrc7_Apu {
 public:
@@ -26,6 +27,10 @@ public:
 	void save_snapshot( vrc7_snapshot_t* ) const;
 	void load_snapshot( vrc7_snapshot_t const& );
 
+	// Save/load emulation state between frames, using a portable format. Unlike
+	// snapshots, this includes the complete FM synthesis state.
+	void copy_state( State_Copier& );
+
 	void write_reg( int reg );
 	void write_data( blip_time_t, int data );
 
@@ -2,6 +2,7 @@
 
 #include "Nsf_Emu.h"
 
+#include "State_Copier.h"
 #include "blargg_endian.h"
 #include <cstring>
 #include <algorithm>
@@ -613,6 +614,52 @@ blargg_err_t Nsf_Emu::start_track_( int track )
 	return 0;
 }
 
+static void copy_registers( State_Copier& copier, Nes_Cpu::registers_t& r )
+{
+	copier.copy_int( r.pc );
+	copier.copy_int( r.a );
+	copier.copy_int( r.x );
+	copier.copy_int( r.y );
+	copier.copy_int( r.status );
+	copier.copy_int( r.sp );
+}
+
+void Nsf_Emu::copy_state_( State_Copier& copier )
+{
+	copy_buffer_state( copier );
+
+	copy_registers( copier, r );
+	copy_registers( copier, saved_state );
+	copier.copy( low_mem, sizeof low_mem );
+	copier.copy( sram, sizeof sram );
+	copier.copy( banks, sizeof banks );
+	if ( copier.loading() )
+	{
+		for ( int i = 0; i < bank_count; ++i )
+			cpu_write( bank_select_addr + i, banks [i] );
+	}
+
+	copier.copy_int( next_play );
+	copier.copy_int( play_extra );
+	copier.copy_int( play_ready );
+
+	apu.copy_state( copier );
+
+	#if !NSF_EMU_APU_ONLY
+	copier.copy( mmc5_mul, sizeof mmc5_mul );
+	if ( namco ) namco->copy_state( copier );
+	if ( vrc6  ) vrc6 ->copy_state( copier );
+	if ( fme7  ) fme7 ->copy_state( copier );
+	if ( fds   ) fds  ->copy_state( copier );
+	if ( mmc5  )
+	{
+		mmc5->copy_state( copier );
+		copier.copy( mmc5->exram, mmc5->exram_size );
+	}
+	if ( vrc7  ) vrc7 ->copy_state( copier );
+	#endif
+}
+
 blargg_err_t Nsf_Emu::run_clocks( blip_time_t& duration, int )
 {
 	set_time( 0 );
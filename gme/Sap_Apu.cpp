@@ -2,6 +2,7 @@
 
 #include "Sap_Apu.h"
 
+#include "State_Copier.h"
 #include <cstring>
 #include <cstdint>
 
@@ -144,12 +145,12 @@ void Sap_Apu::run_until( blip_time_t end_time )
 		blip_time_t time = last_time + osc->delay;
 		blip_time_t const period = osc->period;
 
-		// output
+		// output; muted oscillators are run the same way without adding sound, so
+		// they sound the same after being muted during a skip
 		Blip_Buffer* output = osc->output;
 		if ( output )
-		{
 			output->set_modified();
-
+		{
 			int const osc_control = osc->regs [1]; // cache
 			int volume = (osc_control & 0x0F) * 2;
 			if ( !volume || osc_control & 0x10 || // silent, DAC mode, or inaudible frequency
@@ -162,7 +163,8 @@ void Sap_Apu::run_until( blip_time_t end_time )
 				if ( delta )
 				{
 					osc->last_amp = volume;
-					impl->synth.offset( last_time, delta, output );
+					if ( output )
+						impl->synth.offset( last_time, delta, output );
 				}
 
 				// TODO: doesn't maintain high pass flip-flop (very minor issue)
@@ -235,7 +237,8 @@ void Sap_Apu::run_until( blip_time_t end_time )
 							{
 								osc_last_amp += delta - volume;
 								volume = -volume;
-								impl->synth.offset( time2, delta, output );
+								if ( output )
+									impl->synth.offset( time2, delta, output );
 							}
 						}
 						while ( time2 <= time ) // must advance *past* time to avoid hang
@@ -256,7 +259,8 @@ void Sap_Apu::run_until( blip_time_t end_time )
 								if ( delta )
 								{
 									osc_last_amp = amp;
-									impl->synth.offset( time, delta, output );
+									if ( output )
+										impl->synth.offset( time, delta, output );
 								}
 							}
 							wave = run_poly5( wave, poly5_inc );
@@ -334,3 +338,27 @@ void Sap_Apu::end_frame( blip_time_t end_time )
 
 	last_time -= end_time;
 }
+
+void Sap_Apu::copy_state( State_Copier& copier )
+{
+	for ( int i = 0; i < osc_count; i++ )
+	{
+		osc_t& osc = oscs [i];
+		copier.copy( osc.regs, sizeof osc.regs );
+		copier.copy_int( osc.phase );
+		copier.copy_int( osc.invert );
+		copier.copy_int( osc.last_amp );
+		copier.copy_int( osc.delay );
+	}
+	copier.copy_int( last_time );
+	copier.copy_int( poly5_pos );
+	copier.copy_int( poly4_pos );
+	copier.copy_int( polym_pos );
+	copier.copy_int( control );
+	if ( copier.loading() )
+	{
+		poly5_pos = (unsigned) poly5_pos % poly5_len;
+		poly4_pos = (unsigned) poly4_pos % poly4_len;
+		polym_pos = (unsigned) polym_pos % poly17_len;
+	}
+}
@@ -7,6 +7,7 @@
 #include "Blip_Buffer.h"
 
 class Sap_Apu_Impl;
+class State_Copier;
 
 class Sap_Apu {
 public:
@@ -21,6 +22,9 @@ public:
 
 	void end_frame( blip_time_t );
 
+	// Save/load emulation state between frames, using a portable format
+	void copy_state( State_Copier& );
+
 public:
 	Sap_Apu();
 private:
@@ -2,6 +2,7 @@
 
 #include "Sap_Emu.h"
 
+#include "State_Copier.h"
 #include "blargg_endian.h"
 #include <cstring>
 #include <algorithm>
@@ -370,6 +371,24 @@ blargg_err_t Sap_Emu::start_track_( int track )
 	return 0;
 }
 
+void Sap_Emu::copy_state_( State_Copier& copier )
+{
+	copy_buffer_state( copier );
+
+	copier.copy_int( r.pc );
+	copier.copy_int( r.a );
+	copier.copy_int( r.x );
+	copier.copy_int( r.y );
+	copier.copy_int( r.status );
+	copier.copy_int( r.sp );
+	copier.copy( mem.ram, sizeof mem.ram );
+	copier.copy_int( next_play );
+
+	apu.copy_state( copier );
+	if ( info.stereo )
+		apu2.copy_state( copier );
+}
+
 // Emulation
 
 // see sap_cpu_io.h for read/write functions
@@ -2,6 +2,8 @@
 
 #include "Sms_Apu.h"
 
+#include "State_Copier.h"
+
 /* Copyright (C) 2003-2006 Shay Green. This module is free software; you
 can redistribute it and/or modify it under the terms of the GNU Lesser
 General Public License as published by the Free Software Foundation; either
@@ -47,7 +49,26 @@ inline void Sms_Square::reset()
 
 void Sms_Square::run( blip_time_t time, blip_time_t end_time )
 {
-	if ( !volume || period <= 128 )
+	if ( !output )
+	{
+		// keep phase and amplitude the same as when playing, so it sounds the
+		// same after being muted during a skip
+		time += delay;
+		if ( !period )
+		{
+			time = end_time;
+		}
+		else if ( time < end_time )
+		{
+			int count = (end_time - time + period - 1) / period;
+			phase = (phase + count) & 1;
+			time += count * period;
+		}
+		last_amp = 0;
+		if ( volume && period > 128 )
+			last_amp = phase ? volume : -volume;
+	}
+	else if ( !volume || period <= 128 )
 	{
 		// ignore 16kHz and higher
 		if ( last_amp )
@@ -113,6 +134,34 @@ inline void Sms_Noise::reset()
 
 void Sms_Noise::run( blip_time_t time, blip_time_t end_time )
 {
+	if ( !output )
+	{
+		// keep shifter the same as when playing
+		time += delay;
+		if ( !volume )
+			time = end_time;
+
+		if ( time < end_time )
+		{
+			unsigned shifter = this->shifter;
+			int period = *this->period * 2;
+			if ( !period )
+				period = 16;
+
+			do
+			{
+				shifter = (feedback & uMinus(shifter & 1)) ^ (shifter >> 1);
+				time += period;
+			}
+			while ( time < end_time );
+
+			this->shifter = shifter;
+		}
+		last_amp = (shifter & 1) ? -volume : volume;
+		delay = time - end_time;
+		return;
+	}
+
 	int amp = volume;
 	if ( shifter & 1 )
 		amp = -amp;
@@ -243,13 +292,11 @@ void Sms_Apu::run_until( blip_time_t end_time )
 		{
 			Sms_Osc& osc = *oscs [i];
 			if ( osc.output )
-			{
 				osc.output->set_modified();
-				if ( i < 3 )
-					squares [i].run( last_time, end_time );
-				else
-					noise.run( last_time, end_time );
-			}
+			if ( i < 3 )
+				squares [i].run( last_time, end_time );
+			else
+				noise.run( last_time, end_time );
 		}
 
 		last_time = end_time;
@@ -329,3 +376,46 @@ void Sms_Apu::write_data( blip_time_t time, int data )
 		noise.shifter = 0x8000;
 	}
 }
+
+void Sms_Apu::copy_state( State_Copier& copier )
+{
+	for ( int i = 0; i < osc_count; i++ )
+	{
+		Sms_Osc& osc = *oscs [i];
+		copier.copy_int( osc.output_select );
+		if ( (unsigned) osc.output_select > 3 )
+		{
+			copier.set_error( ERR_STATE_INVALID );
+			osc.output_select = 0;
+		}
+		osc.output = osc.outputs [osc.output_select];
+		copier.copy_int( osc.delay );
+		copier.copy_int( osc.last_amp );
+		copier.copy_int( osc.volume );
+	}
+
+	for ( int i = 0; i < 3; i++ )
+	{
+		copier.copy_int( squares [i].period );
+		copier.copy_int( squares [i].phase );
+	}
+
+	// noise period points to one of the fixed periods or square 3's period
+	int period = 3;
+	if ( noise.period != &squares [2].period )
+		period = int (noise.period - noise_periods);
+	copier.copy_int( period );
+	if ( (unsigned) period > 3 )
+	{
+		copier.set_error( ERR_STATE_INVALID );
+		period = 0;
+	}
+	noise.period = (period < 3 ? &noise_periods [period] : &squares [2].period);
+	copier.copy_int( noise.shifter );
+	copier.copy_int( noise.feedback );
+
+	copier.copy_int( last_time );
+	copier.copy_int( latch );
+	copier.copy_int( noise_feedback );
+	copier.copy_int( looped_feedback );
+}
@@ -6,6 +6,8 @@
 
 #include "Sms_Oscs.h"
 
+class State_Copier;
+
 class Sms_Apu {
 public:
 	// Set overall volume of all oscillators, where 1.0 is full volume
@@ -42,6 +44,9 @@ public:
 	// start a new frame at time 0.
 	void end_frame( blip_time_t );
 
+	// Save/load emulation state between frames, using a portable format
+	void copy_state( State_Copier& );
+
 public:
 	Sms_Apu();
 	~Sms_Apu();
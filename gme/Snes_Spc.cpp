@@ -4,6 +4,7 @@
 
 #include "Snes_Spc.h"
 
+#include "State_Copier.h"
 #include <cstring>
 
 /* Copyright (C) 2004-2007 Shay Green. This module is free software; you
@@ -262,13 +263,66 @@ void Snes_Spc::clear_echo()
 }
 
 
+//// State
+
+void Snes_Spc::copy_state( State_Copier& copier )
+{
+	for ( int i = 0; i < timer_count; i++ )
+	{
+		Timer& t = m.timers [i];
+		copier.copy_int( t.next_time );
+		copier.copy_int( t.period );
+		copier.copy_int( t.divider );
+		copier.copy_int( t.enabled );
+		copier.copy_int( t.counter );
+	}
+	copier.copy( m.smp_regs, sizeof m.smp_regs );
+
+	copier.copy_int( m.cpu_regs.pc );
+	copier.copy_int( m.cpu_regs.a );
+	copier.copy_int( m.cpu_regs.x );
+	copier.copy_int( m.cpu_regs.y );
+	copier.copy_int( m.cpu_regs.psw );
+	copier.copy_int( m.cpu_regs.sp );
+
+	copier.copy_int( m.dsp_time );
+	copier.copy_int( m.spc_time );
+	copier.copy_int( m.echo_accessed );
+	copier.copy_int( m.skipped_kon );
+	copier.copy_int( m.skipped_koff );
+	copier.copy_int( m.extra_clocks );
+
+	int extra_count = m.extra_pos - m.extra_buf;
+	copier.copy_int( extra_count );
+	if ( (unsigned) extra_count > extra_size )
+	{
+		copier.set_error( ERR_STATE_INVALID );
+		extra_count = 0;
+	}
+	copier.copy_ints( m.extra_buf, extra_count );
+	m.extra_pos = &m.extra_buf [extra_count];
+
+	copier.copy_int( m.rom_enabled );
+	copier.copy( m.hi_ram, sizeof m.hi_ram );
+	copier.copy( RAM, 0x10000 );
+
+	dsp.copy_state( copier );
+
+	if ( copier.loading() )
+	{
+		m.cpu_error = 0;
+		set_tempo( m.tempo ); // restores timer prescalers
+	}
+}
+
+
 //// Sample output
 
 void Snes_Spc::reset_buf()
 {
 	// Start with half extra buffer of silence
 	sample_t* out = m.extra_buf;
-	while ( out < &m.extra_buf [extra_size / 2] )
+	while ( out < &m.extra_buf [Spc_Dsp::extra_frames / 2 * frame_size()] )
 		*out++ = 0;
 
 	m.extra_pos = out;
@@ -298,7 +352,7 @@ void Snes_Spc::set_output( sample_t* out, int size )
 		{
 			// Have DSP write to remaining extra space
 			out     = dsp.extra();
-			out_end = &dsp.extra() [extra_size];
+			out_end = dsp.extra_end();
 
 			// Copy any remaining extra samples as if DSP wrote them
 			while ( in < m.extra_pos )
@@ -339,11 +393,11 @@ void Snes_Spc::save_extra()
 
 blargg_err_t Snes_Spc::play( int count, sample_t* out )
 {
-	require( (count & 1) == 0 ); // must be even
+	require( count % frame_size() == 0 );
 	if ( count )
 	{
 		set_output( out, count );
-		end_frame( count * (clocks_per_sample / 2) );
+		end_frame( count / frame_size() * clocks_per_sample );
 	}
 
 	blargg_err_t err = m.cpu_error;
@@ -354,14 +408,15 @@ blargg_err_t Snes_Spc::play( int count, sample_t* out )
 blargg_err_t Snes_Spc::skip( int count )
 {
 	#if SPC_LESS_ACCURATE
-	if ( count > 2 * sample_rate * 2 )
+	int const frame = frame_size();
+	if ( count > 2 * sample_rate * frame )
 	{
 		set_output( nullptr, 0 );
 
-		// Skip a multiple of 4 samples
-		time_t end = count;
-		count = (count & 3) + 1 * sample_rate * 2;
-		end = (end - count) * (clocks_per_sample / 2);
+		// Skip a multiple of 2 frames
+		time_t end = count / frame;
+		count = (end & 1) * frame + 1 * sample_rate * frame;
+		end = (end - count / frame) * clocks_per_sample;
 
 		m.skipped_kon  = 0;
 		m.skipped_koff = 0;
@@ -63,6 +63,20 @@ public:
 
 	void disable_echo( bool disable = true );
 
+	// If enabled, output has stereo output of each voice then echo, rather than
+	// mixing them (see Spc_Dsp::enable_stems()). Resets output buffer, so you must
+	// call set_output() after this.
+	enum { stem_count = Spc_Dsp::stem_count };
+	void enable_stems( bool enable = true );
+
+	// Number of samples in output for each sample pair: 2, or stem_count * 2 if
+	// stems are enabled
+	int frame_size() const { return dsp.frame_size(); }
+
+	// Reuses decoded BRR blocks (see Spc_Dsp::enable_brr_cache()). Output is
+	// identical either way.
+	void enable_brr_cache( bool enable = true );
+
 	// Sets tempo, where tempo_unit = normal, tempo_unit / 2 = half speed, etc.
 	static const unsigned int tempo_unit = 0x100;
 	void set_tempo( int );
@@ -78,12 +92,16 @@ public:
 	void clear_echo();
 
 	// Plays for count samples and write samples to out. Discards samples if out
-	// is NULL. Count must be a multiple of 2 since output is stereo.
+	// is NULL. Count must be a multiple of frame_size().
 	blargg_err_t play( int count, sample_t* out );
 
 	// Skips count samples. Several times faster than play() when using fast DSP.
 	blargg_err_t skip( int count );
 
+	// Saves/loads emulation state in a portable format. Unlike copy_state()
+	// below, this is available with the fast DSP.
+	void copy_state( State_Copier& );
+
 // State save/load (only available with accurate DSP)
 
 #if !SPC_NO_COPY_STATE_FUNCS
@@ -258,7 +276,7 @@ private:
 
 #include <cassert>
 
-inline int Snes_Spc::sample_count() const { return (m.extra_clocks >> 5) * 2; }
+inline int Snes_Spc::sample_count() const { return (m.extra_clocks >> 5) * frame_size(); }
 
 inline int Snes_Spc::read_port( time_t t, int port )
 {
@@ -278,6 +296,10 @@ inline void Snes_Spc::disable_surround( bool disable ) { dsp.disable_surround( d
 
 inline void Snes_Spc::disable_echo( bool disable ) { dsp.disable_echo( disable ); }
 
+inline void Snes_Spc::enable_stems( bool enable ) { dsp.enable_stems( enable ); reset_buf(); }
+
+inline void Snes_Spc::enable_brr_cache( bool enable ) { dsp.enable_brr_cache( enable ); }
+
 #if !SPC_NO_COPY_STATE_FUNCS
 inline bool Snes_Spc::check_kon() { return dsp.check_kon(); }
 #endif
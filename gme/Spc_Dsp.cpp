@@ -2,6 +2,7 @@
 
 #include "Spc_Dsp.h"
 
+#include "State_Copier.h"
 #include "blargg_endian.h"
 #include <cstring>
 #include <climits>
@@ -59,28 +60,34 @@ static uint8_t const initial_regs [Spc_Dsp::register_count] =
 // Access voice DSP register
 #define VREG(r,n)   r [v_##n]
 
-#define WRITE_SAMPLES( l, r, out ) \
+// Advances past frame just written to out, continuing in extra once output is full
+#define NEXT_FRAME( out, size ) \
 {\
-	out [0] = l;\
-	out [1] = r;\
-	out += 2;\
+	out += size;\
 	if ( out >= m.out_end )\
 	{\
 		check( out == m.out_end );\
-		check( m.out_end != &m.extra [extra_size] || \
-			(m.extra <= m.out_begin && m.extra < &m.extra [extra_size]) );\
+		check( m.out_end != extra_end() || \
+			(m.extra <= m.out_begin && m.extra < extra_end()) );\
 		out       = m.extra;\
-		m.out_end = &m.extra [extra_size];\
+		m.out_end = extra_end();\
 	}\
 }\
 
+#define WRITE_SAMPLES( l, r, out ) \
+{\
+	out [0] = l;\
+	out [1] = r;\
+	NEXT_FRAME( out, 2 );\
+}\
+
 void Spc_Dsp::set_output( sample_t* out, int size )
 {
 	require( (size & 1) == 0 ); // must be even
 	if ( !out )
 	{
 		out  = m.extra;
-		size = extra_size;
+		size = extra_end() - m.extra;
 	}
 	m.out_begin = out;
 	m.out       = out;
@@ -182,6 +189,108 @@ inline void Spc_Dsp::run_counter( int i )
 	(*m.counter_select [rate] & counter_mask [rate])
 
 
+#if SPC_DSP_SIMD
+
+#include <emmintrin.h>
+
+// FIR coefficients for echo_fir(), each pair of taps twice, for left and right
+static inline __m128i fir_coefs( uint8_t const* regs, int i )
+{
+	int c0 = (int8_t) regs [Spc_Dsp::r_fir + i * 0x10];
+	int c1 = (int8_t) regs [Spc_Dsp::r_fir + i * 0x10 + 0x10];
+	int c2 = (int8_t) regs [Spc_Dsp::r_fir + i * 0x10 + 0x20];
+	int c3 = (int8_t) regs [Spc_Dsp::r_fir + i * 0x10 + 0x30];
+	return _mm_setr_epi16( c0, c1, c0, c1, c2, c3, c2, c3 );
+}
+
+// Four history entries, arranged to match fir_coefs(): l0 l1 r0 r1 l2 l3 r2 r3
+static inline __m128i fir_inputs( __m128i in01, __m128i in23 )
+{
+	__m128i in = _mm_packs_epi32( in01, in23 );
+	in = _mm_shufflelo_epi16( in, _MM_SHUFFLE( 3, 1, 2, 0 ) );
+	return _mm_shufflehi_epi16( in, _MM_SHUFFLE( 3, 1, 2, 0 ) );
+}
+
+// Applies FIR to seven history entries and newest input. History is 16 bits, so
+// madd is exact. Newest was just written to history, so it's passed in rather
+// than read back, which would stall.
+static inline void echo_fir( int const (*hist) [2], int newest_l, int newest_r,
+		__m128i coefs_lo, __m128i coefs_hi, int* l, int* r )
+{
+	__m128i newest = _mm_unpacklo_epi32( _mm_cvtsi32_si128( newest_l ), _mm_cvtsi32_si128( newest_r ) );
+	__m128i lo = fir_inputs( _mm_loadu_si128( (__m128i const*) hist [0] ),
+			_mm_loadu_si128( (__m128i const*) hist [2] ) );
+	__m128i hi = fir_inputs( _mm_loadu_si128( (__m128i const*) hist [4] ),
+			_mm_unpacklo_epi64( _mm_loadl_epi64( (__m128i const*) hist [6] ), newest ) );
+	__m128i sum = _mm_add_epi32( _mm_madd_epi16( lo, coefs_lo ), _mm_madd_epi16( hi, coefs_hi ) );
+	sum = _mm_add_epi32( sum, _mm_shuffle_epi32( sum, _MM_SHUFFLE( 1, 0, 3, 2 ) ) );
+	*l = _mm_cvtsi128_si32( sum );
+	*r = _mm_cvtsi128_si32( _mm_shuffle_epi32( sum, _MM_SHUFFLE( 1, 1, 1, 1 ) ) );
+}
+
+#endif
+
+
+//// BRR cache
+
+// Finds cached block for group of four samples about to be decoded by voice. If
+// group is already in block, returns it for caller to copy samples from. If group
+// is next to be decoded, returns block for caller to add decoded samples to.
+// Otherwise returns NULL.
+Spc_Dsp::brr_block_t* Spc_Dsp::find_brr_block( voice_t& v, int addr, int group,
+		int header, int nybbles )
+{
+	brr_block_t* block = v.brr_block;
+	if ( !group )
+	{
+		// Key on history only if filter uses it
+		int p1 = 0;
+		int p2 = 0;
+		if ( header & 0x0C )
+		{
+			p1 = v.buf_pos [brr_buf_size - 1];
+			p2 = v.buf_pos [brr_buf_size - 2];
+		}
+
+		unsigned hash = (addr * 0x9E3779B1u) ^ ((unsigned) p1 << 16 ^ (uint16_t) p2) * 0x85EBCA6Bu;
+		block = &m.brr_cache [hash >> 16 & (brr_cache_size - 1)];
+		if ( block->addr != addr || block->header != header ||
+				block->hist [0] != p1 || block->hist [1] != p2 )
+		{
+			block->stamp    = ++m.brr_stamp;
+			block->addr     = (uint16_t) addr;
+			block->header   = (uint8_t) header;
+			block->groups   = 0;
+			block->hist [0] = (int16_t) p1;
+			block->hist [1] = (int16_t) p2;
+		}
+		v.brr_block = block;
+		v.brr_stamp = block->stamp;
+	}
+	else if ( !block || block->stamp != v.brr_stamp || block->header != header )
+	{
+		// evicted by another block, or header was modified
+		v.brr_block = nullptr;
+		return nullptr;
+	}
+
+	if ( group < block->groups )
+	{
+		if ( block->nybbles [group] == nybbles )
+			return block;
+	}
+	else if ( group == block->groups )
+	{
+		block->nybbles [group] = (uint16_t) nybbles;
+		return block;
+	}
+
+	// data was modified, so rest of block can't be used either
+	v.brr_block = nullptr;
+	return nullptr;
+}
+
+
 //// Emulation
 
 void Spc_Dsp::run( int clock_count )
@@ -217,6 +326,17 @@ void Spc_Dsp::run( int clock_count )
 	if ( mvoll * mvolr < m.surround_threshold )
 		mvoll = -mvoll; // eliminate surround
 
+	bool const stems = (m.frame_size != 2);
+
+#if SPC_DSP_SIMD
+	__m128i const fir_lo = fir_coefs( m.regs, 0 );
+	__m128i const fir_hi = fir_coefs( m.regs, 4 );
+#endif
+
+	// FIR output can be skipped when it's neither heard nor fed back
+	bool const echo_unused = !evoll && !evolr && (!REG(efb) || (REG(flg) & 0x20));
+	int echo_hist_zeros = m.echo_hist_zeros;
+
 	do
 	{
 		// KON/KOFF reading
@@ -244,6 +364,8 @@ void Spc_Dsp::run( int clock_count )
 		int main_out_r = 0;
 		int echo_out_l = 0;
 		int echo_out_r = 0;
+		sample_t* stem_out = m.out; // stems are written as each voice is run
+
 		voice_t* v = m.voices;
 		uint8_t* v_regs = m.regs;
 		int vbit = 1;
@@ -341,6 +463,17 @@ void Spc_Dsp::run( int clock_count )
 
 				pmon_input = output;
 				VREG(v_regs,outx) = (uint8_t) (output >> 8);
+
+				if ( stems )
+				{
+					int l = (output * v->volume [0] * mvoll) >> 14;
+					int r = (output * v->volume [1] * mvolr) >> 14;
+					CLAMP16( l );
+					CLAMP16( r );
+					stem_out [0] = (sample_t) l;
+					stem_out [1] = (sample_t) r;
+					stem_out += 2;
+				}
 			}
 
 			// Soft reset or end of sample
@@ -476,6 +609,12 @@ void Spc_Dsp::run( int clock_count )
 					int nybbles = ram [(v->brr_addr + v->brr_offset) & 0xFFFF] * 0x100 +
 							ram [(v->brr_addr + v->brr_offset + 1) & 0xFFFF];
 
+					// Cached samples, if block has been decoded before
+					brr_block_t* block = nullptr;
+					int const group = v->brr_offset >> 1;
+					if ( m.brr_cache_enabled )
+						block = find_brr_block( *v, v->brr_addr, group, brr_header, nybbles );
+
 					// Advance read position
 					int const brr_block_size = 9;
 					int brr_offset = v->brr_offset;
@@ -495,57 +634,72 @@ void Spc_Dsp::run( int clock_count )
 					}
 					v->brr_offset = brr_offset;
 
-					// Decode
-
-					// 0: >>1  1: <<0  2: <<1 ... 12: <<11  13-15: >>4 <<11
-					static unsigned char const shifts [16 * 2] = {
-						13,12,12,12,12,12,12,12,12,12,12, 12, 12, 16, 16, 16,
-						 0, 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 11, 11, 11
-					};
-					int const scale = brr_header >> 4;
-					int const right_shift = shifts [scale];
-					int const left_shift  = shifts [scale + 16];
-
 					// Write to next four samples in circular buffer
 					int* pos = v->buf_pos;
 					int* end;
 
-					// Decode four samples
-					for ( end = pos + 4; pos < end; pos++, nybbles <<= 4 )
+					if ( block && group < block->groups )
+					{
+						// Copy four samples
+						int16_t const* in = &block->samples [group * 4];
+						for ( end = pos + 4; pos < end; pos++, in++ )
+							pos [brr_buf_size] = pos [0] = *in;
+					}
+					else
 					{
-						// Extract upper nybble and scale appropriately. Every cast is
-						// necessary to maintain correctness and avoid undef behavior
-						int s = int16_t(uint16_t((int16_t) nybbles >> right_shift) << left_shift);
-
-						// Apply IIR filter (8 is the most commonly used)
-						int const filter = brr_header & 0x0C;
-						int const p1 = pos [brr_buf_size - 1];
-						int const p2 = pos [brr_buf_size - 2] >> 1;
-						if ( filter >= 8 )
+						// 0: >>1  1: <<0  2: <<1 ... 12: <<11  13-15: >>4 <<11
+						static unsigned char const shifts [16 * 2] = {
+							13,12,12,12,12,12,12,12,12,12,12, 12, 12, 16, 16, 16,
+							 0, 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 11, 11, 11
+						};
+						int const scale = brr_header >> 4;
+						int const right_shift = shifts [scale];
+						int const left_shift  = shifts [scale + 16];
+
+						// Decode four samples
+						for ( end = pos + 4; pos < end; pos++, nybbles <<= 4 )
 						{
-							s += p1;
-							s -= p2;
-							if ( filter == 8 ) // s += p1 * 0.953125 - p2 * 0.46875
+							// Extract upper nybble and scale appropriately. Every cast is
+							// necessary to maintain correctness and avoid undef behavior
+							int s = int16_t(uint16_t((int16_t) nybbles >> right_shift) << left_shift);
+
+							// Apply IIR filter (8 is the most commonly used)
+							int const filter = brr_header & 0x0C;
+							int const p1 = pos [brr_buf_size - 1];
+							int const p2 = pos [brr_buf_size - 2] >> 1;
+							if ( filter >= 8 )
 							{
-								s += p2 >> 4;
-								s += (p1 * -3) >> 6;
+								s += p1;
+								s -= p2;
+								if ( filter == 8 ) // s += p1 * 0.953125 - p2 * 0.46875
+								{
+									s += p2 >> 4;
+									s += (p1 * -3) >> 6;
+								}
+								else // s += p1 * 0.8984375 - p2 * 0.40625
+								{
+									s += (p1 * -13) >> 7;
+									s += (p2 * 3) >> 4;
+								}
 							}
-							else // s += p1 * 0.8984375 - p2 * 0.40625
+							else if ( filter ) // s += p1 * 0.46875
 							{
-								s += (p1 * -13) >> 7;
-								s += (p2 * 3) >> 4;
+								s += p1 >> 1;
+								s += (-p1) >> 5;
 							}
+
+							// Adjust and write sample
+							CLAMP16( s );
+							s = (int16_t) (s * 2);
+							pos [brr_buf_size] = pos [0] = s; // second copy simplifies wrap-around
 						}
-						else if ( filter ) // s += p1 * 0.46875
+
+						if ( block )
 						{
-							s += p1 >> 1;
-							s += (-p1) >> 5;
+							for ( int i = 0; i < 4; i++ )
+								block->samples [group * 4 + i] = (int16_t) pos [i - 4];
+							block->groups++;
 						}
-
-						// Adjust and write sample
-						CLAMP16( s );
-						s = (int16_t) (s * 2);
-						pos [brr_buf_size] = pos [0] = s; // second copy simplifies wrap-around
 					}
 
 					if ( pos >= &v->buf [brr_buf_size] )
@@ -554,6 +708,7 @@ void Spc_Dsp::run( int clock_count )
 				}
 			}
 skip_brr:
+
 			// Next voice
 			vbit <<= 1;
 			v_regs += 0x10;
@@ -588,24 +743,43 @@ skip_brr:
 		echo_hist_pos [0] [0] = echo_hist_pos [8] [0] = echo_in_l;
 		echo_hist_pos [0] [1] = echo_hist_pos [8] [1] = echo_in_r;
 
-		#define CALC_FIR_( i, in )  ((in) * (int8_t) REG(fir + i * 0x10))
-		echo_in_l = CALC_FIR_( 7, echo_in_l );
-		echo_in_r = CALC_FIR_( 7, echo_in_r );
-
-		#define CALC_FIR( i, ch )   CALC_FIR_( i, echo_hist_pos [i + 1] [ch] )
-		#define DO_FIR( i )\
-			echo_in_l += CALC_FIR( i, 0 );\
-			echo_in_r += CALC_FIR( i, 1 );
-		DO_FIR( 0 );
-		DO_FIR( 1 );
-		DO_FIR( 2 );
-		#if defined (__MWERKS__) && __MWERKS__ < 0x3200
-			__eieio(); // keeps compiler from stupidly "caching" things in memory
+		// Once all history is silent, so is FIR output
+		if ( echo_in_l | echo_in_r )
+			echo_hist_zeros = 0;
+		else if ( echo_hist_zeros < echo_hist_size )
+			echo_hist_zeros++;
+
+		if ( echo_unused || echo_hist_zeros >= echo_hist_size )
+		{
+			echo_in_l = 0;
+			echo_in_r = 0;
+		}
+		else
+		{
+		#if SPC_DSP_SIMD
+			// oldest is at echo_hist_pos [1] and newest at echo_hist_pos [8]
+			echo_fir( echo_hist_pos + 1, echo_in_l, echo_in_r, fir_lo, fir_hi, &echo_in_l, &echo_in_r );
+		#else
+			#define CALC_FIR_( i, in )  ((in) * (int8_t) REG(fir + i * 0x10))
+			echo_in_l = CALC_FIR_( 7, echo_in_l );
+			echo_in_r = CALC_FIR_( 7, echo_in_r );
+
+			#define CALC_FIR( i, ch )   CALC_FIR_( i, echo_hist_pos [i + 1] [ch] )
+			#define DO_FIR( i )\
+				echo_in_l += CALC_FIR( i, 0 );\
+				echo_in_r += CALC_FIR( i, 1 );
+			DO_FIR( 0 );
+			DO_FIR( 1 );
+			DO_FIR( 2 );
+			#if defined (__MWERKS__) && __MWERKS__ < 0x3200
+				__eieio(); // keeps compiler from stupidly "caching" things in memory
+			#endif
+			DO_FIR( 3 );
+			DO_FIR( 4 );
+			DO_FIR( 5 );
+			DO_FIR( 6 );
 		#endif
-		DO_FIR( 3 );
-		DO_FIR( 4 );
-		DO_FIR( 5 );
-		DO_FIR( 6 );
+		}
 
 		// Echo out
 		if ( !(REG(flg) & 0x20) )
@@ -626,24 +800,46 @@ skip_brr:
 			SET_LE16A( echo_ptr + 2, r );
 		}
 
-		// Sound out
-		int l = (main_out_l * mvoll + echo_in_l * evoll) >> 14;
-		int r = (main_out_r * mvolr + echo_in_r * evolr) >> 14;
+		sample_t* out = m.out;
+		if ( !stems )
+		{
+			// Sound out
+			int l = (main_out_l * mvoll + echo_in_l * evoll) >> 14;
+			int r = (main_out_r * mvolr + echo_in_r * evolr) >> 14;
 
-		CLAMP16( l );
-		CLAMP16( r );
+			CLAMP16( l );
+			CLAMP16( r );
 
-		if ( (REG(flg) & 0x40) )
-		{
-			l = 0;
-			r = 0;
+			if ( (REG(flg) & 0x40) )
+			{
+				l = 0;
+				r = 0;
+			}
+
+			WRITE_SAMPLES( l, r, out );
 		}
+		else
+		{
+			// Echo stem follows voices
+			int l = (echo_in_l * evoll) >> 14;
+			int r = (echo_in_r * evolr) >> 14;
 
-		sample_t* out = m.out;
-		WRITE_SAMPLES( l, r, out );
+			CLAMP16( l );
+			CLAMP16( r );
+
+			stem_out [0] = (sample_t) l;
+			stem_out [1] = (sample_t) r;
+
+			if ( (REG(flg) & 0x40) )
+				memset( out, 0, stem_count * 2 * sizeof *out );
+
+			NEXT_FRAME( out, stem_count * 2 );
+		}
 		m.out = out;
 	}
 	while ( --count );
+
+	m.echo_hist_zeros = echo_hist_zeros;
 }
 
 
@@ -670,6 +866,8 @@ void Spc_Dsp::init( void* ram_64k )
 	mute_voices( 0 );
 	disable_surround( false );
 	disable_echo( false );
+	enable_stems( false );
+	enable_brr_cache();
 	set_output( nullptr, 0 );
 	reset();
 
@@ -728,3 +926,48 @@ void Spc_Dsp::load( uint8_t const regs [register_count] )
 }
 
 void Spc_Dsp::reset() { load( initial_regs ); }
+
+void Spc_Dsp::copy_state( State_Copier& copier )
+{
+	copier.copy( m.regs, sizeof m.regs );
+	#ifdef SPC_ISOLATED_ECHO_BUFFER
+		copier.copy( m.echo_ram, sizeof m.echo_ram );
+	#endif
+
+	copier.copy_ints( &m.echo_hist [0] [0], echo_hist_size * 2 * 2 );
+	int hist_pos = m.echo_hist_pos - m.echo_hist;
+	copier.copy_int( hist_pos );
+	m.echo_hist_pos = &m.echo_hist [hist_pos & (echo_hist_size - 1)];
+	m.echo_hist_zeros = 0;
+
+	copier.copy_int( m.every_other_sample );
+	copier.copy_int( m.kon );
+	copier.copy_int( m.noise );
+	copier.copy_int( m.echo_offset );
+	copier.copy_int( m.echo_length );
+	copier.copy_int( m.phase );
+	copier.copy_ints( m.counters, 4 );
+	copier.copy_int( m.new_kon );
+	copier.copy_int( m.t_koff );
+
+	for ( int i = 0; i < voice_count; i++ )
+	{
+		voice_t& v = m.voices [i];
+		copier.copy_ints( v.buf, brr_buf_size * 2 );
+		int buf_pos = v.buf_pos - v.buf;
+		copier.copy_int( buf_pos );
+		v.buf_pos = &v.buf [(unsigned) buf_pos % brr_buf_size];
+		copier.copy_int( v.interp_pos );
+		copier.copy_int( v.brr_addr );
+		copier.copy_int( v.brr_offset );
+		copier.copy_int( v.kon_delay );
+		copier.copy_int( v.env_mode );
+		copier.copy_int( v.env );
+		copier.copy_int( v.hidden_env );
+		v.brr_block = nullptr;
+
+		// volumes depend on current mute and surround settings
+		if ( copier.loading() )
+			update_voice_vol( i * 0x10 );
+	}
+}
@@ -5,8 +5,17 @@
 #define SPC_DSP_H
 
 #include "blargg_common.h"
+#include "blargg_simd.h"
 #include <cstdint>
 
+class State_Copier;
+
+// Use SSE2 for echo FIR and SPC_Filter. Define to 0 to always use the portable
+// code.
+#ifndef SPC_DSP_SIMD
+	#define SPC_DSP_SIMD BLARGG_SIMD
+#endif
+
 struct Spc_Dsp {
 public:
 	Spc_Dsp();
@@ -21,7 +30,7 @@ public:
 	void set_output( sample_t* out, int out_size );
 
 	// Number of samples written to output since it was last set, always
-	// a multiple of 2. Undefined if more samples were generated than
+	// a multiple of frame_size(). Undefined if more samples were generated than
 	// output buffer could hold.
 	int sample_count() const;
 
@@ -54,12 +63,31 @@ public:
 
 	void disable_echo( bool disable = true );
 
+	// If enabled, writes stereo output of each voice after its envelope and volume,
+	// then of echo, rather than mixing them. Each has main volume applied. Call
+	// set_output() after this.
+	enum { stem_count = voice_count + 1 };
+	void enable_stems( bool enable = true );
+
+	// Number of samples written for each sample pair: 2, or stem_count * 2
+	// if stems are enabled
+	int frame_size() const { return m.frame_size; }
+
+	// If enabled, keeps recently decoded BRR blocks and reuses them when a voice
+	// plays the same block with the same history again, as looped samples do.
+	// Cached samples are checked against RAM as they are used, so output is
+	// identical. Enabled by default.
+	void enable_brr_cache( bool enable = true );
+
 // State
 
 	// Resets DSP and uses supplied values to initialize registers
 	enum { register_count = 128 };
 	void load( uint8_t const regs [register_count] );
 
+	// Saves/loads emulation state in a portable format
+	void copy_state( State_Copier& );
+
 // DSP register addresses
 
 	// Global registers
@@ -85,8 +113,10 @@ public:
 	};
 
 public:
-	enum { extra_size = 16 };
+	enum { extra_frames = 8 };
+	enum { extra_size = extra_frames * stem_count * 2 }; // enough for widest frames
 	sample_t* extra()               { return m.extra; }
+	sample_t* extra_end()           { return &m.extra [extra_frames * m.frame_size]; }
 	sample_t const* out_pos() const { return m.out; }
 public:
 	BLARGG_DISABLE_NOTHROW
@@ -95,6 +125,20 @@ public:
 
 	enum env_mode_t { env_release, env_attack, env_decay, env_sustain };
 	enum { brr_buf_size = 12 };
+
+	// Decoded BRR block, filled four samples at a time as a voice plays it
+	enum { brr_cache_size = 512 }; // power of 2
+	struct brr_block_t
+	{
+		unsigned stamp;         // changed whenever block is reused for another key
+		uint16_t addr;          // address of BRR block
+		uint8_t header;
+		uint8_t groups;         // number of four-sample groups decoded so far
+		int16_t hist [2];       // preceding two samples, or zero if filter doesn't use them
+		uint16_t nybbles [4];   // data of each group, in 0xABCD order
+		int16_t samples [16];
+	};
+
 	struct voice_t
 	{
 		int buf [brr_buf_size*2];// decoded samples (twice the size to simplify wrap handling)
@@ -108,6 +152,8 @@ public:
 		int hidden_env;         // used by GAIN mode 7, very obscure quirk
 		int volume [2];         // copy of volume from DSP registers, with surround disabled
 		int enabled;            // -1 if enabled, 0 if muted
+		brr_block_t* brr_block; // cached block being played, or NULL
+		unsigned brr_stamp;     // stamp of brr_block when voice started on it
 	};
 private:
 	struct state_t
@@ -122,6 +168,7 @@ private:
 		// Echo history keeps most recent 8 samples (twice the size to simplify wrap handling)
 		int echo_hist [echo_hist_size * 2] [2];
 		int (*echo_hist_pos) [2]; // &echo_hist [0 to 7]
+		int echo_hist_zeros;      // number of most recent echo inputs that were silent
 
 		int every_other_sample; // toggles every sample
 		int kon;                // KON value when last checked
@@ -143,10 +190,14 @@ private:
 		int mute_mask;
 		int surround_threshold;
 		int echo_enable;
+		int frame_size;
+		int brr_cache_enabled;
+		unsigned brr_stamp;
 		sample_t* out;
 		sample_t* out_end;
 		sample_t* out_begin;
 		sample_t extra [extra_size];
+		brr_block_t brr_cache [brr_cache_size];
 	};
 	state_t m;
 
@@ -155,6 +206,7 @@ private:
 	void soft_reset_common();
 	void write_outline( int addr, int data );
 	void update_voice_vol( int addr );
+	brr_block_t* find_brr_block( voice_t&, int addr, int group, int header, int nybbles );
 };
 
 #include <cassert>
@@ -215,6 +267,16 @@ inline void Spc_Dsp::disable_echo( bool disable )
 	m.echo_enable = !disable;
 }
 
+inline void Spc_Dsp::enable_stems( bool enable )
+{
+	m.frame_size = enable ? stem_count * 2 : 2;
+}
+
+inline void Spc_Dsp::enable_brr_cache( bool enable )
+{
+	m.brr_cache_enabled = enable;
+}
+
 #define SPC_NO_COPY_STATE_FUNCS 1
 
 #define SPC_LESS_ACCURATE 1
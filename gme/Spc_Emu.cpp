@@ -261,22 +261,39 @@ extern gme_type_t const gme_spc_type = &gme_spc_type_;
 
 // Setup
 
+blargg_err_t Spc_Emu::set_multi_channel( bool is_enabled )
+{
+	return set_multi_channel_( is_enabled, Snes_Spc::stem_count );
+}
+
 blargg_err_t Spc_Emu::set_sample_rate_( long sample_rate )
 {
 	RETURN_ERR( apu.init() );
+	apu.enable_stems( multi_channel() );
 	enable_accuracy( false );
 	if ( sample_rate != native_sample_rate )
 	{
-		RETURN_ERR( resampler.buffer_size( native_sample_rate / 20 * 2 ) );
+		// stems are resampled together
+		resampler.set_channels( apu.frame_size() );
+		RETURN_ERR( resampler.buffer_size( native_sample_rate / 20 * apu.frame_size() ) );
 		resampler.time_ratio( (double) native_sample_rate / sample_rate, 0.9965 );
 	}
 	return 0;
 }
 
+blargg_err_t Spc_Emu::set_resampler_quality_( int quality )
+{
+	resampler.set_quality( quality );
+	if ( sample_rate() && sample_rate() != native_sample_rate )
+		resampler.time_ratio( (double) native_sample_rate / sample_rate(), 0.9965 );
+	return 0;
+}
+
 void Spc_Emu::enable_accuracy_( bool b )
 {
 	Music_Emu::enable_accuracy_( b );
-	filter.enable( b );
+	for ( int i = 0; i < Snes_Spc::stem_count; i++ )
+		filters [i].enable( b );
 }
 
 void Spc_Emu::mute_voices_( int m )
@@ -312,9 +329,12 @@ blargg_err_t Spc_Emu::start_track_( int track )
 {
 	RETURN_ERR( Music_Emu::start_track_( track ) );
 	resampler.clear();
-	filter.clear();
+	for ( int i = 0; i < Snes_Spc::stem_count; i++ )
+	{
+		filters [i].clear();
+		filters [i].set_gain( (int) (gain() * SPC_Filter::gain_unit) );
+	}
 	RETURN_ERR( apu.load_spc( file_data, file_size ) );
-	filter.set_gain( (int) (gain() * SPC_Filter::gain_unit) );
 	apu.clear_echo();
 	track_info_t spc_info;
 	RETURN_ERR( track_info_( &spc_info, track ) );
@@ -325,18 +345,30 @@ blargg_err_t Spc_Emu::start_track_( int track )
 	return 0;
 }
 
+void Spc_Emu::copy_state_( State_Copier& copier )
+{
+	apu.copy_state( copier );
+	for ( int i = 0; i < filter_count(); i++ )
+		filters [i].copy_state( copier );
+	if ( sample_rate() != native_sample_rate )
+		resampler.copy_state( copier );
+}
+
 blargg_err_t Spc_Emu::play_and_filter( long count, sample_t out [] )
 {
 	RETURN_ERR( apu.play( count, out ) );
-	filter.run( out, count );
+	int const frame = apu.frame_size();
+	for ( int i = 0; i < filter_count(); i++ )
+		filters [i].run( out + i * 2, count, frame );
 	return 0;
 }
 
 blargg_err_t Spc_Emu::skip_( long count )
 {
+	int const frame = apu.frame_size();
 	if ( sample_rate() != native_sample_rate )
 	{
-		count = long (count * resampler.ratio()) & ~1;
+		count = long (count * resampler.ratio()) / frame * frame;
 		count -= resampler.skip_input( count );
 	}
 
@@ -345,13 +377,14 @@ blargg_err_t Spc_Emu::skip_( long count )
 	if ( count > 0 )
 	{
 		RETURN_ERR( apu.skip( count ) );
-		filter.clear();
+		for ( int i = 0; i < filter_count(); i++ )
+			filters [i].clear();
 	}
 
 	// eliminate pop due to resampler
 	const int resampler_latency = 64;
-	sample_t buf [resampler_latency];
-	return play_( resampler_latency, buf );
+	sample_t buf [resampler_latency / 2 * Snes_Spc::stem_count * 2];
+	return play_( resampler_latency / 2 * frame, buf );
 }
 
 blargg_err_t Spc_Emu::play_( long count, sample_t* out )
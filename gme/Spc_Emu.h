@@ -44,8 +44,16 @@ public:
 	// Prevents channels and global volumes from being phase-negated
 	void disable_surround( bool disable = true );
 
+	// Reuses decoded sample blocks when looped samples play them again. Output is
+	// identical. Enabled by default; disable to compare against plain decoding.
+	void enable_brr_cache( bool enable = true );
+
 	static gme_type_t static_type() { return gme_spc_type; }
 
+	// In multichannel mode, output has stereo output of each voice after its
+	// envelope and volume, then echo, for nine stereo channels in all
+	blargg_err_t set_multi_channel( bool is_enabled ) override;
+
 public:
 	// deprecated
 	using Music_Emu::load;
@@ -68,16 +76,21 @@ protected:
 	void disable_echo_( bool disable );
 	void set_tempo_( double );
 	void enable_accuracy_( bool );
+	blargg_err_t set_resampler_quality_( int );
+	void copy_state_( State_Copier& );
 private:
 	byte const* file_data;
 	long        file_size;
 	Fir_Resampler<24> resampler;
-	SPC_Filter filter;
+	SPC_Filter filters [Snes_Spc::stem_count]; // one for each stereo pair of output
 	Snes_Spc apu;
 
+	int filter_count() const { return apu.frame_size() / 2; }
 	blargg_err_t play_and_filter( long count, sample_t out [] );
 };
 
 inline void Spc_Emu::disable_surround( bool b ) { apu.disable_surround( b ); }
 
+inline void Spc_Emu::enable_brr_cache( bool b ) { apu.enable_brr_cache( b ); }
+
 #endif
@@ -2,8 +2,14 @@
 
 #include "Spc_Filter.h"
 
+#include "Spc_Dsp.h"
+#include "State_Copier.h"
 #include <cstring>
 
+#if SPC_DSP_SIMD
+	#include <emmintrin.h>
+#endif
+
 /* Copyright (C) 2007 Shay Green. This module is free software; you
 can redistribute it and/or modify it under the terms of the GNU Lesser
 General Public License as published by the Free Software Foundation; either
@@ -19,6 +25,16 @@ Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA */
 
 void SPC_Filter::clear() { memset( ch, 0, sizeof ch ); }
 
+void SPC_Filter::copy_state( State_Copier& copier )
+{
+	for ( int i = 0; i < 2; i++ )
+	{
+		copier.copy_int( ch [i].p1 );
+		copier.copy_int( ch [i].pp1 );
+		copier.copy_int( ch [i].sum );
+	}
+}
+
 SPC_Filter::SPC_Filter()
 {
 	enabled = true;
@@ -27,14 +43,54 @@ SPC_Filter::SPC_Filter()
 	clear();
 }
 
-void SPC_Filter::run( short* io, int count )
+void SPC_Filter::run( short* io, int count, int stride )
 {
-	require( (count & 1) == 0 ); // must be even
+	require( count % stride == 0 && (stride & 1) == 0 ); // must be even
 
 	int const gain = this->gain;
 	if ( enabled )
 	{
 		int const bass = this->bass;
+	#if SPC_DSP_SIMD
+		// Filters left and right together, in lanes 0 and 2 so that mul_epu32
+		// can multiply both. Same operations as below, so output is identical.
+		__m128i p1  = _mm_setr_epi32( ch [0].p1,  0, ch [1].p1,  0 );
+		__m128i pp1 = _mm_setr_epi32( ch [0].pp1, 0, ch [1].pp1, 0 );
+		__m128i sum = _mm_setr_epi32( ch [0].sum, 0, ch [1].sum, 0 );
+		__m128i const gain_x = _mm_set1_epi32( gain );
+		__m128i const bass_shift = _mm_cvtsi32_si128( bass );
+		for ( int i = 0; i < count; i += stride )
+		{
+			int32_t pair;
+			memcpy( &pair, &io [i], sizeof pair );
+			__m128i in = _mm_cvtsi32_si128( pair );
+			in = _mm_srai_epi32( _mm_unpacklo_epi16( in, in ), 16 );
+			in = _mm_shuffle_epi32( in, _MM_SHUFFLE( 1, 1, 0, 0 ) );
+
+			// Low-pass filter (two point FIR with coeffs 0.25, 0.75)
+			__m128i f = _mm_add_epi32( in, p1 );
+			p1 = _mm_add_epi32( in, _mm_add_epi32( in, in ) );
+
+			// High-pass filter ("leaky integrator")
+			__m128i delta = _mm_sub_epi32( f, pp1 );
+			pp1 = f;
+			__m128i s = _mm_srai_epi32( sum, gain_bits + 2 );
+			sum = _mm_add_epi32( sum, _mm_sub_epi32( _mm_mul_epu32( delta, gain_x ),
+					_mm_sra_epi32( sum, bass_shift ) ) );
+
+			// Clamp to 16 bits
+			s = _mm_shuffle_epi32( s, _MM_SHUFFLE( 2, 2, 2, 0 ) );
+			pair = _mm_cvtsi128_si32( _mm_packs_epi32( s, s ) );
+			memcpy( &io [i], &pair, sizeof pair );
+		}
+
+		ch [0].p1  = _mm_cvtsi128_si32( p1 );
+		ch [0].pp1 = _mm_cvtsi128_si32( pp1 );
+		ch [0].sum = _mm_cvtsi128_si32( sum );
+		ch [1].p1  = _mm_cvtsi128_si32( _mm_shuffle_epi32( p1,  _MM_SHUFFLE( 2, 2, 2, 2 ) ) );
+		ch [1].pp1 = _mm_cvtsi128_si32( _mm_shuffle_epi32( pp1, _MM_SHUFFLE( 2, 2, 2, 2 ) ) );
+		ch [1].sum = _mm_cvtsi128_si32( _mm_shuffle_epi32( sum, _MM_SHUFFLE( 2, 2, 2, 2 ) ) );
+	#else
 		chan_t* c = &ch [2];
 		do
 		{
@@ -43,7 +99,7 @@ void SPC_Filter::run( short* io, int count )
 			int pp1 = c->pp1;
 			int p1  = c->p1;
 
-			for ( int i = 0; i < count; i += 2 )
+			for ( int i = 0; i < count; i += stride )
 			{
 				// Low-pass filter (two point FIR with coeffs 0.25, 0.75)
 				int f = io [i] + p1;
@@ -68,16 +124,20 @@ void SPC_Filter::run( short* io, int count )
 			++io;
 		}
 		while ( c != ch );
+	#endif
 	}
 	else if ( gain != gain_unit )
 	{
 		short* const end = io + count;
-		while ( io < end )
+		for ( ; io < end; io += stride )
 		{
-			int s = (*io * gain) >> gain_bits;
-			if ( (short) s != s )
-				s = (s >> 31) ^ 0x7FFF;
-			*io++ = (short) s;
+			for ( int i = 0; i < 2; i++ )
+			{
+				int s = (io [i] * gain) >> gain_bits;
+				if ( (short) s != s )
+					s = (s >> 31) ^ 0x7FFF;
+				io [i] = (short) s;
+			}
 		}
 	}
 }
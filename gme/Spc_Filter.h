@@ -6,18 +6,25 @@
 
 #include "blargg_common.h"
 
+class State_Copier;
+
 struct SPC_Filter {
 public:
 
 	// Filters count samples of stereo sound in place. Count must be a multiple of 2.
+	// With a larger stride, filters the pair at the start of every 'stride' samples,
+	// for sound with more channels.
 	typedef short sample_t;
-	void run( sample_t* io, int count );
+	void run( sample_t* io, int count, int stride = 2 );
 
 // Optional features
 
 	// Clears filter to silence
 	void clear();
 
+	// Saves/loads filter history
+	void copy_state( State_Copier& );
+
 	// Sets gain (volume), where gain_unit is normal. Gains greater than gain_unit
 	// are fine, since output is clamped to 16-bit sample range.
 	static const unsigned int gain_unit = 0x100;
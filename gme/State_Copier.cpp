@@ -0,0 +1,113 @@
+// Game_Music_Emu https://bitbucket.org/mpyne/game-music-emu/
+
+#include "State_Copier.h"
+
+#include <cstring>
+
+/* Copyright (C) 2026 Game_Music_Emu contributors. This module is free
+software; you can redistribute it and/or modify it under the terms of the GNU
+Lesser General Public License as published by the Free Software Foundation;
+either version 2.1 of the License, or (at your option) any later version. This
+module is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+PARTICULAR PURPOSE. See the GNU Lesser General Public License for more details.
+You should have received a copy of the GNU Lesser General Public License along
+with this module; if not, write to the Free Software Foundation, Inc., 51
+Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA */
+
+#include "blargg_source.h"
+
+State_Copier::State_Copier()
+{
+	mode   = size_mode;
+	buf    = nullptr;
+	size   = 0;
+	pos_   = 0;
+	error_ = 0;
+}
+
+void State_Copier::begin_save( void* out, long s )
+{
+	mode   = save_mode;
+	buf    = (unsigned char*) out;
+	size   = s;
+	pos_   = 0;
+	error_ = 0;
+}
+
+void State_Copier::begin_load( void const* in, long s )
+{
+	mode   = load_mode;
+	buf    = (unsigned char*) in; // never written to when loading
+	size   = s;
+	pos_   = 0;
+	error_ = 0;
+}
+
+// Pointer to next count bytes, or NULL if measuring or out of room
+unsigned char* State_Copier::advance( long count )
+{
+	long old_pos = pos_;
+	pos_ += count;
+	if ( mode == size_mode )
+		return nullptr;
+
+	if ( pos_ > size )
+	{
+		pos_ = size;
+		set_error( ERR_STATE_INVALID );
+		return nullptr;
+	}
+	return buf + old_pos;
+}
+
+void State_Copier::copy( void* p, long count )
+{
+	unsigned char* io = advance( count );
+	if ( io )
+	{
+		if ( mode == load_mode )
+			memcpy( p, io, count );
+		else
+			memcpy( io, p, count );
+	}
+	else if ( mode == load_mode )
+	{
+		memset( p, 0, count );
+	}
+}
+
+uint32_t State_Copier::copy_int_( uint32_t n, int count )
+{
+	unsigned char* io = advance( count );
+	if ( !io )
+		return (mode == load_mode) ? 0 : n;
+
+	if ( mode == load_mode )
+	{
+		n = 0;
+		for ( int i = count; i--; )
+			n = n << 8 | io [i];
+	}
+	else
+	{
+		for ( int i = 0; i < count; i++ )
+			io [i] = (unsigned char) (n >> (i * 8));
+	}
+	return n;
+}
+
+uint64_t State_Copier::copy_int64_( uint64_t n )
+{
+	uint32_t lo = copy_int_( (uint32_t) n, 4 );
+	uint32_t hi = copy_int_( (uint32_t) (n >> 32), 4 );
+	return (uint64_t) hi << 32 | lo;
+}
+
+void State_Copier::verify( long n )
+{
+	long stored = n;
+	copy_int( stored );
+	if ( stored != n )
+		set_error( ERR_STATE_INVALID );
+}
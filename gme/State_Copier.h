@@ -0,0 +1,101 @@
+// Saves and restores emulator state in a portable format
+
+// Game_Music_Emu https://bitbucket.org/mpyne/game-music-emu/
+#ifndef STATE_COPIER_H
+#define STATE_COPIER_H
+
+#include "blargg_common.h"
+
+// Walks emulator state in a fixed order, either measuring, saving or loading
+// it, so a single copy_state() function handles all three. Integers are
+// stored little-endian and pointers must be converted to offsets by the caller.
+class State_Copier {
+public:
+	// Initially measures size of state without storing anything
+	State_Copier();
+
+	// Saves state to out, which must have room for size bytes
+	void begin_save( void* out, long size );
+
+	// Loads state from in
+	void begin_load( void const* in, long size );
+
+	bool loading() const        { return mode == load_mode; }
+	bool saving() const         { return mode == save_mode; }
+
+	// Copies size bytes of raw data (for byte arrays only)
+	void copy( void* p, long size );
+
+	// Copies integer, bool or enum value
+	template<class T>
+	void copy_int( T& );
+
+	// Copies array of integers
+	template<class T>
+	void copy_ints( T* p, long count );
+
+	// Stores n when saving. When loading, fails if stored value doesn't equal n.
+	// Used for values which affect layout of following data.
+	void verify( long n );
+
+	// Causes load to fail with err
+	void set_error( blargg_err_t err )  { if ( !error_ ) error_ = err; }
+
+	// Number of bytes measured, saved or loaded so far
+	long pos() const            { return pos_; }
+
+	// Error from saving or loading. Saving fails if output is too small,
+	// loading fails if data was truncated or didn't match.
+	blargg_err_t error() const  { return error_; }
+
+private:
+	enum mode_t { size_mode, save_mode, load_mode };
+	mode_t mode;
+	unsigned char* buf;
+	long size;
+	long pos_;
+	blargg_err_t error_;
+
+	unsigned char* advance( long count );
+	uint32_t copy_int_( uint32_t n, int size );
+	uint64_t copy_int64_( uint64_t n );
+};
+
+// Integers are stored in as many bytes as the type needs, except that long is
+// always stored in 8 bytes since its size differs between platforms.
+
+template<class T>
+inline void State_Copier::copy_int( T& t )
+{
+	if ( sizeof t > 4 )
+		t = (T) copy_int64_( (uint64_t) t );
+	else
+		t = (T) copy_int_( (uint32_t) t, sizeof t );
+}
+
+template<>
+inline void State_Copier::copy_int( long& t )
+{
+	t = (long) (int64_t) copy_int64_( (uint64_t) (int64_t) t );
+}
+
+template<>
+inline void State_Copier::copy_int( unsigned long& t )
+{
+	t = (unsigned long) copy_int64_( t );
+}
+
+template<>
+inline void State_Copier::copy_int( bool& t )
+{
+	t = copy_int_( t, 1 ) != 0;
+}
+
+template<class T>
+inline void State_Copier::copy_ints( T* p, long count )
+{
+	for ( long i = 0; i < count; i++ )
+		copy_int( p [i] );
+}
+
+#endif
@@ -2,6 +2,7 @@
 
 #include "Vgm_Emu.h"
 
+#include "State_Copier.h"
 #include "blargg_endian.h"
 #include <cstring>
 #include <cmath>
@@ -32,6 +33,7 @@ Vgm_Emu::Vgm_Emu()
 	psg_dual = false;
 	psg_t6w28 = false;
 	psg_rate   = 0;
+	uses_fm    = false;
 	set_type( gme_vgm_type );
 
 	static int const types [8] = {
@@ -46,6 +48,12 @@ Vgm_Emu::Vgm_Emu()
 
 Vgm_Emu::~Vgm_Emu() { }
 
+void Vgm_Emu::unload()
+{
+	events.clear();
+	Classic_Emu::unload();
+}
+
 // Track info
 
 static byte const* skip_gd3_str( byte const* in, byte const* end )
@@ -233,6 +241,28 @@ void Vgm_Emu::set_tempo_( double t )
 	}
 }
 
+void Vgm_Emu::set_synthesis_quality_( int quality )
+{
+	Classic_Emu::set_synthesis_quality_( quality );
+	blip_buf.fast_synthesis( quality == gme_synthesis_fast );
+}
+
+blargg_err_t Vgm_Emu::set_resampler_quality_( int quality )
+{
+	Dual_Resampler::set_quality( quality );
+	if ( !uses_fm )
+		return 0;
+
+	Dual_Resampler::setup( fm_rate / blip_buf.sample_rate(), rolloff, fm_gain * gain() );
+	return Dual_Resampler::reset( blip_buf.length() * blip_buf.sample_rate() / 1000 );
+}
+
+blargg_err_t Vgm_Emu::set_ym2612_emu_( int emu )
+{
+	RETURN_ERR( ym2612[0].set_emu( emu ) );
+	return ym2612[1].set_emu( emu );
+}
+
 blargg_err_t Vgm_Emu::set_sample_rate_( long sample_rate )
 {
 	RETURN_ERR( blip_buf.set_sample_rate( sample_rate, 1000 / 30 ) );
@@ -348,6 +378,8 @@ blargg_err_t Vgm_Emu::load_mem_( byte const* new_data, long new_size )
 	psg_rate &= 0x0FFFFFFF;
 	blip_buf.clock_rate( psg_rate );
 
+	// start_track() reloads the same data, so events only need compiling once
+	bool compiled = events.size() && data == new_data && data_end == new_data + new_size;
 	data     = new_data;
 	data_end = new_data + new_size;
 
@@ -356,6 +388,18 @@ blargg_err_t Vgm_Emu::load_mem_( byte const* new_data, long new_size )
 	if ( get_le32( h.loop_offset ) )
 		loop_begin = &data [get_le32( h.loop_offset ) + offsetof (header_t,loop_offset)];
 
+	// decode command stream
+	byte const* begin = data + header_size;
+	if ( get_le32( h.version ) >= 0x150 )
+	{
+		long data_offset = get_le32( h.data_offset );
+		check( data_offset );
+		if ( data_offset )
+			begin += data_offset + offsetof (header_t,data_offset) - 0x40;
+	}
+	if ( !compiled )
+		RETURN_ERR( compile_commands( begin ) );
+
 	set_voice_count( psg[0].osc_count );
 
 	RETURN_ERR( setup_fm() );
@@ -453,18 +497,11 @@ blargg_err_t Vgm_Emu::start_track_( int track )
 		psg[1].reset( get_le16( header().noise_feedback ), header().noise_width );
 
 	dac_disabled = -1;
-	pos          = data + header_size;
-	pcm_data     = pos;
-	pcm_pos      = pos;
+	event_pos    = 0;
+	event_base   = 0;
+	pcm_data     = data + header_size;
+	pcm_pos      = pcm_data;
 	dac_amp      = -1;
-	vgm_time     = 0;
-	if ( get_le32( header().version ) >= 0x150 )
-	{
-		long data_offset = get_le32( header().data_offset );
-		check( data_offset );
-		if ( data_offset )
-			pos += data_offset + offsetof (header_t,data_offset) - 0x40;
-	}
 
 	if ( uses_fm )
 	{
@@ -487,6 +524,58 @@ blargg_err_t Vgm_Emu::start_track_( int track )
 	return 0;
 }
 
+void Vgm_Emu::copy_state_( State_Copier& copier )
+{
+	if ( ym2413[0].enabled() )
+	{
+		copier.set_error( ERR_STATE_NOT_SUPPORTED );
+		return;
+	}
+
+	if ( !uses_fm )
+		copy_buffer_state( copier );
+
+	copier.copy_int( event_pos );
+	if ( (unsigned) event_pos >= events.size() )
+	{
+		copier.set_error( ERR_STATE_INVALID );
+		event_pos = 0;
+	}
+
+	// PCM positions are stored as offsets into data
+	long size = data_end - data;
+	long offsets [2] = { pcm_data - data, pcm_pos - data };
+	copier.copy_ints( offsets, 2 );
+	for ( int i = 0; i < 2; i++ )
+	{
+		if ( (unsigned long) offsets [i] > (unsigned long) size )
+		{
+			copier.set_error( ERR_STATE_INVALID );
+			offsets [i] = size;
+		}
+	}
+	pcm_data = data + offsets [0];
+	pcm_pos  = data + offsets [1];
+
+	copier.copy_int( event_base );
+	copier.copy_int( dac_amp );
+	copier.copy_int( dac_disabled );
+	copier.copy_int( fm_time_offset );
+
+	psg[0].copy_state( copier );
+	if ( psg_dual )
+		psg[1].copy_state( copier );
+
+	if ( uses_fm )
+	{
+		ym2612[0].copy_state( copier );
+		if ( ym2612[1].enabled() )
+			ym2612[1].copy_state( copier );
+		blip_buf.copy_state( copier );
+		Dual_Resampler::copy_state( copier );
+	}
+}
+
 blargg_err_t Vgm_Emu::run_clocks( blip_time_t& time_io, int msec )
 {
 	time_io = run_commands( msec * vgm_rate / 1000 );
@@ -504,3 +593,22 @@ blargg_err_t Vgm_Emu::play_( long count, sample_t* out )
 	Dual_Resampler::dual_play( count, out, blip_buf );
 	return 0;
 }
+
+blargg_err_t Vgm_Emu::play_float_( long count, float* out )
+{
+	if ( !uses_fm )
+		return Classic_Emu::play_float_( count, out );
+
+	return Music_Emu::play_float_( count, out );
+}
+
+blargg_err_t Vgm_Emu::fast_forward_( long count )
+{
+	if ( !uses_fm )
+		return Classic_Emu::fast_forward_( count );
+
+	// FM chips must still be run and take nearly all the time, so PSG isn't
+	// muted, leaving its buffer exactly as when playing
+	Dual_Resampler::dual_skip( count, blip_buf );
+	return 0;
+}
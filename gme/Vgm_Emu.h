@@ -67,11 +67,18 @@ protected:
 	blargg_err_t set_sample_rate_( long sample_rate ) override;
 	blargg_err_t start_track_( int ) override;
 	blargg_err_t play_( long count, sample_t* ) override;
+	blargg_err_t play_float_( long count, float* ) override;
+	blargg_err_t fast_forward_( long count ) override;
 	blargg_err_t run_clocks( blip_time_t&, int ) override;
 	void set_tempo_( double ) override;
+	void set_synthesis_quality_( int ) override;
+	blargg_err_t set_resampler_quality_( int ) override;
+	blargg_err_t set_ym2612_emu_( int ) override;
+	void copy_state_( State_Copier& ) override;
 	void mute_voices_( int mask ) override;
 	void set_voice( int, Blip_Buffer*, Blip_Buffer*, Blip_Buffer* ) override;
 	void update_eq( blip_eq_t const& ) override;
+	void unload() override;
 private:
 	// removed; use disable_oversampling() and set_tempo() instead
 	Vgm_Emu( bool oversample, double tempo = 1.0 );
@@ -118,161 +118,305 @@ void Vgm_Emu_Impl::write_pcm( vgm_time_t vgm_time, int amp )
 		dac_amp |= dac_disabled;
 }
 
-blip_time_t Vgm_Emu_Impl::run_commands( vgm_time_t end_time )
+// Command compilation
+
+enum {
+	ev_stream_end       = 0x00, // cmd values no VGM command uses
+	ev_unknown          = 0x01
+};
+
+int Vgm_Emu_Impl::compile_segment( byte const* pos, event_t* out, int* loop_index,
+		unsigned* loop_t ) const
 {
-	vgm_time_t vgm_time = this->vgm_time;
-	byte const* pos = this->pos;
-	if ( pos >= data_end )
+	int count = 0;
+	unsigned time = 0;
+	unsigned last_time = 0; // when last command began
+	bool overrun = false;
+
+	#define ADD_EVENT( c, a, d ) do {\
+		if ( out ) {\
+			event_t& e = out [count];\
+			e.time = time; e.cmd = c; e.addr = a; e.data = d; e.overrun = 0;\
+		}\
+		count++;\
+	} while ( 0 )
+
+	// PCM offset goes in time field of following event
+	#define ADD_ARG( n ) do {\
+		if ( out ) {\
+			event_t& e = out [count];\
+			e.time = n; e.cmd = ev_unknown; e.addr = 0; e.data = 0; e.overrun = 0;\
+		}\
+		count++;\
+	} while ( 0 )
+
+	while ( pos < data_end )
 	{
-		set_track_ended();
-		if ( pos > data_end )
-			set_warning( WARN_STREAM_END_EVENT_MISSING );
-	}
+		if ( pos == loop_begin && loop_index )
+		{
+			*loop_index = count;
+			*loop_t     = time;
+		}
 
-	while ( vgm_time < end_time && pos < data_end )
-	{
-		// TODO: be sure there are enough bytes left in stream for particular command
-		// so we don't read past end
-		switch ( *pos++ )
+		last_time = time;
+		int cmd = *pos;
+		int len = 1;
+		switch ( cmd )
 		{
 		case cmd_end:
-			pos = loop_begin; // if not looped, loop_begin == data_end
-			break;
+			ADD_EVENT( cmd, 0, 0 );
+			return count;
 
 		case cmd_delay_735:
-			vgm_time += 735;
+			time += 735;
 			break;
 
 		case cmd_delay_882:
-			vgm_time += 882;
+			time += 882;
 			break;
 
 		case cmd_gg_stereo:
-			psg[0].write_ggstereo( to_blip_time( vgm_time ), *pos++ );
+		case cmd_psg:
+		case cmd_gg_stereo_2:
+		case cmd_psg_2:
+			len = 2;
+			if ( data_end - pos >= len )
+				ADD_EVENT( cmd, 0, pos [1] );
 			break;
 
-		case cmd_psg:
-			psg[0].write_data( to_blip_time( vgm_time ), *pos++ );
+		case cmd_delay:
+			len = 3;
+			if ( data_end - pos >= len )
+				time += pos [2] * 0x100L + pos [1];
 			break;
 
-		case cmd_gg_stereo_2:
-			psg[1].write_ggstereo( to_blip_time( vgm_time ), *pos++ );
+		case cmd_byte_delay:
+			len = 2;
+			if ( data_end - pos >= len )
+				time += pos [1];
 			break;
 
-		case cmd_psg_2:
-			psg[1].write_data( to_blip_time( vgm_time ), *pos++ );
+		case cmd_ym2413:
+		case cmd_ym2413_2:
+		case cmd_ym2612_port0:
+		case cmd_ym2612_port1:
+		case cmd_ym2612_2_port0:
+		case cmd_ym2612_2_port1:
+			len = 3;
+			if ( data_end - pos >= len )
+				ADD_EVENT( cmd, pos [1], pos [2] );
 			break;
 
-		case cmd_delay:
-			vgm_time += pos [1] * 0x100L + pos [0];
-			pos += 2;
+		case cmd_data_block: {
+			len = 7;
+			if ( data_end - pos < len )
+				break;
+			check( pos [1] == cmd_end );
+			unsigned long size = get_le32( pos + 3 );
+			if ( pos [2] == pcm_block_type )
+			{
+				ADD_EVENT( cmd, 0, 0 );
+				ADD_ARG( pos + len - data );
+			}
+			if ( size > (unsigned long) (data_end - pos - len) )
+				len = data_end - pos + 1; // runs past end
+			else
+				len += size;
 			break;
+		}
 
-		case cmd_byte_delay:
-			vgm_time += *pos++;
+		case cmd_pcm_seek:
+			len = 5;
+			if ( data_end - pos >= len )
+			{
+				ADD_EVENT( cmd, 0, 0 );
+				ADD_ARG( get_le32( pos + 1 ) );
+			}
+			break;
+
+		default:
+			switch ( cmd & 0xF0 )
+			{
+				case cmd_pcm_delay:
+					ADD_EVENT( cmd_pcm_delay, 0, 0 );
+					time += cmd & 0x0F;
+					break;
+
+				case cmd_short_delay:
+					time += (cmd & 0x0F) + 1;
+					break;
+
+				case 0x50:
+					len = 3;
+					break;
+
+				default:
+					len = command_len( cmd );
+					ADD_EVENT( ev_unknown, 0, 0 );
+			}
+		}
+
+		if ( data_end - pos < len )
+		{
+			overrun = true;
+			break;
+		}
+		pos += len;
+	}
+
+	// track ends once last command has begun, even if it was a delay
+	if ( pos > data_end )
+		overrun = true;
+	time = last_time;
+	ADD_EVENT( ev_stream_end, 0, 0 );
+	if ( out )
+		out [count - 1].overrun = overrun;
+	return count;
+
+	#undef ADD_EVENT
+	#undef ADD_ARG
+}
+
+blargg_err_t Vgm_Emu_Impl::compile_commands( byte const* begin )
+{
+	// If loop point is on a command in main stream, loop jumps back to its
+	// event, otherwise stream from loop point is compiled after main one
+	int loop_index = -1;
+	unsigned loop_t = 0;
+	int count = compile_segment( begin, nullptr, &loop_index, &loop_t );
+	int loop_count = 0;
+	if ( loop_index < 0 )
+		loop_count = compile_segment( loop_begin, nullptr, nullptr, nullptr );
+
+	RETURN_ERR( events.resize( count + loop_count ) );
+	compile_segment( begin, events.begin(), nullptr, nullptr );
+	loop_event = loop_index;
+	loop_time  = loop_t;
+	if ( loop_index < 0 )
+	{
+		compile_segment( loop_begin, &events [count], nullptr, nullptr );
+		loop_event = count;
+		loop_time  = 0;
+	}
+	return 0;
+}
+
+// Playback
+
+blip_time_t Vgm_Emu_Impl::run_commands( vgm_time_t end_time )
+{
+	event_t const* const events = this->events.begin();
+	int pos = event_pos;
+	unsigned base = event_base;
+	// stream end was reached last frame
+	if ( events [pos].cmd == ev_stream_end && (vgm_time_t) (events [pos].time + base) < 0 )
+	{
+		set_track_ended();
+		if ( events [pos].overrun )
+			set_warning( WARN_STREAM_END_EVENT_MISSING );
+	}
+
+	for ( ;; )
+	{
+		event_t const& e = events [pos];
+		vgm_time_t vgm_time = (vgm_time_t) (e.time + base);
+		if ( vgm_time >= end_time || e.cmd == ev_stream_end )
+			break;
+		pos++;
+
+		switch ( e.cmd )
+		{
+		case cmd_end:
+			base += e.time - loop_time;
+			pos = loop_event;
+			break;
+
+		case cmd_gg_stereo:
+			psg[0].write_ggstereo( to_blip_time( vgm_time ), e.data );
+			break;
+
+		case cmd_psg:
+			psg[0].write_data( to_blip_time( vgm_time ), e.data );
+			break;
+
+		case cmd_gg_stereo_2:
+			psg[1].write_ggstereo( to_blip_time( vgm_time ), e.data );
+			break;
+
+		case cmd_psg_2:
+			psg[1].write_data( to_blip_time( vgm_time ), e.data );
 			break;
 
 		case cmd_ym2413:
 			if ( ym2413[0].run_until( to_fm_time( vgm_time ) ) )
-				ym2413[0].write( pos [0], pos [1] );
-			pos += 2;
+				ym2413[0].write( e.addr, e.data );
 			break;
 
 		case cmd_ym2413_2:
 			if ( ym2413[1].run_until( to_fm_time( vgm_time ) ) )
-				ym2413[1].write( pos [0], pos [1] );
-			pos += 2;
+				ym2413[1].write( e.addr, e.data );
 			break;
 
 		case cmd_ym2612_port0:
-			if ( pos [0] == ym2612_dac_port )
+			if ( e.addr == ym2612_dac_port )
 			{
-				write_pcm( vgm_time, pos [1] );
+				write_pcm( vgm_time, e.data );
 			}
 			else if ( ym2612[0].run_until( to_fm_time( vgm_time ) ) )
 			{
-				if ( pos [0] == 0x2B )
+				if ( e.addr == 0x2B )
 				{
-					dac_disabled = (pos [1] >> 7 & 1) - 1;
+					dac_disabled = (e.data >> 7 & 1) - 1;
 					dac_amp |= dac_disabled;
 				}
-				ym2612[0].write0( pos [0], pos [1] );
+				ym2612[0].write0( e.addr, e.data );
 			}
-			pos += 2;
 			break;
 
 		case cmd_ym2612_port1:
 			if ( ym2612[0].run_until( to_fm_time( vgm_time ) ) )
-				ym2612[0].write1( pos [0], pos [1] );
-			pos += 2;
+				ym2612[0].write1( e.addr, e.data );
 			break;
 
 		case cmd_ym2612_2_port0:
-			if ( pos [0] == ym2612_dac_port )
+			if ( e.addr == ym2612_dac_port )
 			{
-				write_pcm( vgm_time, pos [1] );
+				write_pcm( vgm_time, e.data );
 			}
 			else if ( ym2612[1].run_until( to_fm_time( vgm_time ) ) )
 			{
-				if ( pos [0] == 0x2B )
+				if ( e.addr == 0x2B )
 				{
-					dac_disabled = (pos [1] >> 7 & 1) - 1;
+					dac_disabled = (e.data >> 7 & 1) - 1;
 					dac_amp |= dac_disabled;
 				}
-				ym2612[1].write0( pos [0], pos [1] );
+				ym2612[1].write0( e.addr, e.data );
 			}
-			pos += 2;
 			break;
 
 		case cmd_ym2612_2_port1:
 			if ( ym2612[1].run_until( to_fm_time( vgm_time ) ) )
-				ym2612[1].write1( pos [0], pos [1] );
-			pos += 2;
+				ym2612[1].write1( e.addr, e.data );
 			break;
 
-		case cmd_data_block: {
-			check( *pos == cmd_end );
-			int type = pos [1];
-			long size = get_le32( pos + 2 );
-			pos += 6;
-			if ( type == pcm_block_type )
-				pcm_data = pos;
-			pos += size;
+		case cmd_data_block:
+			pcm_data = data + events [pos++].time;
 			break;
-		}
 
 		case cmd_pcm_seek:
-			pcm_pos = pcm_data + pos [3] * 0x1000000L + pos [2] * 0x10000L +
-					pos [1] * 0x100L + pos [0];
-			pos += 4;
+			pcm_pos = pcm_data + events [pos++].time;
 			break;
 
-		default:
-			int cmd = pos [-1];
-			switch ( cmd & 0xF0 )
-			{
-				case cmd_pcm_delay:
-					write_pcm( vgm_time, *pcm_pos++ );
-					vgm_time += cmd & 0x0F;
-					break;
-
-				case cmd_short_delay:
-					vgm_time += (cmd & 0x0F) + 1;
-					break;
-
-				case 0x50:
-					pos += 2;
-					break;
+		case cmd_pcm_delay:
+			write_pcm( vgm_time, *pcm_pos++ );
+			break;
 
-				default:
-					pos += command_len( cmd ) - 1;
-					set_warning( WARN_STREAM_EVENT_UNKNOWN );
-			}
+		default:
+			set_warning( WARN_STREAM_EVENT_UNKNOWN );
 		}
 	}
-	vgm_time -= end_time;
-	this->pos = pos;
-	this->vgm_time = vgm_time;
+	this->event_pos  = pos;
+	this->event_base = (vgm_time_t) (base - end_time);
 
 	return to_blip_time( end_time );
 }
@@ -47,8 +47,25 @@ protected:
 	byte const* data_end;
 	void update_fm_rates( long* ym2413_rate, long* ym2612_rate ) const;
 
-	vgm_time_t vgm_time;
-	byte const* pos;
+	// Command stream decoded at load, with delays folded into event times. PCM
+	// seeks and data blocks are followed by a second event whose time holds
+	// their 32-bit offset.
+	struct event_t
+	{
+		unsigned time;  // since start of stream, or of loop if it didn't start on a command
+		byte cmd;       // VGM command, or ev_stream_end/ev_unknown
+		byte addr;
+		byte data;
+		byte overrun;   // for ev_stream_end, true if last command ran past end of data
+	};
+	blargg_vector<event_t> events;
+	int loop_event;     // index of event to jump to at end command
+	unsigned loop_time; // event time that loop point corresponds to
+	int compile_segment( byte const* begin, event_t* out, int* loop_index, unsigned* loop_t ) const;
+	blargg_err_t compile_commands( byte const* begin );
+
+	int event_pos;          // index of next event
+	vgm_time_t event_base;  // vgm_time of event time 0, relative to start of frame
 	blip_time_t run_commands( vgm_time_t );
 	int play_frame( blip_time_t blip_time, int sample_count, sample_t* buf );
 
@@ -0,0 +1,189 @@
+// Game_Music_Emu https://bitbucket.org/mpyne/game-music-emu/
+
+#include "Ym2612_Emu.h"
+
+#include "State_Copier.h"
+
+/* Copyright (C) 2026 Game_Music_Emu contributors. This module is free
+software; you can redistribute it and/or modify it under the terms of the GNU
+Lesser General Public License as published by the Free Software Foundation;
+either version 2.1 of the License, or (at your option) any later version. This
+module is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+PARTICULAR PURPOSE. See the GNU Lesser General Public License for more details.
+You should have received a copy of the GNU Lesser General Public License along
+with this module; if not, write to the Free Software Foundation, Inc., 51
+Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA */
+
+#include "blargg_source.h"
+
+#if defined(VGM_YM2612_GENS)
+	int const default_emu = gme_ym2612_gens;
+#elif defined(VGM_YM2612_MAME)
+	int const default_emu = gme_ym2612_mame;
+#else
+	int const default_emu = gme_ym2612_nuked;
+#endif
+
+Ym2612_Emu::Ym2612_Emu()
+{
+	nuked = nullptr;
+	gens  = nullptr;
+	mame  = nullptr;
+	emu_  = default_emu;
+	mute_mask    = 0;
+	sample_rate_ = 0;
+	clock_rate_  = 0;
+}
+
+Ym2612_Emu::~Ym2612_Emu()
+{
+	emu_ = gme_ym2612_default; // matches none, so all are freed
+	free_emus();
+}
+
+void Ym2612_Emu::free_emus()
+{
+	// frees all but the one in use
+	if ( emu_ != gme_ym2612_nuked )
+	{
+		delete nuked;
+		nuked = nullptr;
+	}
+	if ( emu_ != gme_ym2612_gens )
+	{
+		delete gens;
+		gens = nullptr;
+	}
+	if ( emu_ != gme_ym2612_mame )
+	{
+	#ifdef VGM_YM2612_WITH_MAME
+		delete mame;
+	#endif
+		mame = nullptr;
+	}
+}
+
+bool Ym2612_Emu::emu_available( int emu )
+{
+	switch ( emu )
+	{
+	case gme_ym2612_default:
+	case gme_ym2612_nuked:
+	case gme_ym2612_gens:
+	#ifdef VGM_YM2612_WITH_MAME
+	case gme_ym2612_mame:
+	#endif
+		return true;
+	}
+	return false;
+}
+
+blargg_err_t Ym2612_Emu::set_emu( int emu )
+{
+	if ( emu == gme_ym2612_default )
+		emu = default_emu;
+
+	if ( !emu_available( emu ) )
+		return ERR_YM2612_EMU_NOT_SUPPORTED;
+
+	if ( emu == emu_ )
+		return 0;
+
+	int prev = emu_;
+	emu_ = emu;
+	if ( sample_rate_ )
+	{
+		blargg_err_t err = set_rate( sample_rate_, clock_rate_ );
+		if ( err )
+		{
+			emu_ = prev;
+			return err;
+		}
+		reset();
+	}
+	free_emus();
+	return 0;
+}
+
+blargg_err_t Ym2612_Emu::set_rate( double sample_rate, double clock_rate )
+{
+	switch ( emu_ )
+	{
+	case gme_ym2612_gens:
+		if ( !gens )
+		{
+			gens = BLARGG_NEW Ym2612_GENS_Emu;
+			CHECK_ALLOC( gens );
+		}
+		RETURN_ERR( gens->set_rate( sample_rate, clock_rate ) );
+		break;
+
+	#ifdef VGM_YM2612_WITH_MAME
+	case gme_ym2612_mame:
+		if ( !mame )
+		{
+			mame = BLARGG_NEW Ym2612_MAME_Emu;
+			CHECK_ALLOC( mame );
+		}
+		RETURN_ERR( mame->set_rate( sample_rate, clock_rate ) );
+		break;
+	#endif
+
+	default:
+		if ( !nuked )
+		{
+			nuked = BLARGG_NEW Ym2612_Nuked_Emu;
+			CHECK_ALLOC( nuked );
+		}
+		RETURN_ERR( nuked->set_rate( sample_rate, clock_rate ) );
+		break;
+	}
+
+	sample_rate_ = sample_rate;
+	clock_rate_  = clock_rate;
+
+	// some emulators clear muting when their rate is set
+	mute_voices( mute_mask );
+
+	return 0;
+}
+
+void Ym2612_Emu::reset()
+{
+	switch ( emu_ )
+	{
+	case gme_ym2612_gens: if ( gens  ) gens->reset();  break;
+	#ifdef VGM_YM2612_WITH_MAME
+	case gme_ym2612_mame: if ( mame  ) mame->reset();  break;
+	#endif
+	default:              if ( nuked ) nuked->reset(); break;
+	}
+	mute_voices( mute_mask );
+}
+
+void Ym2612_Emu::mute_voices( int mask )
+{
+	mute_mask = mask;
+	switch ( emu_ )
+	{
+	case gme_ym2612_gens: if ( gens  ) gens->mute_voices( mask );  break;
+	#ifdef VGM_YM2612_WITH_MAME
+	case gme_ym2612_mame: if ( mame  ) mame->mute_voices( mask );  break;
+	#endif
+	default:              if ( nuked ) nuked->mute_voices( mask ); break;
+	}
+}
+
+void Ym2612_Emu::copy_state( State_Copier& copier )
+{
+	copier.verify( emu_ ); // state of one emulator can't be loaded into another
+	switch ( emu_ )
+	{
+	case gme_ym2612_gens: if ( gens  ) gens->copy_state( copier );  break;
+	#ifdef VGM_YM2612_WITH_MAME
+	case gme_ym2612_mame: if ( mame  ) mame->copy_state( copier );  break;
+	#endif
+	default:              if ( nuked ) nuked->copy_state( copier ); break;
+	}
+}
@@ -1,32 +1,121 @@
 // YM2612 FM sound chip emulator interface
 
 // Game_Music_Emu https://bitbucket.org/mpyne/game-music-emu/
+#ifndef YM2612_EMU_H
+#define YM2612_EMU_H
 
+// VGM_YM2612_NUKED, VGM_YM2612_MAME or VGM_YM2612_GENS selects the emulator used
+// by default. Nuked and GENS are always available; MAME (GPL v2+ license) only if
+// VGM_YM2612_WITH_MAME or VGM_YM2612_MAME is defined.
 #if !defined(VGM_YM2612_GENS) && !defined(VGM_YM2612_NUKED) && !defined(VGM_YM2612_MAME)
 #define VGM_YM2612_NUKED
 #endif
 
-#ifdef VGM_YM2612_GENS // LGPL v2.1+ license
-# if defined(VGM_YM2612_NUKED) || defined(VGM_YM2612_MAME)
-#   error Only one of VGM_YM2612_GENS, VGM_YM2612_NUKED or VGM_YM2612_MAME can be defined
-# endif
-#include "Ym2612_GENS.h"
-typedef Ym2612_GENS_Emu Ym2612_Emu;
+#if defined(VGM_YM2612_GENS) + defined(VGM_YM2612_NUKED) + defined(VGM_YM2612_MAME) > 1
+#error Only one of VGM_YM2612_GENS, VGM_YM2612_NUKED or VGM_YM2612_MAME can be defined
 #endif
 
-#ifdef VGM_YM2612_NUKED // LGPL v2.1+ license
-# if defined(VGM_YM2612_GENS) || defined(VGM_YM2612_MAME)
-#   error Only one of VGM_YM2612_GENS, VGM_YM2612_NUKED or VGM_YM2612_MAME can be defined
-# endif
-#include "Ym2612_Nuked.h"
-typedef Ym2612_Nuked_Emu Ym2612_Emu;
+#if defined(VGM_YM2612_MAME) && !defined(VGM_YM2612_WITH_MAME)
+#define VGM_YM2612_WITH_MAME
 #endif
 
-#ifdef VGM_YM2612_MAME // GPL v2+ license
-# if defined(VGM_YM2612_GENS) || defined(VGM_YM2612_NUKED)
-#   error Only one of VGM_YM2612_GENS, VGM_YM2612_NUKED or VGM_YM2612_MAME can be defined
-# endif
-#include "Ym2612_MAME.h"
-typedef Ym2612_MAME_Emu Ym2612_Emu;
-#endif
+#include "gme.h"
+#include "Ym2612_Nuked.h" // LGPL v2.1+ license
+#include "Ym2612_GENS.h"  // LGPL v2.1+ license
+#include "Ym2612_MAME.h"  // GPL v2+ license
+
+class Ym2612_Emu {
+public:
+	Ym2612_Emu();
+	~Ym2612_Emu();
+
+	// Set emulator to gme_ym2612_nuked, gme_ym2612_mame, gme_ym2612_gens or
+	// gme_ym2612_default. If rate has been set, switching emulators starts the
+	// new one at the same rate in power-up state. Returns non-zero if error.
+	blargg_err_t set_emu( int );
+
+	// Emulator in use, never gme_ym2612_default
+	int emu() const { return emu_; }
+
+	// True if emulator is built into library
+	static bool emu_available( int );
+
+	// Set output sample rate and chip clock rates, in Hz. Returns non-zero
+	// if error.
+	blargg_err_t set_rate( double sample_rate, double clock_rate );
+
+	// Reset to power-up state
+	void reset();
+
+	// Mute voice n if bit n (1 << n) of mask is set
+	enum { channel_count = 6 };
+	void mute_voices( int mask );
+
+	// Write addr to register 0 then data to register 1
+	void write0( int addr, int data );
+
+	// Write addr to register 2 then data to register 3
+	void write1( int addr, int data );
 
+	// Run and add pair_count samples into current output buffer contents
+	typedef short sample_t;
+	enum { out_chan_count = 2 }; // stereo
+	void run( int pair_count, sample_t* out );
+
+	// Save/load emulation state between calls to run(). Muting isn't part of state.
+	void copy_state( State_Copier& );
+
+private:
+	// Only the emulator in use is allocated, once rate is set
+	Ym2612_Nuked_Emu* nuked;
+	Ym2612_GENS_Emu* gens;
+	Ym2612_MAME_Emu* mame;
+	int emu_;
+	int mute_mask;
+	double sample_rate_;
+	double clock_rate_;
+
+	void free_emus();
+
+	// noncopyable
+	Ym2612_Emu( const Ym2612_Emu& );
+	Ym2612_Emu& operator = ( const Ym2612_Emu& );
+};
+
+inline void Ym2612_Emu::write0( int addr, int data )
+{
+	switch ( emu_ )
+	{
+	case gme_ym2612_gens: gens->write0( addr, data ); break;
+	#ifdef VGM_YM2612_WITH_MAME
+	case gme_ym2612_mame: mame->write0( addr, data ); break;
+	#endif
+	default:              nuked->write0( addr, data ); break;
+	}
+}
+
+inline void Ym2612_Emu::write1( int addr, int data )
+{
+	switch ( emu_ )
+	{
+	case gme_ym2612_gens: gens->write1( addr, data ); break;
+	#ifdef VGM_YM2612_WITH_MAME
+	case gme_ym2612_mame: mame->write1( addr, data ); break;
+	#endif
+	default:              nuked->write1( addr, data ); break;
+	}
+}
+
+inline void Ym2612_Emu::run( int pair_count, sample_t* out )
+{
+	switch ( emu_ )
+	{
+	case gme_ym2612_gens: gens->run( pair_count, out ); break;
+	#ifdef VGM_YM2612_WITH_MAME
+	case gme_ym2612_mame: mame->run( pair_count, out ); break;
+	#endif
+	default:              nuked->run( pair_count, out ); break;
+	}
+}
+
+#endif
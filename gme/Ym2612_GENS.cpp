@@ -2,16 +2,17 @@
 
 // Based on Gens 2.10 ym2612.c
 
-#ifdef VGM_YM2612_GENS
-
 #include "Ym2612_GENS.h"
 
+#include "State_Copier.h"
 #include <cassert>
+#include <cstddef>
 #include <cstdlib>
 #include <cstring>
 #include <climits>
 #include <cstdio>
 #include <cmath>
+#include <mutex>
 
 /* Copyright (C) 2002 Stéphane Dallongeville (gens AT consolemul.com) */
 /* Copyright (C) 2004-2006 Shay Green. This module is free software; you
@@ -112,6 +113,9 @@ struct state_t
 	int TimerBcnt;      // timerB counter = valeur courante du Timer B
 	int Mode;           // Mode actuel des voie 3 et 6 (normal / special)
 	int DAC;            // DAC enabled flag
+	int LFOcnt;         // LFO counter = compteur-frequence pour le LFO
+	int LFOinc;         // LFO step counter = pas d'incrementation du compteur-frequence du LFO
+						// plus le pas est grand, plus la frequence est grande
 	channel_t CHANNEL[Ym2612_GENS_Emu::channel_count];   // Les 6 voies du YM2612
 	int REG[2][0x100];  // Sauvegardes des valeurs de tout les registres, c'est facultatif
 						// cela nous rend le debuggage plus facile
@@ -193,18 +197,11 @@ static inline void set_seg( slot_t& s, int seg )
 	}
 }
 
-struct tables_t
+// Tables that don't depend on rates, built on first use and shared by all chips
+struct fixed_tables_t
 {
 	short SIN_TAB [SIN_LENGHT];                 // SINUS TABLE (offset into TL TABLE)
-	int LFOcnt;         // LFO counter = compteur-frequence pour le LFO
-	int LFOinc;         // LFO step counter = pas d'incrementation du compteur-frequence du LFO
-						// plus le pas est grand, plus la frequence est grande
-	unsigned int AR_TAB [128];                  // Attack rate table
-	unsigned int DR_TAB [96];                   // Decay rate table
-	unsigned int DT_TAB [8] [32];               // Detune table
 	unsigned int SL_TAB [16];                   // Substain level table
-	unsigned int NULL_RATE [32];                // Table for NULL rate
-	int LFO_INC_TAB [8];                        // LFO step table
 
 	short ENV_TAB [2 * ENV_LENGHT + 8];         // ENV CURVE TABLE (attack & decay)
 
@@ -212,7 +209,27 @@ struct tables_t
 	short LFO_FREQ_TAB [LFO_LENGHT];            // LFO FMS TABLE
 	int TL_TAB [TL_LENGHT * 2];                 // TOTAL LEVEL TABLE (positif and minus)
 	unsigned int DECAY_TO_ATTACK [ENV_LENGHT];  // Conversion from decay to attack phase
+
+	fixed_tables_t();
+};
+
+// Tables for a sample and clock rate, shared by all chips using that pair.
+// Immutable once made, and freed when the last chip using them releases them.
+struct rate_tables_t
+{
+	rate_tables_t* next;
+	int refs;
+	double sample_rate;
+	double clock_rate;
+
+	unsigned int AR_TAB [128];                  // Attack rate table
+	unsigned int DR_TAB [96];                   // Decay rate table
+	unsigned int DT_TAB [8] [32];               // Detune table
+	unsigned int NULL_RATE [32];                // Table for NULL rate
+	int LFO_INC_TAB [8];                        // LFO step table
 	unsigned int FINC_TAB [2048];               // Frequency step table
+
+	void generate();
 };
 
 static const unsigned char DT_DEF_TAB [4 * 32] =
@@ -263,7 +280,8 @@ struct Ym2612_GENS_Impl
 
 	state_t YM2612;
 	int mute_mask;
-	tables_t g;
+	fixed_tables_t const* fixed;
+	rate_tables_t* rates;
 
 	void KEY_ON( channel_t&, int );
 	void KEY_OFF( channel_t&, int );
@@ -271,12 +289,13 @@ struct Ym2612_GENS_Impl
 	int CHANNEL_SET( int, int );
 	int YM_SET( int, int );
 
-	void set_rate( double sample_rate, double clock_factor );
+	blargg_err_t set_rate( double sample_rate, double clock_factor );
 	void reset();
 	void write0( int addr, int data );
 	void write1( int addr, int data );
 	void run_timer( int );
 	void run( int pair_count, Ym2612_GENS_Emu::sample_t* );
+	void copy_state( State_Copier& );
 };
 
 void Ym2612_GENS_Impl::KEY_ON( channel_t& ch, int nsl)
@@ -289,10 +308,10 @@ void Ym2612_GENS_Impl::KEY_ON( channel_t& ch, int nsl)
 
 		// Fix Ecco 2 splash sound
 
-		SL->Ecnt = (g.DECAY_TO_ATTACK [g.ENV_TAB [SL->Ecnt >> ENV_LBITS]] + ENV_ATTACK) & SL->ChgEnM;
+		SL->Ecnt = (fixed->DECAY_TO_ATTACK [fixed->ENV_TAB [SL->Ecnt >> ENV_LBITS]] + ENV_ATTACK) & SL->ChgEnM;
 		SL->ChgEnM = ~0;
 
-//      SL->Ecnt = g.DECAY_TO_ATTACK [g.ENV_TAB [SL->Ecnt >> ENV_LBITS]] + ENV_ATTACK;
+//      SL->Ecnt = fixed->DECAY_TO_ATTACK [fixed->ENV_TAB [SL->Ecnt >> ENV_LBITS]] + ENV_ATTACK;
 //      SL->Ecnt = 0;
 
 		SL->Einc = SL->EincA;
@@ -310,7 +329,7 @@ void Ym2612_GENS_Impl::KEY_OFF(channel_t& ch, int nsl)
 	{
 		if (SL->Ecnt < ENV_DECAY)   // attack phase ?
 		{
-			SL->Ecnt = (g.ENV_TAB [SL->Ecnt >> ENV_LBITS] << ENV_LBITS) + ENV_DECAY;
+			SL->Ecnt = (fixed->ENV_TAB [SL->Ecnt >> ENV_LBITS] << ENV_LBITS) + ENV_DECAY;
 		}
 
 		SL->Einc = SL->EincR;
@@ -335,7 +354,7 @@ int Ym2612_GENS_Impl::SLOT_SET( int Adr, int data )
 			if ( (sl.MUL = (data & 0x0F)) != 0 ) sl.MUL <<= 1;
 			else sl.MUL = 1;
 
-			sl.DT = (int*) g.DT_TAB [(data >> 4) & 7];
+			sl.DT = (int*) rates->DT_TAB [(data >> 4) & 7];
 
 			ch.SLOT [0].Finc = -1;
 
@@ -360,8 +379,8 @@ int Ym2612_GENS_Impl::SLOT_SET( int Adr, int data )
 
 			ch.SLOT [0].Finc = -1;
 
-			if (data &= 0x1F) sl.AR = (int*) &g.AR_TAB [data << 1];
-			else sl.AR = (int*) &g.NULL_RATE [0];
+			if (data &= 0x1F) sl.AR = (int*) &rates->AR_TAB [data << 1];
+			else sl.AR = (int*) &rates->NULL_RATE [0];
 
 			sl.EincA = sl.AR [sl.KSR];
 			if (sl.Ecurp == ATTACK) sl.Einc = sl.EincA;
@@ -371,25 +390,25 @@ int Ym2612_GENS_Impl::SLOT_SET( int Adr, int data )
 			if ( (sl.AMSon = (data & 0x80)) != 0 ) sl.AMS = ch.AMS;
 			else sl.AMS = 31;
 
-			if (data &= 0x1F) sl.DR = (int*) &g.DR_TAB [data << 1];
-			else sl.DR = (int*) &g.NULL_RATE [0];
+			if (data &= 0x1F) sl.DR = (int*) &rates->DR_TAB [data << 1];
+			else sl.DR = (int*) &rates->NULL_RATE [0];
 
 			sl.EincD = sl.DR [sl.KSR];
 			if (sl.Ecurp == DECAY) sl.Einc = sl.EincD;
 			break;
 
 		case 0x70:
-			if (data &= 0x1F) sl.SR = (int*) &g.DR_TAB [data << 1];
-			else sl.SR = (int*) &g.NULL_RATE [0];
+			if (data &= 0x1F) sl.SR = (int*) &rates->DR_TAB [data << 1];
+			else sl.SR = (int*) &rates->NULL_RATE [0];
 
 			sl.EincS = sl.SR [sl.KSR];
 			if ((sl.Ecurp == SUBSTAIN) && (sl.Ecnt < ENV_END)) sl.Einc = sl.EincS;
 			break;
 
 		case 0x80:
-			sl.SLL = g.SL_TAB [data >> 4];
+			sl.SLL = fixed->SL_TAB [data >> 4];
 
-			sl.RR = (int*) &g.DR_TAB [((data & 0xF) << 2) + 2];
+			sl.RR = (int*) &rates->DR_TAB [((data & 0xF) << 2) + 2];
 
 			sl.EincR = sl.RR [sl.KSR];
 			if ((sl.Ecurp == RELEASE) && (sl.Ecnt < ENV_END)) sl.Einc = sl.EincR;
@@ -534,11 +553,11 @@ int Ym2612_GENS_Impl::YM_SET(int Adr, int data)
 				// Cool Spot music 1, LFO modified severals time which
 				// distord the sound, have to check that on a real genesis...
 
-				g.LFOinc = g.LFO_INC_TAB [data & 7];
+				YM2612.LFOinc = rates->LFO_INC_TAB [data & 7];
 			}
 			else
 			{
-				g.LFOinc = g.LFOcnt = 0;
+				YM2612.LFOinc = YM2612.LFOcnt = 0;
 			}
 			break;
 
@@ -630,21 +649,10 @@ int Ym2612_GENS_Impl::YM_SET(int Adr, int data)
 	return 0;
 }
 
-void Ym2612_GENS_Impl::set_rate( double sample_rate, double clock_rate )
+fixed_tables_t::fixed_tables_t()
 {
-	assert( sample_rate );
-	assert( clock_rate > sample_rate );
-
 	int i;
 
-	// 144 = 12 * (prescale * 2) = 12 * 6 * 2
-	// prescale set to 6 by default
-
-	double Frequence = clock_rate / sample_rate / 144.0;
-	if ( fabs( Frequence - 1.0 ) < 0.0000001 )
-		Frequence = 1.0;
-	YM2612.TimerBase = int (Frequence * 4096.0);
-
 	// Tableau TL :
 	// [0     -  4095] = +output  [4095  - ...] = +output overflow (fill with 0)
 	// [12288 - 16383] = -output  [16384 - ...] = -output overflow (fill with 0)
@@ -653,23 +661,23 @@ void Ym2612_GENS_Impl::set_rate( double sample_rate, double clock_rate )
 	{
 		if (i >= PG_CUT_OFF)    // YM2612 cut off sound after 78 dB (14 bits output ?)
 		{
-			g.TL_TAB [TL_LENGHT + i] = g.TL_TAB [i] = 0;
+			TL_TAB [TL_LENGHT + i] = TL_TAB [i] = 0;
 		}
 		else
 		{
 			double x = MAX_OUT;                         // Max output
 			x /= pow( 10.0, (ENV_STEP * i) / 20.0 );    // Decibel -> Voltage
 
-			g.TL_TAB [i] = (int) x;
-			g.TL_TAB [TL_LENGHT + i] = -g.TL_TAB [i];
+			TL_TAB [i] = (int) x;
+			TL_TAB [TL_LENGHT + i] = -TL_TAB [i];
 		}
 	}
 
 	// Tableau SIN :
-	// g.SIN_TAB [x] [y] = sin(x) * y;
+	// SIN_TAB [x] [y] = sin(x) * y;
 	// x = phase and y = volume
 
-	g.SIN_TAB [0] = g.SIN_TAB [SIN_LENGHT / 2] = PG_CUT_OFF;
+	SIN_TAB [0] = SIN_TAB [SIN_LENGHT / 2] = PG_CUT_OFF;
 
 	for(i = 1; i <= SIN_LENGHT / 4; i++)
 	{
@@ -680,8 +688,8 @@ void Ym2612_GENS_Impl::set_rate( double sample_rate, double clock_rate )
 
 		if (j > PG_CUT_OFF) j = (int) PG_CUT_OFF;
 
-		g.SIN_TAB [i] = g.SIN_TAB [(SIN_LENGHT / 2) - i] = j;
-		g.SIN_TAB [(SIN_LENGHT / 2) + i] = g.SIN_TAB [SIN_LENGHT - i] = TL_LENGHT + j;
+		SIN_TAB [i] = SIN_TAB [(SIN_LENGHT / 2) - i] = j;
+		SIN_TAB [(SIN_LENGHT / 2) + i] = SIN_TAB [SIN_LENGHT - i] = TL_LENGHT + j;
 	}
 
 	// Tableau LFO (LFO wav) :
@@ -693,18 +701,18 @@ void Ym2612_GENS_Impl::set_rate( double sample_rate, double clock_rate )
 		x /= 2.0;                   // positive only
 		x *= 11.8 / ENV_STEP;       // ajusted to MAX enveloppe modulation
 
-		g.LFO_ENV_TAB [i] = (int) x;
+		LFO_ENV_TAB [i] = (int) x;
 
 		x = sin(2.0 * PI * (double) (i) / (double) (LFO_LENGHT));   // Sinus
 		x *= (double) ((1 << (LFO_HBITS - 1)) - 1);
 
-		g.LFO_FREQ_TAB [i] = (int) x;
+		LFO_FREQ_TAB [i] = (int) x;
 
 	}
 
 	// Tableau Enveloppe :
-	// g.ENV_TAB [0] -> g.ENV_TAB [ENV_LENGHT - 1]              = attack curve
-	// g.ENV_TAB [ENV_LENGHT] -> g.ENV_TAB [2 * ENV_LENGHT - 1] = decay curve
+	// ENV_TAB [0] -> ENV_TAB [ENV_LENGHT - 1]              = attack curve
+	// ENV_TAB [ENV_LENGHT] -> ENV_TAB [2 * ENV_LENGHT - 1] = decay curve
 
 	for(i = 0; i < ENV_LENGHT; i++)
 	{
@@ -712,28 +720,28 @@ void Ym2612_GENS_Impl::set_rate( double sample_rate, double clock_rate )
 		double x = pow(((double) ((ENV_LENGHT - 1) - i) / (double) (ENV_LENGHT)), 8);
 		x *= ENV_LENGHT;
 
-		g.ENV_TAB [i] = (int) x;
+		ENV_TAB [i] = (int) x;
 
 		// Decay curve (just linear)
 		x = pow(((double) (i) / (double) (ENV_LENGHT)), 1);
 		x *= ENV_LENGHT;
 
-		g.ENV_TAB [ENV_LENGHT + i] = (int) x;
+		ENV_TAB [ENV_LENGHT + i] = (int) x;
 	}
 	for ( i = 0; i < 8; i++ )
-		g.ENV_TAB [i + ENV_LENGHT * 2] = 0;
+		ENV_TAB [i + ENV_LENGHT * 2] = 0;
 
-	g.ENV_TAB [ENV_END >> ENV_LBITS] = ENV_LENGHT - 1;      // for the stopped state
+	ENV_TAB [ENV_END >> ENV_LBITS] = ENV_LENGHT - 1;      // for the stopped state
 
 	// Tableau pour la conversion Attack -> Decay and Decay -> Attack
 
 	int j = ENV_LENGHT - 1;
 	for ( i = 0; i < ENV_LENGHT; i++ )
 	{
-		while ( j && g.ENV_TAB [j] < i )
+		while ( j && ENV_TAB [j] < i )
 			j--;
 
-		g.DECAY_TO_ATTACK [i] = j << ENV_LBITS;
+		DECAY_TO_ATTACK [i] = j << ENV_LBITS;
 	}
 
 	// Tableau pour le Substain Level
@@ -743,10 +751,33 @@ void Ym2612_GENS_Impl::set_rate( double sample_rate, double clock_rate )
 		double x = i * 3;           // 3 and not 6 (Mickey Mania first music for test)
 		x /= ENV_STEP;
 
-		g.SL_TAB [i] = ((int) x << ENV_LBITS) + ENV_DECAY;
+		SL_TAB [i] = ((int) x << ENV_LBITS) + ENV_DECAY;
 	}
 
-	g.SL_TAB [15] = ((ENV_LENGHT - 1) << ENV_LBITS) + ENV_DECAY; // special case : volume off
+	SL_TAB [15] = ((ENV_LENGHT - 1) << ENV_LBITS) + ENV_DECAY; // special case : volume off
+}
+
+static fixed_tables_t const& fixed_tables()
+{
+	static fixed_tables_t const tables; // built on first use
+	return tables;
+}
+
+// 144 = 12 * (prescale * 2) = 12 * 6 * 2
+// prescale set to 6 by default
+static double calc_frequence( double sample_rate, double clock_rate )
+{
+	double Frequence = clock_rate / sample_rate / 144.0;
+	if ( fabs( Frequence - 1.0 ) < 0.0000001 )
+		Frequence = 1.0;
+	return Frequence;
+}
+
+void rate_tables_t::generate()
+{
+	int i;
+
+	double const Frequence = calc_frequence( sample_rate, clock_rate );
 
 	// Tableau Frequency Step
 
@@ -762,15 +793,15 @@ void Ym2612_GENS_Impl::set_rate( double sample_rate, double clock_rate )
 
 		x /= 2.0;   // because MUL = value * 2
 
-		g.FINC_TAB [i] = (unsigned int) x;
+		FINC_TAB [i] = (unsigned int) x;
 	}
 
 	// Tableaux Attack & Decay Rate
 
 	for(i = 0; i < 4; i++)
 	{
-		g.AR_TAB [i] = 0;
-		g.DR_TAB [i] = 0;
+		AR_TAB [i] = 0;
+		DR_TAB [i] = 0;
 	}
 
 	for(i = 0; i < 60; i++)
@@ -779,22 +810,22 @@ void Ym2612_GENS_Impl::set_rate( double sample_rate, double clock_rate )
 
 		x *= 1.0 + ((i & 3) * 0.25);                    // bits 0-1 : x1.00, x1.25, x1.50, x1.75
 		x *= (double) (1 << ((i >> 2)));                // bits 2-5 : shift bits (x2^0 - x2^15)
-		x *= (double) (ENV_LENGHT << ENV_LBITS);        // on ajuste pour le tableau g.ENV_TAB
+		x *= (double) (ENV_LENGHT << ENV_LBITS);        // on ajuste pour le tableau ENV_TAB
 
-		g.AR_TAB [i + 4] = (unsigned int) (x / AR_RATE);
-		g.DR_TAB [i + 4] = (unsigned int) (x / DR_RATE);
+		AR_TAB [i + 4] = (unsigned int) (x / AR_RATE);
+		DR_TAB [i + 4] = (unsigned int) (x / DR_RATE);
 	}
 
 	for(i = 64; i < 96; i++)
 	{
-		g.AR_TAB [i] = g.AR_TAB [63];
-		g.DR_TAB [i] = g.DR_TAB [63];
+		AR_TAB [i] = AR_TAB [63];
+		DR_TAB [i] = DR_TAB [63];
 
-		g.NULL_RATE [i - 64] = 0;
+		NULL_RATE [i - 64] = 0;
 	}
 
 	for ( i = 96; i < 128; i++ )
-		g.AR_TAB [i] = 0;
+		AR_TAB [i] = 0;
 
 	// Tableau Detune
 
@@ -808,22 +839,81 @@ void Ym2612_GENS_Impl::set_rate( double sample_rate, double clock_rate )
 			double y = (double) DT_DEF_TAB [(i << 5) + j] * Frequence * (double) (1 << (SIN_LBITS + SIN_HBITS - 21));
 #endif
 
-			g.DT_TAB [i + 0] [j] = (int)  y;
-			g.DT_TAB [i + 4] [j] = (int) -y;
+			DT_TAB [i + 0] [j] = (int)  y;
+			DT_TAB [i + 4] [j] = (int) -y;
 		}
 	}
 
 	// Tableau LFO
-	g.LFO_INC_TAB [0] = (unsigned int) (3.98 * (double) (1 << (LFO_HBITS + LFO_LBITS)) / sample_rate);
-	g.LFO_INC_TAB [1] = (unsigned int) (5.56 * (double) (1 << (LFO_HBITS + LFO_LBITS)) / sample_rate);
-	g.LFO_INC_TAB [2] = (unsigned int) (6.02 * (double) (1 << (LFO_HBITS + LFO_LBITS)) / sample_rate);
-	g.LFO_INC_TAB [3] = (unsigned int) (6.37 * (double) (1 << (LFO_HBITS + LFO_LBITS)) / sample_rate);
-	g.LFO_INC_TAB [4] = (unsigned int) (6.88 * (double) (1 << (LFO_HBITS + LFO_LBITS)) / sample_rate);
-	g.LFO_INC_TAB [5] = (unsigned int) (9.63 * (double) (1 << (LFO_HBITS + LFO_LBITS)) / sample_rate);
-	g.LFO_INC_TAB [6] = (unsigned int) (48.1 * (double) (1 << (LFO_HBITS + LFO_LBITS)) / sample_rate);
-	g.LFO_INC_TAB [7] = (unsigned int) (72.2 * (double) (1 << (LFO_HBITS + LFO_LBITS)) / sample_rate);
+	LFO_INC_TAB [0] = (unsigned int) (3.98 * (double) (1 << (LFO_HBITS + LFO_LBITS)) / sample_rate);
+	LFO_INC_TAB [1] = (unsigned int) (5.56 * (double) (1 << (LFO_HBITS + LFO_LBITS)) / sample_rate);
+	LFO_INC_TAB [2] = (unsigned int) (6.02 * (double) (1 << (LFO_HBITS + LFO_LBITS)) / sample_rate);
+	LFO_INC_TAB [3] = (unsigned int) (6.37 * (double) (1 << (LFO_HBITS + LFO_LBITS)) / sample_rate);
+	LFO_INC_TAB [4] = (unsigned int) (6.88 * (double) (1 << (LFO_HBITS + LFO_LBITS)) / sample_rate);
+	LFO_INC_TAB [5] = (unsigned int) (9.63 * (double) (1 << (LFO_HBITS + LFO_LBITS)) / sample_rate);
+	LFO_INC_TAB [6] = (unsigned int) (48.1 * (double) (1 << (LFO_HBITS + LFO_LBITS)) / sample_rate);
+	LFO_INC_TAB [7] = (unsigned int) (72.2 * (double) (1 << (LFO_HBITS + LFO_LBITS)) / sample_rate);
+}
+
+static std::mutex rate_tables_mutex;
+static rate_tables_t* rate_tables_list;
+
+static rate_tables_t* find_rate_tables( double sample_rate, double clock_rate )
+{
+	std::lock_guard<std::mutex> lock( rate_tables_mutex );
+
+	rate_tables_t* t = rate_tables_list;
+	while ( t && !(t->sample_rate == sample_rate && t->clock_rate == clock_rate) )
+		t = t->next;
+
+	if ( !t )
+	{
+		t = (rate_tables_t*) malloc( sizeof *t );
+		if ( !t )
+			return nullptr;
+		t->refs        = 0;
+		t->sample_rate = sample_rate;
+		t->clock_rate  = clock_rate;
+		t->generate();
+		t->next = rate_tables_list;
+		rate_tables_list = t;
+	}
+	t->refs++;
+	return t;
+}
+
+static void release_rate_tables( rate_tables_t* t )
+{
+	if ( !t )
+		return;
+
+	std::lock_guard<std::mutex> lock( rate_tables_mutex );
+	if ( --t->refs )
+		return;
+
+	rate_tables_t** p = &rate_tables_list;
+	while ( *p != t )
+		p = &(*p)->next;
+	*p = t->next;
+	free( t );
+}
+
+blargg_err_t Ym2612_GENS_Impl::set_rate( double sample_rate, double clock_rate )
+{
+	assert( sample_rate );
+	assert( clock_rate > sample_rate );
+
+	rate_tables_t* new_rates = find_rate_tables( sample_rate, clock_rate );
+	if ( !new_rates )
+		return ERR_OUT_OF_MEMORY;
+	release_rate_tables( rates );
+	rates = new_rates;
+	fixed = &fixed_tables();
+
+	YM2612.TimerBase = int (calc_frequence( sample_rate, clock_rate ) * 4096.0);
 
 	reset();
+	return 0;
 }
 
 blargg_err_t Ym2612_GENS_Emu::set_rate( double sample_rate, double clock_rate )
@@ -834,16 +924,17 @@ blargg_err_t Ym2612_GENS_Emu::set_rate( double sample_rate, double clock_rate )
 		if ( !impl )
 			return ERR_OUT_OF_MEMORY;
 		impl->mute_mask = 0;
+		impl->rates = nullptr;
 	}
 	memset( &impl->YM2612, 0, sizeof impl->YM2612 );
 
-	impl->set_rate( sample_rate, clock_rate );
-
-	return 0;
+	return impl->set_rate( sample_rate, clock_rate );
 }
 
 Ym2612_GENS_Emu::~Ym2612_GENS_Emu()
 {
+	if ( impl )
+		release_rate_tables( impl->rates );
 	free( impl );
 }
 
@@ -889,7 +980,7 @@ void Ym2612_GENS_Emu::reset()
 
 void Ym2612_GENS_Impl::reset()
 {
-	g.LFOcnt = 0;
+	YM2612.LFOcnt = 0;
 	YM2612.TimerA = 0;
 	YM2612.TimerAL = 0;
 	YM2612.TimerAcnt = 0;
@@ -1035,13 +1126,13 @@ static inline void update_envelope( slot_t& sl )
 
 template<int algo>
 struct ym2612_update_chan {
-	static void func( tables_t&, channel_t&, Ym2612_GENS_Emu::sample_t*, int );
+	static void func( fixed_tables_t const&, state_t const&, channel_t&, Ym2612_GENS_Emu::sample_t*, int );
 };
 
-typedef void (*ym2612_update_chan_t)( tables_t&, channel_t&, Ym2612_GENS_Emu::sample_t*, int );
+typedef void (*ym2612_update_chan_t)( fixed_tables_t const&, state_t const&, channel_t&, Ym2612_GENS_Emu::sample_t*, int );
 
 template<int algo>
-void ym2612_update_chan<algo>::func( tables_t& g, channel_t& ch,
+void ym2612_update_chan<algo>::func( fixed_tables_t const& g, state_t const& st, channel_t& ch,
 		Ym2612_GENS_Emu::sample_t* buf, int length )
 {
 	int not_end = ch.SLOT [S3].Ecnt - ENV_END;
@@ -1066,8 +1157,8 @@ void ym2612_update_chan<algo>::func( tables_t& g, channel_t& ch,
 	int in2 = ch.SLOT [S2].Fcnt;
 	int in3 = ch.SLOT [S3].Fcnt;
 
-	int YM2612_LFOinc = g.LFOinc;
-	int YM2612_LFOcnt = g.LFOcnt + YM2612_LFOinc;
+	int YM2612_LFOinc = st.LFOinc;
+	int YM2612_LFOcnt = st.LFOcnt + YM2612_LFOinc;
 
 	if ( !not_end )
 		return;
@@ -1275,7 +1366,7 @@ void Ym2612_GENS_Impl::run( int pair_count, Ym2612_GENS_Emu::sample_t* out )
 			// if ( i2 ) i2 = seq [i];
 
 			slot_t& sl = ch.SLOT [i];
-			int finc = g.FINC_TAB [ch.FNUM [i2]] >> (7 - ch.FOCT [i2]);
+			int finc = rates->FINC_TAB [ch.FNUM [i2]] >> (7 - ch.FOCT [i2]);
 			int ksr = ch.KC [i2] >> sl.KSR_S;   // keycode attenuation
 			sl.Finc = (finc + sl.DT [ch.KC [i2]]) * sl.MUL;
 			if (sl.KSR != ksr)          // si le KSR a change alors
@@ -1312,12 +1403,82 @@ void Ym2612_GENS_Impl::run( int pair_count, Ym2612_GENS_Emu::sample_t* out )
 	for ( int i = 0; i < channel_count; i++ )
 	{
 		if ( !(mute_mask & (1 << i)) && (i != 5 || !YM2612.DAC) )
-			UPDATE_CHAN [YM2612.CHANNEL [i].ALGO]( g, YM2612.CHANNEL [i], out, pair_count );
+			UPDATE_CHAN [YM2612.CHANNEL [i].ALGO]( *fixed, YM2612, YM2612.CHANNEL [i], out, pair_count );
 	}
 
-	g.LFOcnt += g.LFOinc * pair_count;
+	YM2612.LFOcnt += YM2612.LFOinc * pair_count;
 }
 
 void Ym2612_GENS_Emu::run( int pair_count, sample_t* out ) { impl->run( pair_count, out ); }
 
-#endif /* VGM_YM2612_GENS */
+// Slot rate and detune pointers refer to shared rate tables, so state stores
+// them as offsets from those
+static void relocate_slots( state_t& st, uintptr_t delta )
+{
+	for ( int chi = 0; chi < Ym2612_GENS_Emu::channel_count; chi++ )
+	{
+		for ( int i = 0; i < 4; i++ )
+		{
+			slot_t& sl = st.CHANNEL [chi].SLOT [i];
+			const int** const ptrs [5] = { &sl.DT, &sl.AR, &sl.DR, &sl.SR, &sl.RR };
+			for ( int n = 0; n < 5; n++ )
+				if ( *ptrs [n] )
+					*ptrs [n] = (const int*) ((uintptr_t) *ptrs [n] + delta);
+		}
+	}
+}
+
+void Ym2612_GENS_Impl::copy_state( State_Copier& copier )
+{
+	uintptr_t const base = (uintptr_t) rates;
+	if ( !copier.loading() )
+	{
+		relocate_slots( YM2612, 0 - base );
+		copier.copy( &YM2612, sizeof YM2612 );
+		relocate_slots( YM2612, base );
+	}
+	else
+	{
+		// load into copy so chip is unchanged if state is invalid
+		state_t* in = (state_t*) malloc( sizeof *in );
+		if ( !in )
+		{
+			copier.set_error( ERR_OUT_OF_MEMORY );
+			return;
+		}
+		copier.copy( in, sizeof *in );
+
+		// each table pointer is indexed by up to 32 entries
+		uintptr_t const min_offset = offsetof (rate_tables_t,AR_TAB);
+		uintptr_t const max_offset = sizeof (rate_tables_t) - 32 * sizeof (int);
+		bool valid = true;
+		for ( int chi = 0; chi < channel_count; chi++ )
+		{
+			channel_t const& ch = in->CHANNEL [chi];
+			valid &= (unsigned) ch.ALGO < 8;
+			for ( int i = 0; i < 4; i++ )
+			{
+				slot_t const& sl = ch.SLOT [i];
+				const int* const ptrs [5] = { sl.DT, sl.AR, sl.DR, sl.SR, sl.RR };
+				for ( int n = 0; n < 5; n++ )
+				{
+					uintptr_t offset = (uintptr_t) ptrs [n];
+					valid &= offset >= min_offset && offset <= max_offset && !(offset % sizeof (int));
+				}
+			}
+		}
+
+		if ( valid )
+		{
+			YM2612 = *in;
+			relocate_slots( YM2612, base );
+		}
+		else
+		{
+			copier.set_error( ERR_STATE_INVALID );
+		}
+		free( in );
+	}
+}
+
+void Ym2612_GENS_Emu::copy_state( State_Copier& copier ) { impl->copy_state( copier ); }
@@ -1,11 +1,12 @@
-// YM2612 FM sound chip emulator interface
+// YM2612 FM sound chip emulator (Gens 2.10)
 
 // Game_Music_Emu https://bitbucket.org/mpyne/game-music-emu/
-#ifndef YM2612_EMU_H
-#define YM2612_EMU_H
+#ifndef YM2612_GENS_H
+#define YM2612_GENS_H
 
 #include "blargg_err.h"
 
+class State_Copier;
 struct Ym2612_GENS_Impl;
 
 class Ym2612_GENS_Emu  {
@@ -35,6 +36,9 @@ public:
 	typedef short sample_t;
 	enum { out_chan_count = 2 }; // stereo
 	void run( int pair_count, sample_t* out );
+
+	// Save/load emulation state between calls to run(). Muting isn't part of state.
+	void copy_state( State_Copier& );
 };
 
 #endif
@@ -2,10 +2,12 @@
 
 // Based on Mame YM2612 ym2612.c
 
-#ifdef VGM_YM2612_MAME
+#if defined(VGM_YM2612_WITH_MAME) || defined(VGM_YM2612_MAME)
 
 #include "Ym2612_MAME.h"
 
+#include "State_Copier.h"
+
 /*
 **
 ** File: fm2612.c -- software implementation of Yamaha YM2612 FM sound generator
@@ -138,6 +140,7 @@
 /*    YM2610B : PSG:3ch FM:6ch ADPCM(18.5KHz):6ch DeltaT ADPCM:1ch      */
 /************************************************************************/
 
+#include <cstddef>
 #include <cstdlib>
 #include <cstring>	/* for memset */
 #include <cmath>
@@ -3060,6 +3063,90 @@ static void ym2612_setoptions(UINT8 Flags)
 }
 #endif
 
+/* pointers only refer to parts of the chip itself, so are stored as offsets
+   from its start (NULL stays NULL) */
+static void ym2612_relocate(YM2612 *F2612, uintptr_t delta)
+{
+	#define RELOCATE( p ) \
+		if (p) p = (decltype(p))((uintptr_t)(p) + delta)
+
+	RELOCATE( F2612->OPN.P_CH );
+	for (int c = 0; c < 6; c++)
+	{
+		FM_CH *CH = &F2612->CH[c];
+		RELOCATE( CH->connect1 );
+		RELOCATE( CH->connect2 );
+		RELOCATE( CH->connect3 );
+		RELOCATE( CH->connect4 );
+		RELOCATE( CH->mem_connect );
+		for (int s = 0; s < 4; s++)
+			RELOCATE( CH->SLOT[s].DT );
+	}
+	#undef RELOCATE
+}
+
+/* true if offset refers to size bytes within chip */
+static bool ym2612_valid_offset(const void *p, size_t size)
+{
+	uintptr_t offset = (uintptr_t)p;
+	return offset <= sizeof(YM2612) - size && !(offset % sizeof(INT32));
+}
+
+static void ym2612_copy_state(void *chip, State_Copier& copier)
+{
+	YM2612 *F2612 = (YM2612 *)chip;
+	uintptr_t base = (uintptr_t)F2612;
+
+	if (!copier.loading())
+	{
+		ym2612_relocate(F2612, 0 - base);
+		copier.copy(F2612, sizeof(YM2612));
+		ym2612_relocate(F2612, base);
+		return;
+	}
+
+	/* load into copy so chip is unchanged if state is invalid */
+	YM2612 *in = (YM2612 *)malloc(sizeof(YM2612));
+	if (in == nullptr)
+	{
+		copier.set_error(ERR_OUT_OF_MEMORY);
+		return;
+	}
+	copier.copy(in, sizeof(YM2612));
+
+	bool valid = ((uintptr_t)in->OPN.P_CH == offsetof(YM2612, CH));
+	for (int c = 0; c < 6; c++)
+	{
+		FM_CH *CH = &in->CH[c];
+		INT32 *const ptrs[5] = { CH->connect1, CH->connect2, CH->connect3, CH->connect4, CH->mem_connect };
+		for (int i = 0; i < 5; i++)
+			valid &= !ptrs[i] || ym2612_valid_offset(ptrs[i], sizeof(INT32));
+		for (int s = 0; s < 4; s++)
+			valid &= !CH->SLOT[s].DT || ym2612_valid_offset(CH->SLOT[s].DT, sizeof F2612->OPN.ST.dt_tab[0]);
+	}
+
+	if (valid && !copier.error())
+	{
+		/* keep settings and callbacks */
+		in->OPN.ST.param         = F2612->OPN.ST.param;
+		in->OPN.ST.timer_handler = F2612->OPN.ST.timer_handler;
+		in->OPN.ST.IRQ_Handler   = F2612->OPN.ST.IRQ_Handler;
+		in->OPN.ST.SSG           = F2612->OPN.ST.SSG;
+		for (int c = 0; c < 6; c++)
+			in->CH[c].Muted = F2612->CH[c].Muted;
+		in->MuteDAC     = F2612->MuteDAC;
+		in->WaveOutMode = F2612->WaveOutMode;
+
+		memcpy(F2612, in, sizeof(YM2612));
+		ym2612_relocate(F2612, base);
+	}
+	else
+	{
+		copier.set_error(ERR_STATE_INVALID);
+	}
+	free(in);
+}
+
 } // Ym2612_MameImpl
 
 
@@ -3109,4 +3196,9 @@ void Ym2612_MAME_Emu::run(int pair_count, Ym2612_MAME_Emu::sample_t *out)
 	if ( impl ) Ym2612_MameImpl::ym2612_generate( impl, out, pair_count, 1);
 }
 
-#endif /* VGM_YM2612_MAME */
+void Ym2612_MAME_Emu::copy_state( State_Copier& copier )
+{
+	if ( impl ) Ym2612_MameImpl::ym2612_copy_state( impl, copier );
+}
+
+#endif /* VGM_YM2612_WITH_MAME */
@@ -2,10 +2,10 @@
 
 // Based on Nuked OPN2 ym3438.c and ym3438.h
 
-#ifdef VGM_YM2612_NUKED
-
 #include "Ym2612_Nuked.h"
 
+#include "State_Copier.h"
+
 /*
  * Copyright (C) 2017 Alexey Khokholov (Nuke.YKT)
  *
@@ -35,6 +35,7 @@
  */
 
 
+#include <cstddef>
 #include <cstdint>
 #include <cstring>
 
@@ -1258,14 +1259,8 @@ void OPN2_FMGenerate(ym3438_t *chip)
     Bit16u quarter;
     Bit16u level;
     Bit16s output;
-    if (phase & 0x100)
-    {
-        quarter = (phase ^ 0xff) & 0xff;
-    }
-    else
-    {
-        quarter = phase & 0xff;
-    }
+    /* Mirror second quarter without a branch, as the sign of phase is unpredictable */
+    quarter = (phase ^ (0 - ((phase >> 8) & 1))) & 0xff;
     level = logsinrom[quarter];
     /* Apply envelope */
     level += chip->eg_out[slot] << 2;
@@ -1686,9 +1681,8 @@ void OPN2_Generate(ym3438_t *chip, Bit16s *buf)
     Bit32u i;
     Bit16s buffer[2];
     Bit32u mute;
-
-    buf[0] = 0;
-    buf[1] = 0;
+    Bit16s out_l = 0;
+    Bit16s out_r = 0;
 
     for (i = 0; i < 24; i++)
     {
@@ -1717,10 +1711,12 @@ void OPN2_Generate(ym3438_t *chip, Bit16s *buf)
             break;
         }
         OPN2_Clock(chip, buffer);
+        /* Reading buffer back as a pair right after its two 16-bit stores
+           defeats store forwarding, so take the same values from chip */
         if (!mute)
         {
-            buf[0] += buffer[0];
-            buf[1] += buffer[1];
+            out_l += chip->mol;
+            out_r += chip->mor;
         }
 
         while (chip->writebuf[chip->writebuf_cur].time <= chip->writebuf_samplecnt)
@@ -1736,6 +1732,8 @@ void OPN2_Generate(ym3438_t *chip, Bit16s *buf)
         }
         chip->writebuf_samplecnt++;
     }
+    buf[0] = out_l;
+    buf[1] = out_r;
 }
 
 void OPN2_GenerateResampled(ym3438_t *chip, Bit16s *buf)
@@ -1873,4 +1871,39 @@ void Ym2612_Nuked_Emu::run(int pair_count, Ym2612_Nuked_Emu::sample_t *out)
 	Ym2612_NukedImpl::OPN2_GenerateStreamMix(chip_r, out, pair_count);
 }
 
-#endif /* VGM_YM2612_NUKED */
+void Ym2612_Nuked_Emu::copy_state( State_Copier& copier )
+{
+	Ym2612_NukedImpl::ym3438_t *chip_r = reinterpret_cast<Ym2612_NukedImpl::ym3438_t*>(impl);
+	if ( !chip_r ) return;
+
+	// everything before write buffer is plain data, so copy it as is
+	Bit32u mute [7];
+	memcpy( mute, chip_r->mute, sizeof mute );
+	copier.copy( chip_r, offsetof( Ym2612_NukedImpl::ym3438_t, writebuf ) );
+	memcpy( chip_r->mute, mute, sizeof mute );
+
+	// only pending writes matter; if buffer is full, writebuf_cur equals writebuf_last
+	long count = (chip_r->writebuf_last - chip_r->writebuf_cur) % OPN_WRITEBUF_SIZE;
+	if ( !count && chip_r->writebuf_cur < OPN_WRITEBUF_SIZE && (chip_r->writebuf [chip_r->writebuf_cur].port & 0x04) )
+		count = OPN_WRITEBUF_SIZE;
+	copier.copy_int( count );
+	if ( copier.loading() )
+	{
+		if ( chip_r->writebuf_cur >= OPN_WRITEBUF_SIZE || chip_r->writebuf_last >= OPN_WRITEBUF_SIZE ||
+				(unsigned long) count > OPN_WRITEBUF_SIZE )
+		{
+			copier.set_error( ERR_STATE_INVALID );
+			chip_r->writebuf_cur  = 0;
+			chip_r->writebuf_last = 0;
+			count = 0;
+		}
+		memset( chip_r->writebuf, 0, sizeof chip_r->writebuf );
+	}
+	for ( long i = 0; i < count; i++ )
+	{
+		Ym2612_NukedImpl::opn2_writebuf& w = chip_r->writebuf [(chip_r->writebuf_cur + i) % OPN_WRITEBUF_SIZE];
+		copier.copy_int( w.time );
+		copier.copy_int( w.port );
+		copier.copy_int( w.data );
+	}
+}
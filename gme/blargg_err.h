@@ -35,13 +35,16 @@ enum {
 	ERR_READ,
 	ERR_ROM_DATA_MISSING,
 	ERR_SPC_EMULATION,
+	ERR_STATE_INVALID,
+	ERR_STATE_NOT_SUPPORTED,
 	ERR_TRACK_COUNT_INVALID,
 	ERR_TRACK_DATA_MISSING,
 	ERR_TRACK_INVALID,
 	ERR_TRACK_SINGLE_ONLY,
 	ERR_USE_FULL_EMULATOR_FOR_PLAYBACK,
 	ERR_YM2413_FM_NOT_SUPPORTED,
-	ERR_LAST = ERR_YM2413_FM_NOT_SUPPORTED
+	ERR_YM2612_EMU_NOT_SUPPORTED,
+	ERR_LAST = ERR_YM2612_EMU_NOT_SUPPORTED
 };
 
 enum {
@@ -0,0 +1,54 @@
+// x86 SSE2/AVX2 support checks shared by the vectorized code paths
+
+// Game_Music_Emu https://bitbucket.org/mpyne/game-music-emu/
+#ifndef BLARGG_SIMD_H
+#define BLARGG_SIMD_H
+
+// BLARGG_SIMD: 1 if compiler targets a CPU with SSE2 (every x86-64 CPU does).
+// BLIP_SYNTH_SIMD, FIR_RESAMPLER_SIMD and SPC_DSP_SIMD default to this.
+#if defined (__SSE2__) || defined (_M_X64) || (defined (_M_IX86_FP) && _M_IX86_FP >= 2)
+	#define BLARGG_SIMD 1
+#else
+	#define BLARGG_SIMD 0
+#endif
+
+#if BLARGG_SIMD
+
+#ifdef _MSC_VER
+	#include <intrin.h>
+#endif
+
+// BLARGG_TARGET_AVX2: Put before a function that uses AVX2 intrinsics, so that it
+// can be compiled without enabling AVX2 for the whole file. Only call such a
+// function if blargg_cpu_has_avx2() is true. Helpers it calls are inlined into it.
+#if defined (__GNUC__) || defined (__clang__)
+	#define BLARGG_TARGET_AVX2 __attribute__((target("avx2"),flatten))
+#else
+	#define BLARGG_TARGET_AVX2
+#endif
+
+// True if CPU and OS support AVX2. Not cheap, so callers should keep the result.
+inline bool blargg_cpu_has_avx2()
+{
+#if defined (_MSC_VER)
+	int info [4];
+	__cpuid( info, 0 );
+	if ( info [0] < 7 )
+		return false;
+	__cpuid( info, 1 );
+	int const osxsave_avx = (1 << 27) | (1 << 28);
+	if ( (info [2] & osxsave_avx) != osxsave_avx || (_xgetbv( 0 ) & 6) != 6 )
+		return false;
+	__cpuidex( info, 7, 0 );
+	return (info [1] & (1 << 5)) != 0;
+#elif defined (__GNUC__) || defined (__clang__)
+	__builtin_cpu_init();
+	return __builtin_cpu_supports( "avx2" ) != 0;
+#else
+	return false;
+#endif
+}
+
+#endif
+
+#endif
@@ -1511,3 +1511,33 @@ uint32_t OPLL_toggleMask(OPLL *opll, uint32_t mask) {
   } else
     return 0;
 }
+
+/* patch index 0 is null_patch, otherwise opll->patch[index - 1] */
+void OPLL_packPointers(OPLL *opll) {
+  int i;
+  for (i = 0; i < 18; i++) {
+    OPLL_SLOT *slot = &opll->slot[i];
+    uintptr_t patch = 0;
+    if (slot->patch != &null_patch)
+      patch = slot->patch - opll->patch + 1;
+    slot->patch = (OPLL_PATCH *)patch;
+    slot->wave_table = (uint16_t *)(uintptr_t)(slot->wave_table == wave_table_map[1]);
+  }
+}
+
+int OPLL_unpackPointers(OPLL *opll) {
+  int i, err = 0;
+  for (i = 0; i < 18; i++) {
+    OPLL_SLOT *slot = &opll->slot[i];
+    uintptr_t patch = (uintptr_t)slot->patch;
+    uintptr_t wave = (uintptr_t)slot->wave_table;
+    if (patch > 19 * 2 || wave > 1) {
+      err = 1;
+      patch = 0;
+      wave = 0;
+    }
+    slot->patch = patch ? &opll->patch[patch - 1] : &null_patch;
+    slot->wave_table = wave_table_map[wave];
+  }
+  return err;
+}
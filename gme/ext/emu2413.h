@@ -220,6 +220,14 @@ uint32_t OPLL_setMask(OPLL *, uint32_t mask);
  */
 uint32_t OPLL_toggleMask(OPLL *, uint32_t mask);
 
+/**
+ * Convert slot patch and wave table pointers to indices so that the OPLL can be
+ * saved byte-for-byte, and back. Other pointers (conv) are left unchanged.
+ * OPLL_unpackPointers returns non-zero if an index is out of range.
+ */
+void OPLL_packPointers(OPLL *opll);
+int OPLL_unpackPointers(OPLL *opll);
+
 /* for compatibility */
 #define OPLL_set_rate OPLL_setRate
 #define OPLL_set_quality OPLL_setQuality
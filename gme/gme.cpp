@@ -1,6 +1,7 @@
 // Game_Music_Emu https://bitbucket.org/mpyne/game-music-emu/
 
 #include "Music_Emu.h"
+#include "Music_Fanout.h"
 
 #ifdef GEN_TYPES_H
 #include "gen_types.h" /* same as gme_types.h but generated by build system */
@@ -55,12 +56,15 @@ static const char* const blargg_errmsg[] = {
 	"Read error",                           // ERR_READ
 	"ROM data missing",                     // ERR_ROM_DATA_MISSING
 	"SPC emulation error",                  // ERR_SPC_EMULATION
+	"Invalid or mismatched emulator state", // ERR_STATE_INVALID
+	"Emulator state can't be saved",        // ERR_STATE_NOT_SUPPORTED
 	"Invalid track count",                  // ERR_TRACK_COUNT_INVALID
 	"Missing track data",                   // ERR_TRACK_DATA_MISSING
 	"Invalid track",                        // ERR_TRACK_INVALID
 	"File type must have a fixed track count of 1", // ERR_TRACK_SINGLE_ONLY
 	"Use full emulator for playback",       // ERR_USE_FULL_EMULATOR_FOR_PLAYBACK
-	"YM2413 FM sound isn't supported"       // ERR_YM2413_FM_NOT_SUPPORTED
+	"YM2413 FM sound isn't supported",      // ERR_YM2413_FM_NOT_SUPPORTED
+	"YM2612 emulator isn't available"       // ERR_YM2612_EMU_NOT_SUPPORTED
 };
 
 static const char* const blargg_warnmsg[] = {
@@ -472,13 +476,26 @@ int       gme_tell_scaled    ( Music_Emu const* me )                { return me-
 gme_err_t gme_seek           ( Music_Emu* me, int msec )            { return me->seek( msec ); }
 gme_err_t gme_seek_samples   ( Music_Emu* me, int n )               { return me->seek_samples( n ); }
 gme_err_t gme_seek_scaled    ( Music_Emu* me, int msec )            { return me->seek_scaled( msec ); }
+void      gme_set_keyframe_interval( Music_Emu* me, int msec )      { me->set_keyframe_interval( msec ); }
+long      gme_state_size     ( Music_Emu* me )                      { return me->state_size(); }
+gme_err_t gme_save_state     ( Music_Emu* me, void* out, long size ) { return me->save_state( out, size ); }
+gme_err_t gme_load_state     ( Music_Emu* me, void const* in, long size ) { return me->load_state( in, size ); }
+gme_err_t gme_play_parallel  ( Music_Emu* me, int n, short* p, Music_Emu* const* w, int count ) { return me->play_parallel( n, p, w, count ); }
+gme_err_t gme_play_float     ( Music_Emu* me, int n, float* p )     { return me->play_float( n, p ); }
+gme_err_t gme_play_planar    ( Music_Emu* me, int n, short* const* p ) { return me->play_planar( n, p ); }
+gme_err_t gme_play_planar_float( Music_Emu* me, int n, float* const* p ) { return me->play_planar_float( n, p ); }
+int       gme_planar_count   ( Music_Emu const* me )                { return me->planar_count(); }
 int       gme_voice_count    ( Music_Emu const* me )                { return me->voice_count(); }
 void      gme_ignore_silence ( Music_Emu* me, int disable )         { me->ignore_silence( disable != 0 ); }
+void      gme_set_low_latency( Music_Emu* me, int enabled )         { me->set_low_latency( enabled != 0 ); }
 void      gme_set_tempo      ( Music_Emu* me, double t )            { me->set_tempo( t ); }
 void      gme_mute_voice     ( Music_Emu* me, int index, int mute ) { me->mute_voice( index, mute != 0 ); }
 void      gme_mute_voices    ( Music_Emu* me, int mask )            { me->mute_voices( mask ); }
 void      gme_disable_echo   ( Music_Emu* me, int disable )         { me->disable_echo( disable ); }
 void      gme_enable_accuracy( Music_Emu* me, int enabled )         { me->enable_accuracy( enabled ); }
+void      gme_set_synthesis_quality( Music_Emu* me, int quality )   { me->set_synthesis_quality( quality ); }
+gme_err_t gme_set_resampler_quality( Music_Emu* me, int quality )   { return me->set_resampler_quality( quality ); }
+gme_err_t gme_set_ym2612_emu ( Music_Emu* me, int emu )           { return me->set_ym2612_emu( emu ); }
 void      gme_clear_playlist ( Music_Emu* me )                      { me->clear_playlist(); }
 int       gme_type_multitrack( gme_type_t t )                       { return t->track_count != 1; }
 int       gme_multi_channel  ( Music_Emu const* me )                { return me->multi_channel(); }
@@ -491,6 +508,18 @@ void      gme_set_equalizer  ( Music_Emu* me, gme_equalizer_t const* eq )
 	me->set_equalizer( e );
 }
 
+gme_err_t gme_new_fanout( Music_Emu* source, Music_Fanout** out )
+{
+	*out = BLARGG_NEW Music_Fanout( source );
+	CHECK_ALLOC( *out );
+	return 0;
+}
+
+gme_err_t gme_fanout_add_output( Music_Fanout* f, int rate, int* index ) { return f->add_output( rate, index ); }
+gme_err_t gme_fanout_play( Music_Fanout* f, int index, int n, short* p ) { return f->play( index, n, p ); }
+void      gme_fanout_clear( Music_Fanout* f )                           { f->clear(); }
+void      gme_delete_fanout( Music_Fanout* f )                          { delete f; }
+
 void gme_equalizer( Music_Emu const* me, gme_equalizer_t* out )
 {
 	gme_equalizer_t e = gme_equalizer_t(); // Default-init all fields to 0.0f
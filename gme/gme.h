@@ -105,6 +105,62 @@ BLARGG_EXPORT gme_err_t gme_seek_samples( Music_Emu*, int n );
  * @since 0.6.5 */
 BLARGG_EXPORT gme_err_t gme_seek_scaled( Music_Emu*, int msec );
 
+/* Save emulator state every msec milliseconds of playback so that later seeks,
+including backwards ones, resume from the nearest snapshot instead of replaying
+the track from the start. Snapshots are discarded when a new track is started.
+Pass 0 to disable (default). Has no effect on formats that don't support it.
+Sample rate must be set first.
+ * @since 0.6.6 */
+BLARGG_EXPORT void gme_set_keyframe_interval( Music_Emu*, int msec );
+
+/* Number of bytes needed to save complete state of current track, or 0 if no
+track is started or format doesn't support it.
+ * @since 0.6.6 */
+BLARGG_EXPORT long gme_state_size( Music_Emu* );
+
+/* Save state of current track to out, which must have room for gme_state_size()
+bytes. Playback continues unaffected.
+ * @since 0.6.6 */
+BLARGG_EXPORT gme_err_t gme_save_state( Music_Emu*, void* out, long size );
+
+/* Restore state saved by gme_save_state(), so that playback resumes at exactly
+the same sample, even in a different Music_Emu. It must have the same file
+loaded and sample rate set, and come from the same library version. Tempo,
+muting and other settings aren't saved. On failure no track is playing.
+ * @since 0.6.6 */
+BLARGG_EXPORT gme_err_t gme_load_state( Music_Emu*, void const* in, long size );
+
+/* Generate 'count' samples into 'out' exactly as gme_play() would, rendering
+segments of the track on separate threads using 'workers'. Each worker must have
+the same file loaded with the same sample rate and settings, and is left at an
+arbitrary position. Tempo, muting and equalizer are copied to workers. Falls back
+to gme_play() for formats that can't save their state.
+ * @since 0.6.6 */
+BLARGG_EXPORT gme_err_t gme_play_parallel( Music_Emu*, int count, short out [],
+		Music_Emu* const workers [], int worker_count );
+
+/* Generate 'count' floating-point samples into 'out' as gme_play() would, where
+1.0 corresponds to the 16-bit sample 0x8000. Formats which mix at higher
+precision write directly to 'out' without clamping, so samples can exceed 1.0.
+ * @since 0.6.6 */
+BLARGG_EXPORT gme_err_t gme_play_float( Music_Emu*, int count, float out [] );
+
+/* Generate 'count' samples into each buffer of 'out' as gme_play() would, except
+that with gme_multi_channel() each voice's stereo output is written to its own
+buffer, out [0] to out [gme_planar_count() - 1], rather than being interleaved.
+Otherwise stereo output is written to out [0] alone. 'count' must be even.
+ * @since 0.6.6 */
+BLARGG_EXPORT gme_err_t gme_play_planar( Music_Emu*, int count, short* const out [] );
+
+/* Number of buffers gme_play_planar() writes to, and of stereo channels in gme_play()
+output: 8 with gme_multi_channel(), except 9 for SPC, whose echo has its own; otherwise 1.
+ * @since 0.6.6 */
+BLARGG_EXPORT int gme_planar_count( Music_Emu const* );
+
+/* Same as gme_play_planar(), but writes floating-point samples as gme_play_float() does.
+ * @since 0.6.6 */
+BLARGG_EXPORT gme_err_t gme_play_planar_float( Music_Emu*, int count, float* const out [] );
+
 
 /******** Informational ********/
 
@@ -173,6 +229,14 @@ BLARGG_EXPORT void gme_set_stereo_depth( Music_Emu*, double depth );
 if ignore is true */
 BLARGG_EXPORT void gme_ignore_silence( Music_Emu*, int ignore );
 
+/* Enable low-latency playback if enabled is true. gme_play() then generates samples
+directly from the emulator, doing work in proportion to the number requested, so
+small blocks can be played at an even CPU cost. Silence at the beginning of a track
+isn't skipped, and end-of-track silence is detected as it's played instead of
+ahead of time. Can be changed at any time.
+ * @since 0.6.6 */
+BLARGG_EXPORT void gme_set_low_latency( Music_Emu*, int enabled );
+
 /* Adjust song tempo, where 1.0 = normal, 0.5 = half speed, 2.0 = double speed.
 Track length as returned by track_info() assumes a tempo of 1.0. */
 BLARGG_EXPORT void gme_set_tempo( Music_Emu*, double tempo );
@@ -213,6 +277,73 @@ BLARGG_EXPORT void gme_set_equalizer( Music_Emu*, gme_equalizer_t const* eq );
 /* Enables/disables most accurate sound emulation options */
 BLARGG_EXPORT void gme_enable_accuracy( Music_Emu*, int enabled );
 
+/* Band-limited synthesis quality */
+enum { gme_synthesis_full = 0, gme_synthesis_fast = 1 };
+
+/* Set band-limited synthesis quality. gme_synthesis_fast uses a fraction of the CPU
+time of gme_synthesis_full (default), at the cost of aliasing on high notes. Affects
+all formats except SPC and the FM sound of VGM/GYM. Can be changed at any time.
+ * @since 0.6.6 */
+BLARGG_EXPORT void gme_set_synthesis_quality( Music_Emu*, int quality );
+
+/* Resampling quality */
+enum { gme_resampler_normal = 0, gme_resampler_fast = 1, gme_resampler_precise = 2 };
+
+/* Set quality of the resampler used by SPC and the FM sound of VGM/GYM.
+gme_resampler_fast uses about half the CPU time of gme_resampler_normal (default).
+gme_resampler_precise matches the resampling ratio much more closely, avoiding
+slight pitch and tempo drift (for example, SPC at 44100 Hz), at the same CPU cost.
+VGM generates FM at the output rate, so there gme_resampler_precise sounds the same
+as gme_resampler_normal, while gme_resampler_fast still changes output slightly as
+its filter is shorter. Clears the resampler, so is best set before starting a track.
+ * @since 0.6.6 */
+BLARGG_EXPORT gme_err_t gme_set_resampler_quality( Music_Emu*, int quality );
+
+/* YM2612 FM sound emulator */
+enum { gme_ym2612_default = 0, gme_ym2612_nuked = 1, gme_ym2612_mame = 2, gme_ym2612_gens = 3 };
+
+/* Set YM2612 emulator used by VGM/GYM. gme_ym2612_nuked is the most accurate,
+gme_ym2612_gens uses the least CPU time, and gme_ym2612_mame is in between (only
+available if library was built with it, as it makes the library GPL).
+gme_ym2612_default uses the one chosen when building the library. Resets the FM
+sound chip, so is best set before starting a track. Returns an error for
+emulators without a YM2612.
+ * @since 0.6.6 */
+BLARGG_EXPORT gme_err_t gme_set_ym2612_emu( Music_Emu*, int emu );
+
+
+/******** Multi-rate output ********/
+
+/* Plays one emulator to several outputs at different sample rates, so that the
+emulator only runs once. Each output has its own resampler and position, and can
+be read at its own pace. Not thread-safe.
+ * @since 0.6.6 */
+typedef struct Music_Fanout Music_Fanout;
+
+/* Create fanout playing from 'source', which must have a track started and stays
+owned by the caller. Its sample rate should be the format's native rate where it
+has one (32000 for SPC), otherwise the highest output rate.
+ * @since 0.6.6 */
+BLARGG_EXPORT gme_err_t gme_new_fanout( Music_Emu* source, Music_Fanout** out );
+
+/* Add output at 'sample_rate' and set *index_out to its index. The output starts
+with the next sound the source generates.
+ * @since 0.6.6 */
+BLARGG_EXPORT gme_err_t gme_fanout_add_output( Music_Fanout*, int sample_rate, int* index_out );
+
+/* Generate 'count' samples (must be even) for output 'index' into 'out'
+ * @since 0.6.6 */
+BLARGG_EXPORT gme_err_t gme_fanout_play( Music_Fanout*, int index, int count, short out [] );
+
+/* Clear sound buffered for all outputs. Call after starting a new track or seeking
+the source.
+ * @since 0.6.6 */
+BLARGG_EXPORT void gme_fanout_clear( Music_Fanout* );
+
+/* Finish using fanout and free memory. Doesn't delete the source emulator.
+ * @since 0.6.6 */
+BLARGG_EXPORT void gme_delete_fanout( Music_Fanout* );
+
 
 /******** Game music types ********/
 
@@ -247,7 +378,8 @@ BLARGG_EXPORT const char* gme_type_system( gme_type_t );
 BLARGG_EXPORT int gme_type_multitrack( gme_type_t );
 
 /* whether the pcm output retrieved by gme_play() will have all 8 voices rendered to their
- * individual stereo channel or (if false) these voices get mixed into one single stereo channel
+ * individual stereo channel or (if false) these voices get mixed into one single stereo channel.
+ * SPC output has a ninth stereo channel for echo (see gme_planar_count()).
  * @since 0.6.3 */
 BLARGG_EXPORT int gme_multi_channel( Music_Emu const* );
 
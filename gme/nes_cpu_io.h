@@ -85,6 +85,7 @@ void Nsf_Emu::cpu_write( nes_addr_t addr, int data )
 		int32_t offset = rom.mask_addr( data * (int32_t) bank_size );
 		if ( offset >= rom.size() )
 			set_warning( WARN_BANK_INVALID );
+		banks [bank] = data;
 		cpu::map_code( (bank + 8) * bank_size, bank_size, rom.at_addr( offset ) );
 		return;
 	}